@@ -0,0 +1,220 @@
+// WebCee compiler throughput benchmark
+//
+// Synthesizes a large machine-generated style .wce UI in memory and times
+// the three phases of wce_tool separately:
+//   lex      - lexer_next_token() until EOF
+//   parse    - parser_parse() (includes its own lexing)
+//   codegen  - codegen_generate() into a temporary file
+//
+// Usage: wce_bench_compiler [ui_nodes] [iterations]
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "diagnostic.h"
+#include "lexer.h"
+#include "parser.h"
+#include "ast.h"
+#include "memory_pool.h"
+#include "codegen.h"
+
+#ifdef _WIN32
+#include <windows.h>
+static double now_sec(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER t;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+}
+#else
+#include <time.h>
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+#endif
+
+// --- Source Synthesis ---
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} SrcBuf;
+
+static void src_printf(SrcBuf* b, const char* fmt, ...) {
+    va_list args;
+    for (;;) {
+        va_start(args, fmt);
+        int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, args);
+        va_end(args);
+        if (n < 0) return;
+        if (b->len + (size_t)n < b->cap) {
+            b->len += (size_t)n;
+            return;
+        }
+        b->cap = (b->cap + (size_t)n) * 2;
+        b->data = (char*)realloc(b->data, b->cap);
+    }
+}
+
+static void src_indent(SrcBuf* b, int depth) {
+    for (int i = 0; i < depth; i++) src_printf(b, "    ");
+}
+
+// One dashboard "widget": 6 UI nodes (col, card, 2 texts, button, input)
+// plus 4 wce_css strings.
+static int emit_widget(SrcBuf* b, int id, int depth) {
+    src_indent(b, depth);     src_printf(b, "wce_col() {\n");
+    src_indent(b, depth + 1); src_printf(b, "wce_card() {\n");
+    src_indent(b, depth + 2); src_printf(b, "wce_css(\"background: white; padding: 20px; border-radius: 10px; box-shadow: 0 4px 6px rgba(0,0,0,0.05);\");\n");
+    src_indent(b, depth + 2); src_printf(b, "wce_text(\"Metric %d\") { wce_css(\"color: #7f8c8d; font-size: 14px; text-transform: uppercase;\"); }\n", id);
+    src_indent(b, depth + 2); src_printf(b, "wce_text(\"0\") {\n");
+    src_indent(b, depth + 3); src_printf(b, "wce_bind(\"metric_%d\");\n", id);
+    src_indent(b, depth + 3); src_printf(b, "wce_css(\"font-size: 36px; font-weight: 700; color: #2ecc71; display: block;\");\n");
+    src_indent(b, depth + 2); src_printf(b, "}\n");
+    src_indent(b, depth + 2); src_printf(b, "wce_button(\"Reset %d\") { wce_on_click(\"on_reset_%d\"); wce_css(\"width: 100%%;\"); }\n", id, id);
+    src_indent(b, depth + 2); src_printf(b, "wce_input(\"Threshold\") { wce_bind(\"limit_%d\"); }\n", id);
+    src_indent(b, depth + 1); src_printf(b, "}\n");
+    src_indent(b, depth);     src_printf(b, "}\n");
+    return 6;
+}
+
+// Sections of rows nested a few levels deep, filled with widgets until
+// roughly `target_nodes` UI nodes have been emitted.
+static char* synthesize_ui(int target_nodes, size_t* out_len, int* out_ui_nodes) {
+    SrcBuf b = { (char*)malloc(1 << 20), 0, 1 << 20 };
+    int nodes = 0;
+    int id = 0;
+
+    src_printf(&b, "// Synthesized by wce_bench_compiler\n");
+    src_printf(&b, "wce_container() {\n");
+    src_printf(&b, "    wce_css(\"max-width: 1600px; margin: 0 auto; padding: 20px;\");\n");
+    nodes++;
+
+    while (nodes < target_nodes) {
+        src_printf(&b, "    wce_card() {\n");
+        src_printf(&b, "        wce_text(\"Section %d\") { wce_css(\"font-size: 20px; font-weight: 600;\"); }\n", id);
+        nodes += 2;
+        for (int r = 0; r < 4 && nodes < target_nodes; r++) {
+            src_printf(&b, "        wce_row() {\n");
+            src_printf(&b, "            wce_panel() {\n");
+            nodes += 2;
+            for (int w = 0; w < 4 && nodes < target_nodes; w++) {
+                nodes += emit_widget(&b, id++, 4);
+            }
+            src_printf(&b, "            }\n");
+            src_printf(&b, "        }\n");
+        }
+        src_printf(&b, "    }\n");
+    }
+    src_printf(&b, "}\n");
+
+    *out_len = b.len;
+    *out_ui_nodes = nodes;
+    return b.data;
+}
+
+static int count_ast_nodes(const WceAstNode* node) {
+    int n = 0;
+    while (node) {
+        n++;
+        n += count_ast_nodes(node->first_child);
+        n += count_ast_nodes(node->block);
+        node = node->next_sibling;
+    }
+    return n;
+}
+
+// --- Benchmark ---
+
+typedef struct {
+    double lex;
+    double parse;
+    double codegen;
+} PhaseTimes;
+
+int main(int argc, char** argv) {
+    int target_nodes = (argc >= 2) ? atoi(argv[1]) : 50000;
+    int iterations = (argc >= 3) ? atoi(argv[2]) : 5;
+    if (target_nodes < 1) target_nodes = 1;
+    if (iterations < 1) iterations = 1;
+
+    size_t src_len = 0;
+    int ui_nodes = 0;
+    char* source = synthesize_ui(target_nodes, &src_len, &ui_nodes);
+
+    PhaseTimes best = { 1e30, 1e30, 1e30 };
+    int tokens = 0;
+    int ast_nodes = 0;
+    size_t pool_reserved = 0, pool_used = 0, pool_blocks = 0;
+    size_t out_bytes = 0;
+
+    for (int it = 0; it < iterations; it++) {
+        DiagnosticBag* bag = diagnostic_bag_create();
+
+        // Phase 1: lexer only
+        Lexer* lexer = lexer_create(source, "<bench>", bag);
+        double t0 = now_sec();
+        int count = 0;
+        while (lexer_next_token(lexer).type != TOKEN_EOF) count++;
+        double t1 = now_sec();
+        lexer_destroy(lexer);
+        tokens = count;
+        if (t1 - t0 < best.lex) best.lex = t1 - t0;
+
+        // Phase 2: parser (drives a fresh lexer)
+        lexer = lexer_create(source, "<bench>", bag);
+        MemoryPool* pool = memory_pool_create(1024 * 1024); // same block size as wce_tool
+        t0 = now_sec();
+        Parser* parser = parser_create(lexer, bag, pool);
+        WceAstNode* ast = parser_parse(parser);
+        t1 = now_sec();
+        if (t1 - t0 < best.parse) best.parse = t1 - t0;
+
+        if (diagnostic_has_errors(bag)) {
+            diagnostic_print_all(bag);
+            return 1;
+        }
+        ast_nodes = count_ast_nodes(ast);
+        pool_reserved = pool->bytes_reserved;
+        pool_used = pool->bytes_used;
+        pool_blocks = pool->block_count;
+
+        // Phase 3: codegen
+        FILE* out = tmpfile();
+        if (!out) {
+            printf("Error: Could not create temporary output file\n");
+            return 1;
+        }
+        t0 = now_sec();
+        codegen_generate(ast, out);
+        fflush(out);
+        t1 = now_sec();
+        out_bytes = (size_t)ftell(out);
+        fclose(out);
+        if (t1 - t0 < best.codegen) best.codegen = t1 - t0;
+
+        parser_destroy(parser);
+        lexer_destroy(lexer);
+        memory_pool_destroy(pool);
+        diagnostic_bag_destroy(bag);
+    }
+
+    double mb = (double)src_len / (1024.0 * 1024.0);
+    printf("WebCee compiler benchmark (best of %d)\n", iterations);
+    printf("  input:    %.2f MB, %d UI nodes, %d tokens, %d AST nodes\n", mb, ui_nodes, tokens, ast_nodes);
+    printf("  %-8s %10.3f ms %10.1f MB/s %12.0f tokens/s\n", "lex", best.lex * 1e3, mb / best.lex, tokens / best.lex);
+    printf("  %-8s %10.3f ms %10.1f MB/s %12.0f nodes/s\n", "parse", best.parse * 1e3, mb / best.parse, ast_nodes / best.parse);
+    printf("  %-8s %10.3f ms %10.1f MB/s %12.0f nodes/s (%.2f MB out)\n", "codegen", best.codegen * 1e3,
+        mb / best.codegen, ast_nodes / best.codegen, (double)out_bytes / (1024.0 * 1024.0));
+    printf("  pool:     peak %.2f MB reserved in %zu blocks, %.2f MB used (%.1f bytes/AST node)\n",
+        (double)pool_reserved / (1024.0 * 1024.0), pool_blocks,
+        (double)pool_used / (1024.0 * 1024.0), ast_nodes ? (double)pool_used / ast_nodes : 0.0);
+
+    free(source);
+    return 0;
+}
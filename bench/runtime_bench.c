@@ -0,0 +1,309 @@
+// WebCee runtime microbenchmarks
+//
+// Times the runtime hot paths in-process against the webcee library:
+//   kv_set_N / kv_get_N   wce_data_set()/wce_data_get() with N keys stored
+//   data_json_N           /api/data serialization (wce_data_json) of N keys
+//   data_cbor_N           the same store as CBOR (wce_data_cbor)
+//   render_dom_N          wce_render_dom() on a synthetic tree of N nodes
+//   ui_build_N            wce_ui_reset() and rebuilding that tree
+//   dispatch_N            wce_dispatch_event() with N registered functions
+//
+// Each result (ns/op) is compared against a stored baseline; a result slower
+// than baseline * (1 + threshold/100) is reported as a regression and makes
+// the process exit non-zero, which fails the corresponding CTest test.
+//
+// Usage: wce_bench_runtime [--only NAME] [--baseline FILE] [--threshold PCT] [--update]
+
+#include "webcee.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void wce_dispatch_event(const char* event, const char* args);
+
+#ifdef _WIN32
+#include <windows.h>
+static double now_sec(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER t;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+}
+#else
+#include <time.h>
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+#endif
+
+// Keeps results observable so the optimizer cannot drop the measured calls.
+static volatile size_t bench_sink = 0;
+
+// --- Fixtures ---
+
+static int kv_keys = 0;
+static char kv_names[1024][16];
+
+static void ensure_kv_keys(int n) {
+    char val[32];
+    for (; kv_keys < n; kv_keys++) {
+        snprintf(kv_names[kv_keys], sizeof(kv_names[kv_keys]), "key_%d", kv_keys);
+        snprintf(val, sizeof(val), "%d", kv_keys * 7);
+        wce_data_set(kv_names[kv_keys], val);
+    }
+}
+
+static int tree_nodes = 0;
+static WceNode* tree_root = NULL;
+
+// Grows the UI tree under a single root container to at least `n` nodes.
+// Each block is a row > col > card > (text, text bound, button, input).
+static void ensure_tree_nodes(int n) {
+    if (!tree_root) {
+        wce_container_begin();
+        tree_root = _wce_current_context();
+        tree_nodes = 1;
+    } else {
+        _wce_push_context(tree_root);
+    }
+    while (tree_nodes < n) {
+        wce_row_begin();
+            wce_css("margin-bottom: 10px;");
+            wce_col_begin();
+                wce_card_begin();
+                    wce_css("background: white; padding: 20px; border-radius: 10px;");
+                    wce_text("Metric");
+                    wce_text_begin("0");
+                        wce_bind("key_0");
+                    wce_text_end();
+                    wce_button_begin("Reset");
+                        wce_on_click("bench_fn_0");
+                    wce_button_end();
+                    wce_input_begin("Value");
+                        wce_bind("key_1");
+                    wce_input_end();
+                wce_card_end();
+            wce_col_end();
+        wce_row_end();
+        tree_nodes += 7;
+    }
+    _wce_pop_context();
+}
+
+static int func_count = 0;
+static void bench_noop(void) { bench_sink++; }
+
+static void ensure_functions(int n) {
+    char name[32];
+    for (; func_count < n; func_count++) {
+        snprintf(name, sizeof(name), "bench_fn_%d", func_count);
+        wce_register_function(name, bench_noop);
+    }
+}
+
+// --- Cases ---
+
+typedef struct {
+    const char* name;
+    int size;
+    void (*setup)(int size);
+    void (*run)(int size, long iters);
+} BenchCase;
+
+static void setup_kv(int n) { ensure_kv_keys(n); }
+static void setup_tree(int n) { ensure_tree_nodes(n); }
+static void setup_funcs(int n) { ensure_functions(n); }
+
+// Worst case: always touch the most recently inserted key.
+static void run_kv_set(int n, long iters) {
+    for (long i = 0; i < iters; i++) wce_data_set(kv_names[n - 1], (i & 1) ? "on" : "off");
+}
+
+static void run_kv_get(int n, long iters) {
+    for (long i = 0; i < iters; i++) bench_sink += (size_t)wce_data_get(kv_names[n - 1]);
+}
+
+static void run_data_json(int n, long iters) {
+    (void)n;
+    for (long i = 0; i < iters; i++) {
+        size_t len = 0;
+        char* json = wce_data_json(&len);
+        bench_sink += len;
+        free(json);
+    }
+}
+
+static void run_data_cbor(int n, long iters) {
+    (void)n;
+    for (long i = 0; i < iters; i++) {
+        size_t len = 0;
+        char* cbor = wce_data_cbor(&len);
+        bench_sink += len;
+        free(cbor);
+    }
+}
+
+static void run_render_dom(int n, long iters) {
+    (void)n;
+    for (long i = 0; i < iters; i++) {
+        char* html = wce_render_dom();
+        bench_sink += (size_t)html[0];
+        free(html);
+    }
+}
+
+// Rebuilds the render fixture from scratch, so it runs after the render cases.
+static void run_ui_build(int n, long iters) {
+    for (long i = 0; i < iters; i++) {
+        wce_ui_reset();
+        tree_root = NULL;
+        tree_nodes = 0;
+        ensure_tree_nodes(n);
+    }
+}
+
+static void run_dispatch(int n, long iters) {
+    char name[32];
+    snprintf(name, sizeof(name), "bench_fn_%d", n - 1);
+    for (long i = 0; i < iters; i++) wce_dispatch_event(name, "");
+}
+
+// Ordered so that cases needing a smaller fixture run before larger ones.
+static const BenchCase cases[] = {
+    { "kv_set_10",        10,     setup_kv,    run_kv_set },
+    { "kv_get_10",        10,     setup_kv,    run_kv_get },
+    { "data_json_10",     10,     setup_kv,    run_data_json },
+    { "data_cbor_10",     10,     setup_kv,    run_data_cbor },
+    { "kv_set_100",       100,    setup_kv,    run_kv_set },
+    { "kv_get_100",       100,    setup_kv,    run_kv_get },
+    { "data_json_100",    100,    setup_kv,    run_data_json },
+    { "data_cbor_100",    100,    setup_kv,    run_data_cbor },
+    { "render_dom_10k",   10000,  setup_tree,  run_render_dom },
+    { "render_dom_100k",  100000, setup_tree,  run_render_dom },
+    { "ui_build_10k",     10000,  setup_tree,  run_ui_build },
+    { "dispatch_16",      16,     setup_funcs, run_dispatch },
+    { "dispatch_256",     256,    setup_funcs, run_dispatch },
+};
+#define CASE_COUNT ((int)(sizeof(cases) / sizeof(cases[0])))
+
+// Grows the iteration count until one batch takes at least 50 ms, then
+// reports the fastest of five batches in nanoseconds per operation.
+static double measure(const BenchCase* bc) {
+    long iters = 1;
+    double elapsed = 0;
+    for (;;) {
+        double t0 = now_sec();
+        bc->run(bc->size, iters);
+        elapsed = now_sec() - t0;
+        if (elapsed >= 0.05 || iters >= (1L << 30)) break;
+        iters *= (elapsed < 0.005) ? 10 : 2;
+    }
+    double best = elapsed;
+    for (int i = 0; i < 4; i++) {
+        double t0 = now_sec();
+        bc->run(bc->size, iters);
+        elapsed = now_sec() - t0;
+        if (elapsed < best) best = elapsed;
+    }
+    return best * 1e9 / (double)iters;
+}
+
+// --- Baselines ---
+
+static double baselines[CASE_COUNT];
+
+static void load_baselines(const char* path) {
+    for (int i = 0; i < CASE_COUNT; i++) baselines[i] = 0;
+    FILE* f = fopen(path, "r");
+    if (!f) return;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char name[64];
+        double ns;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s %lf", name, &ns) != 2) continue;
+        for (int i = 0; i < CASE_COUNT; i++) {
+            if (strcmp(cases[i].name, name) == 0) baselines[i] = ns;
+        }
+    }
+    fclose(f);
+}
+
+static int save_baselines(const char* path, const double* results) {
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "# WebCee runtime benchmark baselines (ns/op), written by wce_bench_runtime --update\n");
+    fprintf(f, "# Release build timings of the recording machine; re-record on the host that runs the tests\n");
+    for (int i = 0; i < CASE_COUNT; i++) {
+        double ns = results[i] > 0 ? results[i] : baselines[i];
+        if (ns > 0) fprintf(f, "%-18s %.1f\n", cases[i].name, ns);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* only = NULL;
+    const char* baseline_path = NULL;
+    double threshold = 50.0;
+    int update = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) only = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) baseline_path = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--update") == 0) update = 1;
+        else {
+            printf("Usage: %s [--only NAME] [--baseline FILE] [--threshold PCT] [--update]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (baseline_path) load_baselines(baseline_path);
+
+    double results[CASE_COUNT] = {0};
+    int matched = 0;
+    int regressions = 0;
+
+    for (int i = 0; i < CASE_COUNT; i++) {
+        const BenchCase* bc = &cases[i];
+        if (only && strcmp(only, bc->name) != 0) continue;
+        matched++;
+
+        bc->setup(bc->size);
+        results[i] = measure(bc);
+
+        if (baselines[i] > 0 && !update) {
+            double limit = baselines[i] * (1.0 + threshold / 100.0);
+            double delta = (results[i] / baselines[i] - 1.0) * 100.0;
+            int slow = results[i] > limit;
+            printf("%-18s %12.1f ns/op   baseline %12.1f  %+7.1f%%  %s\n",
+                bc->name, results[i], baselines[i], delta, slow ? "REGRESSION" : "ok");
+            if (slow) regressions++;
+        } else {
+            printf("%-18s %12.1f ns/op\n", bc->name, results[i]);
+        }
+    }
+
+    if (only && !matched) {
+        printf("Unknown benchmark '%s'\n", only);
+        return 2;
+    }
+
+    if (update) {
+        if (!baseline_path || save_baselines(baseline_path, results) != 0) {
+            printf("Error: Could not write baselines (use --baseline FILE)\n");
+            return 1;
+        }
+        printf("Baselines written to '%s'\n", baseline_path);
+        return 0;
+    }
+
+    if (regressions) {
+        printf("%d benchmark(s) slower than baseline by more than %.0f%%\n", regressions, threshold);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,687 @@
+#include "assets.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// --- Bit Output ---
+
+typedef struct {
+    unsigned char* buf;
+    size_t len;
+    size_t cap;
+    uint32_t bits;
+    int count;
+    int failed;
+} BitWriter;
+
+static void bw_byte(BitWriter* w, unsigned char b) {
+    if (w->len == w->cap) {
+        size_t cap = w->cap ? w->cap * 2 : 4096;
+        unsigned char* buf = (unsigned char*)realloc(w->buf, cap);
+        if (!buf) {
+            w->failed = 1;
+            return;
+        }
+        w->buf = buf;
+        w->cap = cap;
+    }
+    w->buf[w->len++] = b;
+}
+
+// DEFLATE packs values LSB first
+static void bw_bits(BitWriter* w, uint32_t value, int n) {
+    w->bits |= value << w->count;
+    w->count += n;
+    while (w->count >= 8) {
+        bw_byte(w, (unsigned char)w->bits);
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+}
+
+// Huffman codes are defined MSB first, so they go out bit-reversed
+static void bw_code(BitWriter* w, uint32_t code, int n) {
+    uint32_t rev = 0;
+    for (int i = 0; i < n; i++) rev |= ((code >> i) & 1u) << (n - 1 - i);
+    bw_bits(w, rev, n);
+}
+
+static void bw_flush(BitWriter* w) {
+    if (w->count > 0) bw_byte(w, (unsigned char)w->bits);
+    w->bits = 0;
+    w->count = 0;
+}
+
+static void bw_u32le(BitWriter* w, uint32_t v) {
+    for (int i = 0; i < 4; i++) bw_byte(w, (unsigned char)(v >> (i * 8)));
+}
+
+// --- Huffman Codes ---
+
+#define LITLEN_CODES 286
+#define DIST_CODES   30
+#define CL_CODES     19
+
+// Code lengths for `freq`, at most `limit` bits. Frequencies are halved
+// until the tree fits, which costs little and happens only for skewed input.
+// At least two symbols get a code, so every code is complete.
+static void huff_lengths(const uint32_t* freq_in, int n, int limit, unsigned char* lengths) {
+    uint32_t freq[LITLEN_CODES];
+    int used = 0;
+    for (int i = 0; i < n; i++) {
+        freq[i] = freq_in[i];
+        if (freq[i]) used++;
+    }
+    for (int i = 0; used < 2 && i < n; i++) {
+        if (!freq[i]) {
+            freq[i] = 1;
+            used++;
+        }
+    }
+
+    for (;;) {
+        // Two-queue construction: leaves sorted by weight, internal nodes
+        // are created in non-decreasing weight order.
+        int leaf[LITLEN_CODES];
+        int leaf_count = 0;
+        for (int i = 0; i < n; i++) {
+            if (!freq[i]) continue;
+            int j = leaf_count++;
+            while (j > 0 && freq[leaf[j - 1]] > freq[i]) {
+                leaf[j] = leaf[j - 1];
+                j--;
+            }
+            leaf[j] = i;
+        }
+        uint32_t weight[2 * LITLEN_CODES];
+        int parent[2 * LITLEN_CODES];
+        for (int i = 0; i < leaf_count; i++) weight[i] = freq[leaf[i]];
+        int next_leaf = 0, next_node = leaf_count, node_count = leaf_count;
+        for (int k = 0; k < leaf_count - 1; k++) {
+            int pick[2];
+            for (int s = 0; s < 2; s++) {
+                if (next_leaf < leaf_count && (next_node >= node_count || weight[next_leaf] <= weight[next_node])) {
+                    pick[s] = next_leaf++;
+                } else {
+                    pick[s] = next_node++;
+                }
+            }
+            weight[node_count] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = parent[pick[1]] = node_count;
+            node_count++;
+        }
+
+        int depth[2 * LITLEN_CODES];
+        int max_depth = 0;
+        depth[node_count - 1] = 0;
+        for (int i = node_count - 2; i >= 0; i--) {
+            depth[i] = depth[parent[i]] + 1;
+            if (i < leaf_count && depth[i] > max_depth) max_depth = depth[i];
+        }
+        if (max_depth <= limit) {
+            memset(lengths, 0, (size_t)n);
+            for (int i = 0; i < leaf_count; i++) lengths[leaf[i]] = (unsigned char)depth[i];
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            if (freq[i]) freq[i] = (freq[i] >> 1) | 1u;
+        }
+    }
+}
+
+// Canonical codes from lengths (RFC 1951, 3.2.2)
+static void huff_codes(const unsigned char* lengths, int n, uint16_t* codes) {
+    int bl_count[16] = {0};
+    int next_code[16];
+    for (int i = 0; i < n; i++) bl_count[lengths[i]]++;
+    bl_count[0] = 0;
+    int code = 0;
+    for (int bits = 1; bits < 16; bits++) {
+        code = (code + bl_count[bits - 1]) << 1;
+        next_code[bits] = code;
+    }
+    for (int i = 0; i < n; i++) {
+        if (lengths[i]) codes[i] = (uint16_t)next_code[lengths[i]]++;
+    }
+}
+
+// --- DEFLATE ---
+
+static const uint16_t len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const unsigned char dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const unsigned char cl_order[CL_CODES] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+#define WINDOW_SIZE  32768
+#define HASH_BITS    15
+#define MIN_MATCH    3
+#define MAX_MATCH    258
+#define MAX_CHAIN    512
+#define BLOCK_SYMS   32768
+
+static int len_code(int len) {
+    int c = 28;
+    while (len_base[c] > len) c--;
+    return c;
+}
+
+static int dist_code(int dist) {
+    int c = 29;
+    while (dist_base[c] > dist) c--;
+    return c;
+}
+
+typedef struct {
+    uint16_t litlen;        // Literal byte, or match length
+    uint16_t dist;          // 0 for a literal
+} Symbol;
+
+// One dynamic-Huffman block for syms[0..count)
+static void deflate_block(BitWriter* w, const Symbol* syms, int count, int last) {
+    uint32_t lit_freq[LITLEN_CODES] = {0};
+    uint32_t dist_freq[DIST_CODES] = {0};
+    for (int i = 0; i < count; i++) {
+        if (syms[i].dist) {
+            lit_freq[257 + len_code(syms[i].litlen)]++;
+            dist_freq[dist_code(syms[i].dist)]++;
+        } else {
+            lit_freq[syms[i].litlen]++;
+        }
+    }
+    lit_freq[256] = 1;
+
+    unsigned char lengths[LITLEN_CODES + DIST_CODES];
+    unsigned char* lit_len = lengths;
+    unsigned char* dist_len = lengths + LITLEN_CODES;
+    huff_lengths(lit_freq, LITLEN_CODES, 15, lit_len);
+    huff_lengths(dist_freq, DIST_CODES, 15, dist_len);
+    int hlit = LITLEN_CODES;
+    while (hlit > 257 && !lit_len[hlit - 1]) hlit--;
+    int hdist = DIST_CODES;
+    while (hdist > 1 && !dist_len[hdist - 1]) hdist--;
+
+    // Run-length code the two length tables as one sequence (16/17/18)
+    unsigned char seq[LITLEN_CODES + DIST_CODES];
+    memcpy(seq, lit_len, (size_t)hlit);
+    memcpy(seq + hlit, dist_len, (size_t)hdist);
+    int seq_len = hlit + hdist;
+    unsigned char rle_sym[LITLEN_CODES + DIST_CODES];
+    unsigned char rle_arg[LITLEN_CODES + DIST_CODES];
+    int rle_count = 0;
+    uint32_t cl_freq[CL_CODES] = {0};
+    for (int i = 0; i < seq_len;) {
+        int v = seq[i];
+        int run = 1;
+        while (i + run < seq_len && seq[i + run] == v) run++;
+        if (v == 0 && run >= 3) {
+            int r = run > 138 ? 138 : run;
+            rle_sym[rle_count] = (unsigned char)(r >= 11 ? 18 : 17);
+            rle_arg[rle_count++] = (unsigned char)(r >= 11 ? r - 11 : r - 3);
+            i += r;
+        } else if (v != 0 && run >= 4) {
+            int r = run - 1 > 6 ? 6 : run - 1;
+            rle_sym[rle_count] = (unsigned char)v;
+            rle_arg[rle_count++] = 0;
+            rle_sym[rle_count] = 16;
+            rle_arg[rle_count++] = (unsigned char)(r - 3);
+            i += 1 + r;
+        } else {
+            rle_sym[rle_count] = (unsigned char)v;
+            rle_arg[rle_count++] = 0;
+            i++;
+        }
+    }
+    for (int i = 0; i < rle_count; i++) cl_freq[rle_sym[i]]++;
+    unsigned char cl_len[CL_CODES];
+    huff_lengths(cl_freq, CL_CODES, 7, cl_len);
+    int hclen = CL_CODES;
+    while (hclen > 4 && !cl_len[cl_order[hclen - 1]]) hclen--;
+
+    uint16_t lit_codes[LITLEN_CODES], dist_codes[DIST_CODES], cl_codes[CL_CODES];
+    huff_codes(lit_len, LITLEN_CODES, lit_codes);
+    huff_codes(dist_len, DIST_CODES, dist_codes);
+    huff_codes(cl_len, CL_CODES, cl_codes);
+
+    bw_bits(w, last ? 1u : 0u, 1);
+    bw_bits(w, 2, 2);
+    bw_bits(w, (uint32_t)(hlit - 257), 5);
+    bw_bits(w, (uint32_t)(hdist - 1), 5);
+    bw_bits(w, (uint32_t)(hclen - 4), 4);
+    for (int i = 0; i < hclen; i++) bw_bits(w, cl_len[cl_order[i]], 3);
+    for (int i = 0; i < rle_count; i++) {
+        int s = rle_sym[i];
+        bw_code(w, cl_codes[s], cl_len[s]);
+        if (s == 16) bw_bits(w, rle_arg[i], 2);
+        else if (s == 17) bw_bits(w, rle_arg[i], 3);
+        else if (s == 18) bw_bits(w, rle_arg[i], 7);
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!syms[i].dist) {
+            bw_code(w, lit_codes[syms[i].litlen], lit_len[syms[i].litlen]);
+            continue;
+        }
+        int lc = len_code(syms[i].litlen);
+        bw_code(w, lit_codes[257 + lc], lit_len[257 + lc]);
+        bw_bits(w, (uint32_t)(syms[i].litlen - len_base[lc]), len_extra[lc]);
+        int dc = dist_code(syms[i].dist);
+        bw_code(w, dist_codes[dc], dist_len[dc]);
+        bw_bits(w, (uint32_t)(syms[i].dist - dist_base[dc]), dist_extra[dc]);
+    }
+    bw_code(w, lit_codes[256], lit_len[256]);
+}
+
+static uint32_t hash3(const unsigned char* p) {
+    return (((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Longest earlier match for position `pos` through the hash chains
+static int find_match(const unsigned char* data, size_t len, size_t pos, const int* head, const int* prev, int* out_dist) {
+    if (pos + MIN_MATCH > len) return 0;
+    size_t max = len - pos < MAX_MATCH ? len - pos : MAX_MATCH;
+    int best = 0;
+    int cand = head[hash3(data + pos)];
+    for (int chain = 0; cand >= 0 && chain < MAX_CHAIN; chain++) {
+        size_t dist = pos - (size_t)cand;
+        if (dist > WINDOW_SIZE) break;
+        const unsigned char* a = data + cand;
+        const unsigned char* b = data + pos;
+        if (a[best] == b[best]) {
+            size_t n = 0;
+            while (n < max && a[n] == b[n]) n++;
+            if ((int)n > best) {
+                best = (int)n;
+                *out_dist = (int)dist;
+                if (n == max) break;
+            }
+        }
+        cand = prev[cand & (WINDOW_SIZE - 1)];
+    }
+    return best >= MIN_MATCH ? best : 0;
+}
+
+static void deflate_data(BitWriter* w, const unsigned char* data, size_t len) {
+    int* head = (int*)malloc(sizeof(int) << HASH_BITS);
+    int* prev = (int*)malloc(sizeof(int) * WINDOW_SIZE);
+    Symbol* syms = (Symbol*)malloc(sizeof(Symbol) * BLOCK_SYMS);
+    if (!head || !prev || !syms) {
+        w->failed = 1;
+        free(head);
+        free(prev);
+        free(syms);
+        return;
+    }
+    for (int i = 0; i < (1 << HASH_BITS); i++) head[i] = -1;
+
+    int count = 0;
+    size_t pos = 0;
+    size_t inserted = 0;    // Positions below this are in the hash chains
+    while (pos < len) {
+        while (inserted < pos && inserted + MIN_MATCH <= len) {
+            uint32_t h = hash3(data + inserted);
+            prev[inserted & (WINDOW_SIZE - 1)] = head[h];
+            head[h] = (int)inserted;
+            inserted++;
+        }
+        int dist = 0;
+        int match = find_match(data, len, pos, head, prev, &dist);
+        if (match && match < MAX_MATCH && pos + 1 < len) {
+            // Lazy evaluation: a longer match one byte later wins
+            if (inserted + MIN_MATCH <= len && inserted == pos) {
+                uint32_t h = hash3(data + pos);
+                prev[pos & (WINDOW_SIZE - 1)] = head[h];
+                head[h] = (int)pos;
+                inserted++;
+            }
+            int next_dist = 0;
+            int next = find_match(data, len, pos + 1, head, prev, &next_dist);
+            if (next > match) match = 0;
+        }
+        if (match) {
+            syms[count].litlen = (uint16_t)match;
+            syms[count].dist = (uint16_t)dist;
+            pos += (size_t)match;
+        } else {
+            syms[count].litlen = data[pos];
+            syms[count].dist = 0;
+            pos++;
+        }
+        if (++count == BLOCK_SYMS) {
+            deflate_block(w, syms, count, pos >= len);
+            count = 0;
+        }
+    }
+    if (count || len == 0) deflate_block(w, syms, count, 1);
+    free(head);
+    free(prev);
+    free(syms);
+}
+
+static uint32_t crc32_of(const unsigned char* data, size_t len) {
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+unsigned char* assets_gzip(const unsigned char* data, size_t len, size_t* out_len) {
+    BitWriter w;
+    memset(&w, 0, sizeof(w));
+    // No name and mtime 0, so the output only depends on the content
+    static const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255 };
+    for (int i = 0; i < 10; i++) bw_byte(&w, header[i]);
+    deflate_data(&w, data, len);
+    bw_flush(&w);
+    bw_u32le(&w, crc32_of(data, len));
+    bw_u32le(&w, (uint32_t)len);
+    if (w.failed) {
+        free(w.buf);
+        return NULL;
+    }
+    *out_len = w.len;
+    return w.buf;
+}
+
+// --- Asset Bundle ---
+
+typedef struct {
+    char* path;             // URL path, "/css/app.css"
+    const char* mime;
+    unsigned char* data;
+    size_t len;
+    unsigned char* gzip;    // NULL when it does not pay off
+    size_t gzip_len;
+    unsigned long long hash;
+} Asset;
+
+static const struct { const char* ext; const char* mime; int compress; } mime_types[] = {
+    { "html",  "text/html; charset=utf-8", 1 },
+    { "htm",   "text/html; charset=utf-8", 1 },
+    { "css",   "text/css; charset=utf-8", 1 },
+    { "js",    "application/javascript; charset=utf-8", 1 },
+    { "mjs",   "application/javascript; charset=utf-8", 1 },
+    { "json",  "application/json", 1 },
+    { "map",   "application/json", 1 },
+    { "txt",   "text/plain; charset=utf-8", 1 },
+    { "xml",   "application/xml", 1 },
+    { "svg",   "image/svg+xml", 1 },
+    { "wasm",  "application/wasm", 1 },
+    { "ico",   "image/x-icon", 1 },
+    { "ttf",   "font/ttf", 1 },
+    { "png",   "image/png", 0 },
+    { "jpg",   "image/jpeg", 0 },
+    { "jpeg",  "image/jpeg", 0 },
+    { "gif",   "image/gif", 0 },
+    { "webp",  "image/webp", 0 },
+    { "woff",  "font/woff", 0 },
+    { "woff2", "font/woff2", 0 },
+};
+
+static int mime_index(const char* path) {
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    if (!dot || (slash && dot < slash)) return -1;
+    for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+        const char* a = dot + 1;
+        const char* b = mime_types[i].ext;
+        while (*a && *b && (*a | 0x20) == *b) a++, b++;
+        if (!*a && !*b) return (int)i;
+    }
+    return -1;
+}
+
+static unsigned char* read_binary(const char* path, size_t* out_len) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 4096, len = 0;
+    unsigned char* buf = (unsigned char*)malloc(cap);
+    while (buf) {
+        if (len == cap) {
+            unsigned char* grown = (unsigned char*)realloc(buf, cap * 2);
+            if (!grown) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+        size_t n = fread(buf + len, 1, cap - len, f);
+        if (n == 0) break;
+        len += n;
+    }
+    fclose(f);
+    *out_len = len;
+    return buf;
+}
+
+// Must match wce_asset_hash() in webcee.c
+static uint32_t asset_hash(uint32_t seed, const char* s) {
+    uint32_t h = 2166136261u ^ (seed * 0x9E3779B1u);
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+// Hash-and-displace perfect hash: keys go to buckets by the unseeded hash,
+// and each bucket, largest first, gets the first seed that places all of its
+// keys in free slots. Fills slot_of[] and disp[]; returns 0 when some bucket
+// found no seed.
+static int perfect_hash(Asset* assets, int count, int slots, int buckets, int* slot_of, uint16_t* disp) {
+    int* bucket_of = (int*)malloc(sizeof(int) * (size_t)(count + 1));
+    int* order = (int*)malloc(sizeof(int) * (size_t)(buckets + 1));
+    int* size = (int*)calloc((size_t)buckets, sizeof(int));
+    char* taken = (char*)calloc((size_t)slots, 1);
+    int ok = bucket_of && order && size && taken;
+    for (int i = 0; ok && i < count; i++) {
+        bucket_of[i] = (int)(asset_hash(0, assets[i].path) % (uint32_t)buckets);
+        size[bucket_of[i]]++;
+    }
+    for (int b = 0; ok && b < buckets; b++) {
+        int j = b;
+        while (j > 0 && size[order[j - 1]] < size[b]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = b;
+        disp[b] = 0;
+    }
+    for (int k = 0; ok && k < buckets && size[order[k]]; k++) {
+        int b = order[k];
+        int placed = 0;
+        for (uint32_t seed = 1; seed <= 0xFFFF && !placed; seed++) {
+            placed = 1;
+            for (int i = 0; i < count && placed; i++) {
+                if (bucket_of[i] != b) continue;
+                int s = (int)(asset_hash(seed, assets[i].path) % (uint32_t)slots);
+                if (taken[s]) placed = 0;
+                else {
+                    taken[s] = 1;
+                    slot_of[i] = s;
+                }
+            }
+            if (!placed) {
+                // Undo this seed's partial placement
+                for (int i = 0; i < count; i++) {
+                    if (bucket_of[i] != b) continue;
+                    int s = (int)(asset_hash(seed, assets[i].path) % (uint32_t)slots);
+                    if (slot_of[i] == s && taken[s]) {
+                        taken[s] = 0;
+                        slot_of[i] = -1;
+                    }
+                }
+            } else {
+                disp[b] = (uint16_t)seed;
+            }
+        }
+        if (!placed) ok = 0;
+    }
+    free(bucket_of);
+    free(order);
+    free(size);
+    free(taken);
+    return ok;
+}
+
+static void emit_bytes(FILE* out, const char* name, int index, const unsigned char* data, size_t len) {
+    fprintf(out, "static const unsigned char %s_%d[%zu] = {", name, index, len);
+    for (size_t i = 0; i < len; i++) {
+        fprintf(out, "%s0x%02x,", i % 16 ? " " : "\n    ", data[i]);
+    }
+    fprintf(out, "\n};\n\n");
+}
+
+static void emit_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20 || c >= 0x7F || c == '?') fprintf(out, "\\%03o", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+int assets_generate(const char* root_dir, const char* const* files, int count, FILE* out) {
+    Asset* assets = (Asset*)calloc((size_t)count + 1, sizeof(Asset));
+    if (!assets) return 1;
+    int failed = 0;
+    for (int i = 0; i < count && !failed; i++) {
+        char full[1024];
+        snprintf(full, sizeof(full), "%s/%s", root_dir, files[i]);
+        Asset* a = &assets[i];
+        a->data = read_binary(full, &a->len);
+        if (!a->data) {
+            printf("Error: Could not read asset '%s'\n", full);
+            failed = 1;
+            break;
+        }
+        size_t plen = strlen(files[i]);
+        a->path = (char*)malloc(plen + 2);
+        if (!a->path) {
+            failed = 1;
+            break;
+        }
+        a->path[0] = '/';
+        const char* f = files[i];
+        while (*f == '/' || *f == '\\' || (f[0] == '.' && (f[1] == '/' || f[1] == '\\'))) f += (*f == '.') ? 2 : 1;
+        size_t j = 1;
+        for (; *f; f++) a->path[j++] = *f == '\\' ? '/' : *f;
+        a->path[j] = '\0';
+        for (int k = 0; k < i; k++) {
+            if (strcmp(assets[k].path, a->path) == 0) {
+                printf("Error: Duplicate asset path '%s'\n", a->path);
+                failed = 1;
+            }
+        }
+
+        int m = mime_index(a->path);
+        a->mime = m >= 0 ? mime_types[m].mime : "application/octet-stream";
+        // Kept only when it saves at least an eighth
+        if (m >= 0 && mime_types[m].compress && a->len >= 256) {
+            a->gzip = assets_gzip(a->data, a->len, &a->gzip_len);
+            if (a->gzip && a->gzip_len > a->len - a->len / 8) {
+                free(a->gzip);
+                a->gzip = NULL;
+            }
+        }
+        unsigned long long h = 14695981039346656037ULL;
+        for (size_t k = 0; k < a->len; k++) h = (h ^ a->data[k]) * 1099511628211ULL;
+        a->hash = h;
+    }
+
+    // Minimal table when possible; a little slack if no seed set is found
+    int slots = count > 0 ? count : 1;
+    int buckets = count / 4 + 1;
+    int* slot_of = (int*)malloc(sizeof(int) * (size_t)(count + 1));
+    uint16_t* disp = NULL;
+    while (!failed) {
+        free(disp);
+        disp = (uint16_t*)malloc(sizeof(uint16_t) * (size_t)buckets);
+        if (!slot_of || !disp) failed = 1;
+        else {
+            for (int i = 0; i < count; i++) slot_of[i] = -1;
+            if (perfect_hash(assets, count, slots, buckets, slot_of, disp)) break;
+            slots += slots / 8 + 1;
+            buckets += buckets / 4 + 1;
+        }
+    }
+
+    if (!failed) {
+        fprintf(out, "// Generated by WebCee Compiler\n");
+        fprintf(out, "// Embedded assets from %s (path, type, bytes, gzip bytes, ?v= version):\n", root_dir);
+        for (int i = 0; i < count; i++) {
+            fprintf(out, "//   %-32s %-40s %8zu %8zu  %016llx\n", assets[i].path, assets[i].mime,
+                assets[i].len, assets[i].gzip ? assets[i].gzip_len : 0, assets[i].hash);
+        }
+        fprintf(out, "#include \"webcee.h\"\n\n");
+        for (int i = 0; i < count; i++) {
+            if (assets[i].len) emit_bytes(out, "wce_asset_data", i, assets[i].data, assets[i].len);
+            if (assets[i].gzip) emit_bytes(out, "wce_asset_gzip", i, assets[i].gzip, assets[i].gzip_len);
+        }
+
+        // Table in slot order; empty slots have a NULL path
+        int* at_slot = (int*)malloc(sizeof(int) * (size_t)slots);
+        for (int s = 0; at_slot && s < slots; s++) at_slot[s] = -1;
+        for (int i = 0; at_slot && i < count; i++) at_slot[slot_of[i]] = i;
+        fprintf(out, "static const wce_asset_t wce_asset_table[%d] = {\n", slots);
+        for (int s = 0; at_slot && s < slots; s++) {
+            int i = at_slot[s];
+            if (i < 0) {
+                fprintf(out, "    { 0 },\n");
+                continue;
+            }
+            Asset* a = &assets[i];
+            fprintf(out, "    { ");
+            emit_string(out, a->path);
+            fprintf(out, ", \"%s\",\n      ", a->mime);
+            if (a->len) fprintf(out, "wce_asset_data_%d, %zu, ", i, a->len);
+            else fprintf(out, "(const unsigned char*)\"\", 0, ");
+            if (a->gzip) fprintf(out, "wce_asset_gzip_%d, %zu,\n", i, a->gzip_len);
+            else fprintf(out, "NULL, 0,\n");
+            fprintf(out, "      \"\\\"wce-%016llx\\\"\", \"\\\"wce-%016llx-gz\\\"\" },\n", a->hash, a->hash);
+        }
+        fprintf(out, "};\n\n");
+        fprintf(out, "static const unsigned short wce_asset_disp[%d] = {", buckets);
+        for (int b = 0; b < buckets; b++) fprintf(out, "%s%u,", b % 16 ? " " : "\n    ", disp[b]);
+        fprintf(out, "\n};\n\n");
+        fprintf(out, "const wce_asset_bundle_t wce_assets = { wce_asset_table, %d, wce_asset_disp, %d };\n",
+            slots, buckets);
+        failed = !at_slot;
+        free(at_slot);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(assets[i].path);
+        free(assets[i].data);
+        free(assets[i].gzip);
+    }
+    free(assets);
+    free(slot_of);
+    free(disp);
+    return failed;
+}
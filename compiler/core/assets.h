@@ -0,0 +1,16 @@
+#ifndef WEBCEE_ASSETS_H
+#define WEBCEE_ASSETS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Embeds static files into a C source defining `const wce_asset_bundle_t wce_assets`
+// (see wce_register_assets() in webcee.h). `files` are paths relative to `root_dir`
+// and become URL paths ("css/app.css" -> "/css/app.css"). Returns 0 on success.
+int assets_generate(const char* root_dir, const char* const* files, int count, FILE* out);
+
+// gzip (RFC 1952) of data[0..len), DEFLATE with dynamic Huffman blocks.
+// Returns a malloc'd buffer, or NULL when out of memory.
+unsigned char* assets_gzip(const unsigned char* data, size_t len, size_t* out_len);
+
+#endif // WEBCEE_ASSETS_H
@@ -29,3 +29,39 @@ void ast_node_add_child(WceAstNode* parent, WceAstNode* child) {
 
 // ast_node_destroy is removed as memory is managed by MemoryPool
 
+
+static int type_has_word(const char* type_name, const char* word) {
+    size_t len = strlen(word);
+    const char* p = type_name;
+    while ((p = strstr(p, word)) != NULL) {
+        int starts = (p == type_name || p[-1] == ' ');
+        int ends = (p[len] == '\0' || p[len] == ' ' || p[len] == '*');
+        if (starts && ends) return 1;
+        p += len;
+    }
+    return 0;
+}
+
+FieldKind ast_field_kind(const char* type_name, int array_len) {
+    static const char* signed_words[] = { "int", "short", "long", "signed", "int8_t", "int16_t", "int32_t", "int64_t", "ssize_t" };
+    static const char* unsigned_words[] = { "unsigned", "uint8_t", "uint16_t", "uint32_t", "uint64_t", "size_t" };
+    if (!type_name) return FIELD_INVALID;
+    int pointer = strchr(type_name, '*') != NULL;
+
+    if (type_has_word(type_name, "char") && !type_has_word(type_name, "unsigned") && !type_has_word(type_name, "signed")) {
+        if (pointer && !array_len && strchr(type_name, '*') == strrchr(type_name, '*')) return FIELD_STRING;
+        if (!pointer && array_len > 0) return FIELD_CHAR_ARRAY;
+        if (!pointer && !array_len) return FIELD_INT;
+        return FIELD_INVALID;
+    }
+    if (pointer || array_len) return FIELD_INVALID;
+    if (type_has_word(type_name, "float") || type_has_word(type_name, "double")) return FIELD_FLOAT;
+    if (type_has_word(type_name, "bool") || type_has_word(type_name, "_Bool")) return FIELD_BOOL;
+    for (size_t i = 0; i < sizeof(unsigned_words) / sizeof(unsigned_words[0]); i++) {
+        if (type_has_word(type_name, unsigned_words[i])) return FIELD_UINT;
+    }
+    for (size_t i = 0; i < sizeof(signed_words) / sizeof(signed_words[0]); i++) {
+        if (type_has_word(type_name, signed_words[i])) return FIELD_INT;
+    }
+    return FIELD_INVALID;
+}
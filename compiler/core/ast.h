@@ -12,9 +12,22 @@ typedef enum {
     NODE_IDENTIFIER,
     NODE_BLOCK,
     NODE_IF,
-    NODE_FOR
+    NODE_FOR,
+    NODE_TYPE_DECL,  // WCE_TYPE_BEGIN(Name) ... WCE_TYPE_END, children are NODE_FIELD
+    NODE_FIELD       // string_value=field name, number_value=array length (0: scalar), child[0]=C type
 } AstNodeType;
 
+// JSON encoding of a struct field, derived from its C type
+typedef enum {
+    FIELD_INVALID,
+    FIELD_INT,          // signed integers
+    FIELD_UINT,         // unsigned integers, size_t
+    FIELD_FLOAT,        // float, double
+    FIELD_BOOL,         // bool, _Bool
+    FIELD_CHAR_ARRAY,   // char name[N]: string of at most N bytes
+    FIELD_STRING        // char* / const char*: NUL-terminated, NULL -> null
+} FieldKind;
+
 typedef struct WceAstNode WceAstNode;
 
 struct WceAstNode {
@@ -41,6 +54,8 @@ struct WceAstNode {
 // 创建节点
 WceAstNode* ast_node_create(MemoryPool* pool, AstNodeType type, Token token);
 void ast_node_add_child(WceAstNode* parent, WceAstNode* child);
+// 字段类型分类 (type_name 为规范化的 C 类型拼写，如 "unsigned int" / "const char*")
+FieldKind ast_field_kind(const char* type_name, int array_len);
 // void ast_node_destroy(WceAstNode* node); // Managed by MemoryPool
 
 #endif // WEBCEE_AST_H
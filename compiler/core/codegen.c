@@ -1,5 +1,8 @@
 #include "codegen.h"
 #include "token.h"
+#include "../../include/webcee_page.h" // Page shell shared with the runtime renderer
+#include <stdlib.h>
+#include <string.h>
 
 static void generate_expression(WceAstNode* node, FILE* out);
 static void generate_statement(WceAstNode* node, FILE* out, int indent);
@@ -52,8 +55,26 @@ static void generate_expression(WceAstNode* node, FILE* out) {
     }
 }
 
+static int is_data_list(const WceAstNode* node) {
+    return node->type == NODE_FUNCTION_CALL && node->string_value && strcmp(node->string_value, "WCE_DATA_LIST") == 0;
+}
+
+// WCE_DATA_LIST argument i (validated by the parser: four string literals)
+static const char* data_list_arg(const WceAstNode* node, int i) {
+    const WceAstNode* arg = node->first_child;
+    while (arg && i--) arg = arg->next_sibling;
+    return arg ? arg->string_value : "";
+}
+
 static void generate_statement(WceAstNode* node, FILE* out, int indent) {
     if (!node) return;
+    if (node->type == NODE_TYPE_DECL) return; // emitted by codegen_generate_header()
+
+    if (is_data_list(node)) {
+        print_indent(out, indent);
+        fprintf(out, "wce_register_list(\"%s\", wce_list_%s);\n", data_list_arg(node, 0), data_list_arg(node, 1));
+        return;
+    }
     
     if (node->type == NODE_BLOCK) {
         print_indent(out, indent);
@@ -133,3 +154,517 @@ static void generate_statement(WceAstNode* node, FILE* out, int indent) {
     generate_expression(node, out);
     fprintf(out, ";\n");
 }
+
+// --- Struct Serializers (WCE_TYPE_BEGIN / WCE_DATA_LIST) ---
+
+#define MAX_DECLS 64
+
+typedef struct {
+    WceAstNode* types[MAX_DECLS];
+    int type_count;
+    WceAstNode* lists[MAX_DECLS];
+    int list_count;
+} DeclSet;
+
+static void collect_decls(WceAstNode* node, DeclSet* set) {
+    for (; node; node = node->next_sibling) {
+        if (node->type == NODE_TYPE_DECL && set->type_count < MAX_DECLS) {
+            set->types[set->type_count++] = node;
+        } else if (is_data_list(node) && set->list_count < MAX_DECLS) {
+            // One writer per C array, even if several lists share it
+            int seen = 0;
+            for (int i = 0; i < set->list_count; i++) {
+                if (strcmp(data_list_arg(set->lists[i], 1), data_list_arg(node, 1)) == 0) seen = 1;
+            }
+            if (!seen) set->lists[set->list_count++] = node;
+        }
+        collect_decls(node->first_child, set);
+        collect_decls(node->block, set);
+    }
+}
+
+static const char* field_type(const WceAstNode* field) {
+    return field->first_child ? field->first_child->string_value : "";
+}
+
+static FieldKind field_kind(const WceAstNode* field) {
+    return ast_field_kind(field_type(field), (int)field->number_value);
+}
+
+void codegen_generate_header(WceAstNode* root, FILE* out) {
+    DeclSet set = {0};
+    collect_decls(root, &set);
+    if (!set.type_count) return;
+
+    fprintf(out, "#include <stdint.h>\n");
+    fprintf(out, "#include <stdbool.h>\n\n");
+    fprintf(out, "struct wce_stream;\n\n");
+    for (int i = 0; i < set.type_count; i++) {
+        WceAstNode* type = set.types[i];
+        fprintf(out, "typedef struct {\n");
+        for (WceAstNode* f = type->first_child; f; f = f->next_sibling) {
+            fprintf(out, "    %s %s", field_type(f), f->string_value);
+            if (f->number_value > 0) fprintf(out, "[%d]", (int)f->number_value);
+            fprintf(out, ";\n");
+        }
+        fprintf(out, "} %s;\n\n", type->string_value);
+        fprintf(out, "// Writes one %s as a JSON object\n", type->string_value);
+        fprintf(out, "void wce_json_%s(struct wce_stream* out, const %s* v);\n\n", type->string_value, type->string_value);
+    }
+    for (int i = 0; i < set.list_count; i++) {
+        WceAstNode* list = set.lists[i];
+        fprintf(out, "// WCE_DATA_LIST(\"%s\"): defined by the application\n", data_list_arg(list, 0));
+        fprintf(out, "extern %s %s[];\n", data_list_arg(list, 3), data_list_arg(list, 1));
+        fprintf(out, "extern int %s;\n\n", data_list_arg(list, 2));
+    }
+}
+
+// Bytes a scalar field can take once formatted
+static int value_width(FieldKind kind) {
+    switch (kind) {
+        case FIELD_INT:
+        case FIELD_UINT:  return 20;
+        case FIELD_BOOL:  return 5;
+        case FIELD_FLOAT: return 32;
+        default:          return 0;
+    }
+}
+
+static int is_string_kind(FieldKind kind) {
+    return kind == FIELD_CHAR_ARRAY || kind == FIELD_STRING;
+}
+
+// The key literal precedes every value: {"name": for the first field and
+// ,"name": after it. Field names are C identifiers, so nothing needs escaping.
+static void generate_key(const WceAstNode* field, int first, FILE* out) {
+    int len = (int)strlen(field->string_value) + 4;
+    fprintf(out, "    memcpy(p, \"%s\\\"%s\\\":\", %d); p += %d;\n", first ? "{" : ",", field->string_value, len, len);
+}
+
+static void generate_value(const WceAstNode* field, FILE* out) {
+    const char* name = field->string_value;
+    switch (field_kind(field)) {
+        case FIELD_INT:
+            fprintf(out, "    p = wce__fmt_i64(p, (long long)v->%s);\n", name);
+            break;
+        case FIELD_UINT:
+            fprintf(out, "    p = wce__fmt_u64(p, (unsigned long long)v->%s);\n", name);
+            break;
+        case FIELD_BOOL:
+            fprintf(out, "    if (v->%s) { memcpy(p, \"true\", 4); p += 4; } else { memcpy(p, \"false\", 5); p += 5; }\n", name);
+            break;
+        case FIELD_FLOAT:
+            fprintf(out, "    p = wce__fmt_double(p, (double)v->%s, %d);\n", name, strstr(field_type(field), "float") ? 9 : 17);
+            break;
+        case FIELD_CHAR_ARRAY:
+            fprintf(out, "    wce_stream_json_string(out, v->%s, sizeof(v->%s));\n", name, name);
+            break;
+        case FIELD_STRING:
+            fprintf(out, "    wce_stream_json_string(out, v->%s, (size_t)-1);\n", name);
+            break;
+        default:
+            break;
+    }
+}
+
+// Limit of one wce_stream_reserve() call: WCE_STREAM_RESERVE_MAX in webcee.h,
+// which the generated code checks this against when it is compiled.
+#define STREAM_RESERVE_MAX 1024
+
+// Bytes a field takes in a reservation: the key, and the value for scalars.
+static int field_need(const WceAstNode* field) {
+    int need = (int)strlen(field->string_value) + 4;
+    FieldKind kind = field_kind(field);
+    return is_string_kind(kind) ? need : need + value_width(kind);
+}
+
+// Scalars between string fields are written into one reservation of the
+// stream buffer, split where a run would exceed the reservation limit;
+// strings are escaped into the buffer by the runtime.
+static void generate_serializer(WceAstNode* type, FILE* out) {
+    fprintf(out, "void wce_json_%s(struct wce_stream* out, const %s* v) {\n", type->string_value, type->string_value);
+    fprintf(out, "    char* p;\n");
+    WceAstNode* f = type->first_child;
+    int first = 1;
+    int largest = 0;
+    for (;;) {
+        // The reservation covers fields [f, g): scalars, up to the key of a
+        // string, plus the closing brace when it reaches the end.
+        int need = 0;
+        int ends_in_string = 0;
+        WceAstNode* g = f;
+        for (; g; g = g->next_sibling) {
+            int n = field_need(g);
+            if (need && need + n > STREAM_RESERVE_MAX - 1) break;
+            need += n;
+            if (is_string_kind(field_kind(g))) {
+                g = g->next_sibling;
+                ends_in_string = 1;
+                break;
+            }
+        }
+        int closes = !g && !ends_in_string;
+        if (closes) need += first ? 2 : 1; // "{}" for a struct without fields
+        if (need > largest) largest = need;
+
+        fprintf(out, "    p = wce_stream_reserve(out, %d);\n", need);
+        fprintf(out, "    if (!p) return;\n");
+        for (; f != g; f = f->next_sibling) {
+            generate_key(f, first, out);
+            first = 0;
+            if (is_string_kind(field_kind(f))) fprintf(out, "    wce_stream_commit(out, p);\n");
+            generate_value(f, out);
+        }
+        if (closes) {
+            fprintf(out, first ? "    memcpy(p, \"{}\", 2); p += 2;\n" : "    *p++ = '}';\n");
+            fprintf(out, "    wce_stream_commit(out, p);\n");
+            break;
+        }
+        if (!ends_in_string) fprintf(out, "    wce_stream_commit(out, p);\n");
+    }
+    fprintf(out, "}\n");
+    fprintf(out, "typedef char wce__reserve_check_%s[(%d <= WCE_STREAM_RESERVE_MAX) ? 1 : -1];\n\n",
+        type->string_value, largest);
+}
+
+static void generate_list_writer(WceAstNode* list, FILE* out) {
+    const char* array = data_list_arg(list, 1);
+    fprintf(out, "static void wce_list_%s(struct wce_stream* out) {\n", array);
+    fprintf(out, "    wce_stream_write(out, \"[\", 1);\n");
+    fprintf(out, "    for (int i = 0; i < %s; i++) {\n", data_list_arg(list, 2));
+    fprintf(out, "        if (i && wce_stream_write(out, \",\", 1) != 0) return;\n");
+    fprintf(out, "        wce_json_%s(out, &%s[i]);\n", data_list_arg(list, 3), array);
+    fprintf(out, "    }\n");
+    fprintf(out, "    wce_stream_write(out, \"]\", 1);\n");
+    fprintf(out, "}\n\n");
+}
+
+void codegen_generate_serializers(WceAstNode* root, FILE* out) {
+    DeclSet set = {0};
+    collect_decls(root, &set);
+    if (!set.type_count) return;
+
+    // Integer formatting two digits at a time, no printf on the hot path
+    fprintf(out, "#include <stdio.h>\n");
+    fprintf(out, "#include <string.h>\n\n");
+    fprintf(out, "static const char wce__digits[] =\n");
+    for (int row = 0; row < 5; row++) {
+        fprintf(out, "    \"");
+        for (int i = row * 20; i < row * 20 + 20; i++) fprintf(out, "%02d", i);
+        fprintf(out, "\"%s\n", row == 4 ? ";" : "");
+    }
+    fprintf(out, "\n");
+    fprintf(out, "static inline char* wce__fmt_u64(char* p, unsigned long long v) {\n");
+    fprintf(out, "    char tmp[20];\n");
+    fprintf(out, "    char* t = tmp + sizeof(tmp);\n");
+    fprintf(out, "    while (v >= 100) {\n");
+    fprintf(out, "        unsigned d = (unsigned)(v %% 100) * 2;\n");
+    fprintf(out, "        v /= 100;\n");
+    fprintf(out, "        *--t = wce__digits[d + 1];\n");
+    fprintf(out, "        *--t = wce__digits[d];\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    if (v >= 10) {\n");
+    fprintf(out, "        *--t = wce__digits[v * 2 + 1];\n");
+    fprintf(out, "        *--t = wce__digits[v * 2];\n");
+    fprintf(out, "    } else {\n");
+    fprintf(out, "        *--t = (char)('0' + v);\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    size_t n = (size_t)(tmp + sizeof(tmp) - t);\n");
+    fprintf(out, "    memcpy(p, t, n);\n");
+    fprintf(out, "    return p + n;\n");
+    fprintf(out, "}\n\n");
+    fprintf(out, "static inline char* wce__fmt_i64(char* p, long long v) {\n");
+    fprintf(out, "    if (v < 0) {\n");
+    fprintf(out, "        *p++ = '-';\n");
+    fprintf(out, "        return wce__fmt_u64(p, 0ULL - (unsigned long long)v);\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    return wce__fmt_u64(p, (unsigned long long)v);\n");
+    fprintf(out, "}\n\n");
+    fprintf(out, "// JSON has no NaN/Infinity: those become null\n");
+    fprintf(out, "static inline char* wce__fmt_double(char* p, double v, int digits) {\n");
+    fprintf(out, "    if (v != v || v - v != 0) {\n");
+    fprintf(out, "        memcpy(p, \"null\", 4);\n");
+    fprintf(out, "        return p + 4;\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    return p + snprintf(p, 32, \"%%.*g\", digits, v);\n");
+    fprintf(out, "}\n\n");
+
+    for (int i = 0; i < set.type_count; i++) generate_serializer(set.types[i], out);
+    for (int i = 0; i < set.list_count; i++) generate_list_writer(set.lists[i], out);
+}
+
+// --- Pre-rendered Page ---
+// A layout made only of builder calls with string literal arguments always
+// produces the same tree, so its page is rendered here, at compile time,
+// into a constant the runtime serves as is (wce_register_page). The calls
+// are interpreted the way webcee_build.h executes them: *_begin pushes a
+// scope, wce_css / wce_bind / wce_on_click / wce_id set the innermost scope's node,
+// and the first node pushed is the root. Markup and escaping follow
+// wce_html_open() / wce_html_close() in webcee.c, and the page shell is
+// shared through webcee_page.h, so the bytes are the ones wce_render_dom()
+// returns for the same tree. Anything else (wce_if, wce_for, expressions,
+// unknown calls, strings with C escapes) leaves the page to the runtime.
+
+typedef struct {
+    const char* open;       // Markup up to the attributes; NULL for leaves
+    const char* tag;        // Leaves: "span" / "button" / "input"
+    const char* label;
+    const char* style;
+    const char* bind;
+    const char* click;
+    const char* id;
+    int first_child;
+    int last_child;
+    int next_sibling;
+} PageNode;
+
+typedef struct {
+    PageNode* nodes;
+    int count;
+    int cap;
+    int* stack;
+    int top;
+    int stack_cap;
+    int root;
+    char* out;
+    size_t len;
+    size_t out_cap;
+} PageBuilder;
+
+static const struct { const char* name; const char* open; } page_containers[] = {
+    { "wce_container", "<div class='container'" },
+    { "wce_row",       "<div class='row'" },
+    { "wce_col",       "<div class='col'" },
+    { "wce_card",      "<div class='card'" },
+    { "wce_panel",     "<div class='panel'" },
+};
+
+static const struct { const char* name; const char* tag; } page_leaves[] = {
+    { "wce_text",   "span" },
+    { "wce_button", "button" },
+    { "wce_input",  "input" },
+};
+
+// The single string literal argument of a call, or NULL. A backslash means
+// the C compiler would see a different string than the one in the AST.
+static const char* page_string_arg(const WceAstNode* call) {
+    const WceAstNode* arg = call->first_child;
+    if (!arg || arg->next_sibling || arg->type != NODE_STRING_LITERAL || !arg->string_value) return NULL;
+    if (strchr(arg->string_value, '\\')) return NULL;
+    return arg->string_value;
+}
+
+static int page_node_add(PageBuilder* b, const char* open, const char* tag, const char* label) {
+    if (b->count == b->cap) {
+        int cap = b->cap ? b->cap * 2 : 64;
+        PageNode* nodes = (PageNode*)realloc(b->nodes, (size_t)cap * sizeof(PageNode));
+        if (!nodes) return -1;
+        b->nodes = nodes;
+        b->cap = cap;
+    }
+    int id = b->count++;
+    PageNode* n = &b->nodes[id];
+    memset(n, 0, sizeof(*n));
+    n->open = open;
+    n->tag = tag;
+    n->label = label;
+    n->first_child = n->last_child = n->next_sibling = -1;
+    if (b->top >= 0) {
+        PageNode* parent = &b->nodes[b->stack[b->top]];
+        if (parent->first_child < 0) parent->first_child = id;
+        else b->nodes[parent->last_child].next_sibling = id;
+        parent->last_child = id;
+    }
+    return id;
+}
+
+static int page_statements(PageBuilder* b, const WceAstNode* node);
+
+// Pushes `id`, interprets the block, pops.
+static int page_scope(PageBuilder* b, int id, const WceAstNode* block) {
+    if (b->top + 1 >= b->stack_cap) {
+        int cap = b->stack_cap ? b->stack_cap * 2 : 32;
+        int* stack = (int*)realloc(b->stack, (size_t)cap * sizeof(int));
+        if (!stack) return 0;
+        b->stack = stack;
+        b->stack_cap = cap;
+    }
+    b->stack[++b->top] = id;
+    if (b->root < 0) b->root = id;
+    int ok = page_statements(b, block->first_child);
+    b->top--;
+    return ok;
+}
+
+// Returns 0 when the statements cannot be evaluated at compile time.
+static int page_statements(PageBuilder* b, const WceAstNode* node) {
+    for (; node; node = node->next_sibling) {
+        if (node->type == NODE_TYPE_DECL || is_data_list(node)) continue;
+        if (node->type == NODE_BLOCK) {
+            if (!page_statements(b, node->first_child)) return 0;
+            continue;
+        }
+        if (node->type != NODE_FUNCTION_CALL || !node->string_value) return 0;
+        const char* name = node->string_value;
+        int known = 0;
+
+        for (size_t i = 0; i < sizeof(page_containers) / sizeof(page_containers[0]); i++) {
+            if (strcmp(name, page_containers[i].name) != 0) continue;
+            if (node->first_child || !node->block) return 0;
+            int id = page_node_add(b, page_containers[i].open, NULL, NULL);
+            if (id < 0 || !page_scope(b, id, node->block)) return 0;
+            known = 1;
+        }
+        for (size_t i = 0; i < sizeof(page_leaves) / sizeof(page_leaves[0]); i++) {
+            if (strcmp(name, page_leaves[i].name) != 0) continue;
+            const char* label = page_string_arg(node);
+            if (!label) return 0;
+            int id = page_node_add(b, NULL, page_leaves[i].tag, label);
+            if (id < 0 || (node->block && !page_scope(b, id, node->block))) return 0;
+            known = 1;
+        }
+        if (!known) {
+            const char* value = page_string_arg(node);
+            if (!value || node->block) return 0;
+            PageNode* target = b->top >= 0 ? &b->nodes[b->stack[b->top]] : NULL;
+            if (strcmp(name, "wce_css") == 0) {
+                if (target) target->style = value;
+            } else if (strcmp(name, "wce_bind") == 0) {
+                if (target) target->bind = value;
+            } else if (strcmp(name, "wce_on_click") == 0) {
+                if (target) target->click = value;
+            } else if (strcmp(name, "wce_id") == 0) {
+                if (target) target->id = value;
+            } else {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static void page_put(PageBuilder* b, const char* s, size_t n) {
+    if (!b->out) return;
+    if (b->len + n > b->out_cap) {
+        size_t cap = (b->out_cap + n) * 2;
+        char* out = (char*)realloc(b->out, cap);
+        if (!out) {
+            free(b->out);
+            b->out = NULL;
+            return;
+        }
+        b->out = out;
+        b->out_cap = cap;
+    }
+    memcpy(b->out + b->len, s, n);
+    b->len += n;
+}
+
+static void page_puts(PageBuilder* b, const char* s) {
+    page_put(b, s, strlen(s));
+}
+
+// Same entities as wce_html_entity[] in webcee.c.
+static void page_escaped(PageBuilder* b, const char* s) {
+    for (; *s; s++) {
+        switch (*s) {
+            case '&': page_puts(b, "&amp;"); break;
+            case '<': page_puts(b, "&lt;"); break;
+            case '>': page_puts(b, "&gt;"); break;
+            case '"': page_puts(b, "&quot;"); break;
+            case '\'': page_puts(b, "&#39;"); break;
+            default: page_put(b, s, 1); break;
+        }
+    }
+}
+
+static void page_attr(PageBuilder* b, const char* open, const char* value) {
+    if (!value) return;
+    page_puts(b, open);
+    page_escaped(b, value);
+    page_puts(b, "'");
+}
+
+static void page_render(PageBuilder* b, int id) {
+    const PageNode* n = &b->nodes[id];
+    if (n->open) {
+        page_puts(b, n->open);
+        page_attr(b, " wce-id='", n->id);
+        page_attr(b, " style='", n->style);
+        page_puts(b, ">");
+    } else if (strcmp(n->tag, "input") == 0) {
+        page_puts(b, "<input type='text'");
+        page_attr(b, " wce-id='", n->id);
+        page_attr(b, " style='", n->style);
+        page_attr(b, " placeholder='", n->label);
+        page_attr(b, " wce-bind='", n->bind);
+        page_puts(b, "/>");
+    } else {
+        page_puts(b, "<");
+        page_puts(b, n->tag);
+        page_attr(b, " wce-id='", n->id);
+        page_attr(b, " style='", n->style);
+        if (strcmp(n->tag, "span") == 0) page_attr(b, " wce-bind='", n->bind);
+        else page_attr(b, " wce-click='", n->click);
+        page_puts(b, ">");
+        page_escaped(b, n->label);
+        page_puts(b, "</");
+        page_puts(b, n->tag);
+        page_puts(b, ">");
+    }
+    for (int c = n->first_child; c >= 0; c = b->nodes[c].next_sibling) page_render(b, c);
+    if (n->open) page_puts(b, "</div>");
+}
+
+// Writes `len` bytes as a C string literal, one line per ~100 characters.
+// Octal escapes are always three digits, so a following digit cannot
+// extend them, and '?' is escaped against trigraphs.
+static void page_emit_literal(FILE* out, const char* s, size_t len) {
+    int col = 0;
+    fprintf(out, "    \"");
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') col += fprintf(out, "\\%c", c);
+        else if (c == '?') col += fprintf(out, "\\?");
+        else if (c < 0x20 || c >= 0x7F) col += fprintf(out, "\\%03o", c);
+        else {
+            fputc(c, out);
+            col++;
+        }
+        if (col >= 100 && i + 1 < len) {
+            fprintf(out, "\"\n    \"");
+            col = 0;
+        }
+    }
+    fprintf(out, "\";\n");
+}
+
+int codegen_generate_page(WceAstNode* root, FILE* out) {
+    if (!root) return 0;
+    PageBuilder b;
+    memset(&b, 0, sizeof(b));
+    b.top = -1;
+    b.root = -1;
+    int ok = page_statements(&b, root->first_child) && b.root >= 0;
+    if (ok) {
+        b.out_cap = 16384;
+        b.out = (char*)malloc(b.out_cap);
+        page_put(&b, WCE_HTML_HEADER, sizeof(WCE_HTML_HEADER) - 1);
+        page_render(&b, b.root);
+        page_put(&b, WCE_HTML_FOOTER, sizeof(WCE_HTML_FOOTER) - 1);
+        ok = b.out != NULL;
+    }
+    if (ok) {
+        // Same ETag as the runtime computes for a page it renders itself
+        unsigned long long h = 14695981039346656037ULL;
+        for (size_t i = 0; i < b.len; i++) h = (h ^ (unsigned char)b.out[i]) * 1099511628211ULL;
+        fprintf(out, "// Page for the layout below, rendered by wce_tool (%zu bytes)\n", b.len);
+        fprintf(out, "static const char wce_page_html[] =\n");
+        page_emit_literal(out, b.out, b.len);
+        fprintf(out, "static const char wce_page_etag[] = \"\\\"wce-%016llx\\\"\";\n\n", h);
+    }
+    free(b.out);
+    free(b.nodes);
+    free(b.stack);
+    return ok;
+}
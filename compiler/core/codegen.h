@@ -7,4 +7,13 @@
 // Generate C code from AST
 void codegen_generate(WceAstNode* root, FILE* out);
 
+// WCE_TYPE_BEGIN / WCE_DATA_LIST support:
+// typedefs, serializer prototypes and list externs for webcee_generated.h
+void codegen_generate_header(WceAstNode* root, FILE* out);
+// Serializer and list writer definitions, emitted before wce_ui_main()
+void codegen_generate_serializers(WceAstNode* root, FILE* out);
+// Pre-rendered page (wce_page_html / wce_page_etag) for layouts without
+// runtime logic; returns 1 when emitted, 0 when the page is left to the runtime
+int codegen_generate_page(WceAstNode* root, FILE* out);
+
 #endif // WEBCEE_CODEGEN_H
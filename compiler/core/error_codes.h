@@ -13,10 +13,13 @@
 #define ERR_PARSER_EXPECTED_SEMI   105 // 期望分号
 #define ERR_PARSER_UNEXPECTED_TOK  106 // 意外的 Token
 #define ERR_PARSER_EXPECTED_LBRACE 107 // 缺少左大括号 `{`
+#define ERR_PARSER_EXPECTED_RBRACKET 108 // 缺少右方括号 `]`
+#define ERR_PARSER_EXPECTED_TYPE_END 109 // 缺少 WCE_TYPE_END
 
 // Semantic Errors (200-299)
 #define ERR_SEMANTIC_UNDEFINED     201 // 未定义的组件或函数
 #define ERR_SEMANTIC_ARG_COUNT     202 // 参数数量不匹配
 #define ERR_SEMANTIC_TYPE_MISMATCH 203 // 参数类型不匹配
+#define ERR_SEMANTIC_FIELD_TYPE    204 // 不支持的结构体字段类型
 
 #endif // WEBCEE_ERROR_CODES_H
@@ -37,7 +37,7 @@ static void advance(Lexer* l) {
 }
 
 Token lexer_next_token(Lexer* l) {
-    // 1. 跳过空白字符
+    // 1. 跳过空白字符和注释
     while (l->position < l->length) {
         char c = current(l);
         if (c == ' ' || c == '\t' || c == '\r') {
@@ -46,6 +46,26 @@ Token lexer_next_token(Lexer* l) {
             l->position++;
             l->line++;
             l->column = 1;
+        } else if (c == '/' && peek(l, 1) == '/') {
+            // 行注释：跳到行尾，换行符留给上面的分支处理
+            while (l->position < l->length && current(l) != '\n') {
+                advance(l);
+            }
+        } else if (c == '/' && peek(l, 1) == '*') {
+            // 块注释
+            advance(l);
+            advance(l);
+            while (l->position < l->length && !(current(l) == '*' && peek(l, 1) == '/')) {
+                if (current(l) == '\n') {
+                    l->position++;
+                    l->line++;
+                    l->column = 1;
+                } else {
+                    advance(l);
+                }
+            }
+            advance(l);
+            advance(l);
         } else {
             break;
         }
@@ -136,6 +156,8 @@ Token lexer_next_token(Lexer* l) {
         case ')': token.type = TOKEN_RPAREN; break;
         case '{': token.type = TOKEN_LBRACE; break;
         case '}': token.type = TOKEN_RBRACE; break;
+        case '[': token.type = TOKEN_LBRACKET; break;
+        case ']': token.type = TOKEN_RBRACKET; break;
         case ',': token.type = TOKEN_COMMA; break;
         case ';': token.type = TOKEN_SEMICOLON; break;
         
@@ -20,6 +20,9 @@ MemoryPool* memory_pool_create(size_t default_block_size) {
     pool->first_block = NULL;
     pool->current_block = NULL;
     pool->position = 0;
+    pool->bytes_reserved = 0;
+    pool->bytes_used = 0;
+    pool->block_count = 0;
 
     return pool;
 }
@@ -61,6 +64,7 @@ void* memory_pool_alloc(MemoryPool* pool, size_t size) {
     if (pool->current_block && (pool->position + aligned_size <= pool->block_size)) {
         void* ptr = pool->current_block->data + pool->position;
         pool->position += aligned_size;
+        pool->bytes_used += aligned_size;
         return ptr;
     }
 
@@ -76,6 +80,9 @@ void* memory_pool_alloc(MemoryPool* pool, size_t size) {
     }
     pool->current_block = new_block;
     pool->position = aligned_size;
+    pool->bytes_reserved += sizeof(MemoryBlock) + new_block_size;
+    pool->bytes_used += aligned_size;
+    pool->block_count++;
 
     // If we allocated a huge block just for this item, we might want to treat it differently
     // so we don't waste the rest of the huge block if the next alloc is small.
@@ -10,6 +10,9 @@ typedef struct {
     MemoryBlock* current_block;
     size_t block_size;         // Default size for new blocks
     size_t position;           // Offset in the current block
+    size_t bytes_reserved;     // Total bytes obtained from malloc (blocks only grow, so this is also the peak)
+    size_t bytes_used;         // Total bytes handed out, including alignment padding
+    size_t block_count;        // Number of blocks allocated
 } MemoryPool;
 
 // Create a new memory pool
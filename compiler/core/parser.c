@@ -17,6 +17,8 @@ static WceAstNode* parse_primary(Parser* p);
 static WceAstNode* parse_block(Parser* p);
 static WceAstNode* parse_if_statement(Parser* p);
 static WceAstNode* parse_for_statement(Parser* p);
+static WceAstNode* parse_type_decl(Parser* p);
+static void check_data_lists(Parser* p, WceAstNode* root);
 static WceAstNode* parse_term(Parser* p);
 static WceAstNode* parse_factor(Parser* p);
 static WceAstNode* parse_primary(Parser* p);
@@ -91,11 +93,27 @@ WceAstNode* parser_parse(Parser* p) {
         } else {
             if (p->panic_mode) synchronize(p);
             else advance(p);
+            // An unmatched '}' stops synchronize() but never closes anything here
+            if (p->current_token.type == TOKEN_RBRACE) advance(p);
         }
     }
+    check_data_lists(p, root);
     return root;
 }
 
+static int token_is(Token t, const char* text) {
+    return t.type == TOKEN_IDENTIFIER && (int)strlen(text) == t.length && strncmp(t.text, text, t.length) == 0;
+}
+
+static char* copy_token_text(Parser* p, Token t) {
+    char* s = (char*)memory_pool_alloc(p->pool, t.length + 1);
+    if (s) {
+        strncpy(s, t.text, t.length);
+        s[t.length] = '\0';
+    }
+    return s;
+}
+
 static WceAstNode* parse_statement(Parser* p) {
     if (p->current_token.type == TOKEN_LBRACE) {
         return parse_block(p);
@@ -106,6 +124,9 @@ static WceAstNode* parse_statement(Parser* p) {
     if (p->current_token.type == TOKEN_KW_FOR) {
         return parse_for_statement(p);
     }
+    if (token_is(p->current_token, "WCE_TYPE_BEGIN")) {
+        return parse_type_decl(p);
+    }
     
     // Expression statement (function call, assignment, etc.)
     WceAstNode* expr = parse_expression(p);
@@ -206,6 +227,143 @@ static WceAstNode* parse_for_statement(Parser* p) {
     return node;
 }
 
+// Field: C type words and '*', the field name, optional [N], ';'
+static WceAstNode* parse_field_decl(Parser* p) {
+    Token words[16];
+    int count = 0;
+    Token start = p->current_token;
+    while ((p->current_token.type == TOKEN_IDENTIFIER || p->current_token.type == TOKEN_STAR) && count < 16) {
+        words[count++] = p->current_token;
+        advance(p);
+    }
+    if (count < 2 || words[count - 1].type != TOKEN_IDENTIFIER) {
+        diagnostic_report(p->diagnostics, p->lexer->file_name, start.line, start.column,
+            DIAG_ERROR, ERR_PARSER_EXPECTED_ID, "Expected field declaration");
+        p->panic_mode = 1;
+        return NULL;
+    }
+
+    WceAstNode* field = ast_node_create(p->pool, NODE_FIELD, words[count - 1]);
+    field->string_value = copy_token_text(p, words[count - 1]);
+
+    // Type spelling: words joined by single spaces, '*' attached, e.g. "const char*"
+    int type_len = 0;
+    for (int i = 0; i < count - 1; i++) type_len += words[i].length + 1;
+    WceAstNode* type = ast_node_create(p->pool, NODE_IDENTIFIER, start);
+    type->string_value = (char*)memory_pool_alloc(p->pool, type_len);
+    if (type->string_value) {
+        char* out = type->string_value;
+        for (int i = 0; i < count - 1; i++) {
+            if (i && words[i].type != TOKEN_STAR) *out++ = ' ';
+            memcpy(out, words[i].text, words[i].length);
+            out += words[i].length;
+        }
+        *out = '\0';
+    }
+    ast_node_add_child(field, type);
+
+    if (match(p, TOKEN_LBRACKET)) {
+        if (p->current_token.type == TOKEN_NUMBER) {
+            char buf[32];
+            int len = p->current_token.length < 31 ? p->current_token.length : 31;
+            strncpy(buf, p->current_token.text, len);
+            buf[len] = '\0';
+            field->number_value = atof(buf);
+            advance(p);
+        }
+        if (field->number_value < 1) {
+            diagnostic_report(p->diagnostics, p->lexer->file_name, p->current_token.line, p->current_token.column,
+                DIAG_ERROR, ERR_SEMANTIC_FIELD_TYPE, "Array length must be a positive number");
+        }
+        consume(p, TOKEN_RBRACKET, ERR_PARSER_EXPECTED_RBRACKET, "Expected ']'");
+    }
+    consume(p, TOKEN_SEMICOLON, ERR_PARSER_EXPECTED_SEMI, "Expected ';' after field");
+
+    if (ast_field_kind(type->string_value, (int)field->number_value) == FIELD_INVALID) {
+        diagnostic_report(p->diagnostics, p->lexer->file_name, field->token.line, field->token.column,
+            DIAG_ERROR, ERR_SEMANTIC_FIELD_TYPE, "Unsupported type '%s' for field '%s'",
+            type->string_value, field->string_value);
+    }
+    return field;
+}
+
+// WCE_TYPE_BEGIN(Name) <fields> WCE_TYPE_END
+static WceAstNode* parse_type_decl(Parser* p) {
+    WceAstNode* node = ast_node_create(p->pool, NODE_TYPE_DECL, p->current_token);
+    advance(p); // consume WCE_TYPE_BEGIN
+
+    consume(p, TOKEN_LPAREN, ERR_PARSER_EXPECTED_LPAREN, "Expected '('");
+    if (p->current_token.type == TOKEN_IDENTIFIER) {
+        node->string_value = copy_token_text(p, p->current_token);
+        advance(p);
+    } else if (!p->panic_mode) {
+        diagnostic_report(p->diagnostics, p->lexer->file_name, p->current_token.line, p->current_token.column,
+            DIAG_ERROR, ERR_PARSER_EXPECTED_ID, "Expected type name");
+        p->panic_mode = 1;
+    }
+    consume(p, TOKEN_RPAREN, ERR_PARSER_EXPECTED_RPAREN, "Expected ')'");
+
+    while (!token_is(p->current_token, "WCE_TYPE_END") && p->current_token.type != TOKEN_EOF) {
+        WceAstNode* field = parse_field_decl(p);
+        if (field) {
+            ast_node_add_child(node, field);
+        } else {
+            // synchronize() stops before '}', which cannot start a field either
+            if (p->panic_mode) synchronize(p);
+            if (p->current_token.type != TOKEN_EOF && !token_is(p->current_token, "WCE_TYPE_END")) advance(p);
+        }
+    }
+    consume(p, TOKEN_IDENTIFIER, ERR_PARSER_EXPECTED_TYPE_END, "Expected 'WCE_TYPE_END'");
+    match(p, TOKEN_SEMICOLON);
+
+    if (!node->first_child && node->string_value) {
+        diagnostic_report(p->diagnostics, p->lexer->file_name, node->token.line, node->token.column,
+            DIAG_ERROR, ERR_SEMANTIC_FIELD_TYPE, "Type '%s' declares no fields", node->string_value);
+    }
+    return node;
+}
+
+static WceAstNode* find_type_decl(WceAstNode* node, const char* name) {
+    for (; node; node = node->next_sibling) {
+        if (node->type == NODE_TYPE_DECL && node->string_value && strcmp(node->string_value, name) == 0) return node;
+        WceAstNode* found = find_type_decl(node->first_child, name);
+        if (!found) found = find_type_decl(node->block, name);
+        if (found) return found;
+    }
+    return NULL;
+}
+
+// WCE_DATA_LIST("js_name", "c_array", "c_count", "Type") needs four string
+// arguments and a declared Type.
+static void check_data_lists_in(Parser* p, WceAstNode* root, WceAstNode* node) {
+    for (; node; node = node->next_sibling) {
+        if (node->type == NODE_FUNCTION_CALL && node->string_value && strcmp(node->string_value, "WCE_DATA_LIST") == 0) {
+            WceAstNode* args[4] = { NULL, NULL, NULL, NULL };
+            int argc = 0;
+            for (WceAstNode* a = node->first_child; a; a = a->next_sibling) {
+                if (argc < 4) args[argc] = a;
+                argc++;
+            }
+            int strings = argc == 4;
+            for (int i = 0; i < 4 && strings; i++) strings = args[i]->type == NODE_STRING_LITERAL;
+            if (!strings) {
+                diagnostic_report(p->diagnostics, p->lexer->file_name, node->token.line, node->token.column,
+                    DIAG_ERROR, ERR_SEMANTIC_ARG_COUNT, "WCE_DATA_LIST expects 4 string arguments");
+            } else if (!find_type_decl(root, args[3]->string_value)) {
+                diagnostic_report(p->diagnostics, p->lexer->file_name, args[3]->token.line, args[3]->token.column,
+                    DIAG_ERROR, ERR_SEMANTIC_UNDEFINED, "Unknown type '%s' (declare it with WCE_TYPE_BEGIN)",
+                    args[3]->string_value);
+            }
+        }
+        check_data_lists_in(p, root, node->first_child);
+        check_data_lists_in(p, root, node->block);
+    }
+}
+
+static void check_data_lists(Parser* p, WceAstNode* root) {
+    check_data_lists_in(p, root, root->first_child);
+}
+
 static WceAstNode* parse_expression(Parser* p) {
     return parse_assignment(p);
 }
@@ -15,6 +15,8 @@ typedef enum {
     TOKEN_RPAREN,       // )
     TOKEN_LBRACE,       // {
     TOKEN_RBRACE,       // }
+    TOKEN_LBRACKET,     // [
+    TOKEN_RBRACKET,     // ]
     TOKEN_COMMA,        // ,
     TOKEN_SEMICOLON,    // ;
     
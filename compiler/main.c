@@ -7,6 +7,7 @@
 #include "core/ast.h"
 #include "core/memory_pool.h"
 #include "core/codegen.h"
+#include "core/assets.h"
 
 // Simple file reader
 char* read_file(const char* path) {
@@ -26,9 +27,63 @@ char* read_file(const char* path) {
     return content;
 }
 
+// wce --assets <root_dir> <output.c> <file|@list>...
+// Files are relative to root_dir; "@list" reads one file name per line.
+static int assets_main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("Usage: wce --assets <root_dir> <output.c> <file|@list>...\n");
+        return 1;
+    }
+    int cap = 64, count = 0;
+    const char** files = (const char**)malloc(sizeof(char*) * (size_t)cap);
+    char* lists[64];
+    int list_count = 0;
+    for (int i = 2; i < argc && files; i++) {
+        char* text = NULL;
+        if (argv[i][0] == '@') {
+            text = read_file(argv[i] + 1);
+            if (!text || list_count == 64) {
+                printf("Error: Could not read file list '%s'\n", argv[i] + 1);
+                return 1;
+            }
+            lists[list_count++] = text;
+        }
+        char* line = text ? strtok(text, "\r\n") : argv[i];
+        for (; line && files; line = text ? strtok(NULL, "\r\n") : NULL) {
+            if (count == cap) {
+                cap *= 2;
+                const char** grown = (const char**)realloc(files, sizeof(char*) * (size_t)cap);
+                if (!grown) free(files);
+                files = grown;
+                if (!files) break;
+            }
+            files[count++] = line;
+        }
+    }
+    if (!files) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+
+    FILE* out = fopen(argv[1], "wb");
+    if (!out) {
+        printf("Error: Could not open output file '%s'\n", argv[1]);
+        return 1;
+    }
+    int failed = assets_generate(argv[0], files, count, out);
+    fclose(out);
+    if (failed) remove(argv[1]);
+    else printf("Embedded %d asset(s) from '%s' into '%s'\n", count, argv[0], argv[1]);
+    for (int i = 0; i < list_count; i++) free(lists[i]);
+    free(files);
+    return failed;
+}
+
 int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "--assets") == 0) return assets_main(argc - 2, argv + 2);
     if (argc < 2) {
         printf("Usage: wce <input.wce> [output.c]\n");
+        printf("       wce --assets <root_dir> <output.c> <file|@list>...\n");
         return 1;
     }
     
@@ -61,11 +116,37 @@ int main(int argc, char** argv) {
     
     fprintf(out, "// Generated by WebCee Compiler\n");
     fprintf(out, "#include \"webcee.h\"\n\n");
-    fprintf(out, "void wce_ui_main() {\n");
+    codegen_generate_serializers(ast, out);
+    int has_page = codegen_generate_page(ast, out);
+    fprintf(out, "void wce_ui_main(void) {\n");
     codegen_generate(ast, out);
+    // The tree is still built: wce_render_dom() and later changes need it
+    if (has_page) fprintf(out, "wce_register_page(wce_page_html, sizeof(wce_page_html) - 1, wce_page_etag);\n");
     fprintf(out, "}\n");
     
     fclose(out);
+
+    // Companion header: target_add_webcee_ui() defines WEBCEE_HAS_GENERATED,
+    // which makes webcee.h include "webcee_generated.h" from the output dir.
+    char header_path[1024];
+    const char* slash = strrchr(output_path, '/');
+    const char* bslash = strrchr(output_path, '\\');
+    if (bslash && (!slash || bslash > slash)) slash = bslash;
+    int dir_len = slash ? (int)(slash - output_path + 1) : 0;
+    snprintf(header_path, sizeof(header_path), "%.*swebcee_generated.h", dir_len, output_path);
+
+    FILE* hdr = fopen(header_path, "w");
+    if (!hdr) {
+        printf("Error: Could not open output file '%s'\n", header_path);
+        return 1;
+    }
+    fprintf(hdr, "// Generated by WebCee Compiler\n");
+    fprintf(hdr, "#ifndef WEBCEE_GENERATED_H\n#define WEBCEE_GENERATED_H\n\n");
+    codegen_generate_header(ast, hdr);
+    fprintf(hdr, "void wce_ui_main(void);\n\n");
+    fprintf(hdr, "#endif // WEBCEE_GENERATED_H\n");
+    fclose(hdr);
+
     printf("Successfully compiled '%s' to '%s'\n", input_path, output_path);
     
     // Cleanup
@@ -5,26 +5,178 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+
 #define WEBCEE_API
 
 /* 初始化与启动 */
 WEBCEE_API int wce_init(int port);                    // 初始化WebCee服务
+WEBCEE_API int wce_init_unix(const char* path, int mode); // 监听 Unix 域套接字 ("@name" 为抽象命名空间，mode 如 0660，0 保持默认)
 WEBCEE_API int wce_start(void);                       // 启动服务（非阻塞）
 WEBCEE_API void wce_stop(void);                       // 停止服务
 
-/* 数据同步 (C -> 前端) */
+/* 服务配置 (wce_init_ex)：值为 0 / NULL 的字段使用默认值，非法配置使 wce_init_ex 返回 -1；
+ * header/body/idle_timeout_ms 设为 -1 表示不限时。
+ * wce_init(port) 与 wce_init_unix() 等价于只设置对应字段的 wce_init_ex。 */
+typedef struct {
+    const char* bind_addr;      // 绑定地址 (IPv4/IPv6 字面量)，默认 "0.0.0.0"
+    int port;                   // TCP 端口 (0..65535)
+    const char* unix_path;      // 非 NULL 时改为监听 Unix 域套接字 (同 wce_init_unix)
+    int unix_mode;
+    int backlog;                // 等待 accept 的连接队列长度，默认 511
+    int max_connections;        // 并发连接上限 (≤65536)，默认 65536，超出时回复 503
+    int max_header_size;        // 请求头上限 (1024..16384 字节)，默认 16384，超出时回复 431
+    long long max_body_size;    // wce_route_body 请求体上限 (字节)，默认不限，超出时回复 413
+    int max_kv_entries;         // wce_data_set 键数上限，默认 100
+    int send_timeout_ms;        // 响应排队未发出的最长时间 (从套接字首次写满起，客户端每取走 64KB 重新计时)，默认 10000
+    int header_timeout_ms;      // 连接建立后须在此时间内收齐请求头，默认 10000 (超时回复 408 并关闭)
+    int body_timeout_ms;        // 流式请求体两次读取的最长间隔，默认 30000
+    int idle_timeout_ms;        // HTTP/2 连接无数据的最长空闲，默认 60000 (超时发送 GOAWAY 并关闭)
+    int tcp_nodelay;            // TCP_NODELAY：默认开启，-1 关闭
+    int defer_accept;           // TCP_DEFER_ACCEPT 秒数 (仅 Linux，其他平台忽略)，默认关闭
+    int reuse_port;             // SO_REUSEPORT，多个进程或实例共享端口 (Windows 不支持)
+} wce_config_t;
+WEBCEE_API int wce_init_ex(const wce_config_t* cfg);
+
+/* 数据同步 (C -> 前端)，可在任意线程调用 */
 WEBCEE_API void wce_data_set(const char* key, const char* val);     // 更新单个数据
-WEBCEE_API const char* wce_data_get(const char* key);               // 获取数据 (前端 -> C)
+WEBCEE_API const char* wce_data_get(const char* key);               // 获取数据 (前端 -> C)，返回值在该键下次被设置前有效
+WEBCEE_API char* wce_data_json(size_t* out_len);                    // 序列化全部数据为 JSON (调用者 free)
+WEBCEE_API char* wce_data_cbor(size_t* out_len);                    // 序列化为 CBOR (整数值编码为整数，调用者 free)
 
 /* 函数注册 (C -> 前端) */
 typedef void (*wce_func_t)(void);
 WEBCEE_API void wce_register_function(const char* name, wce_func_t func);
 
+/* HTTP 路由 (在 wce_start 之前注册)
+ * pattern 支持精确段和 ":name" 参数段，例如 "/api/devices/:id"；
+ * method 为 "GET"/"POST"/... 或 "*" 表示任意方法。 */
+typedef struct wce_request wce_request_t;
+typedef void (*wce_route_handler_t)(wce_request_t* req);
+WEBCEE_API int wce_route(const char* method, const char* pattern, wce_route_handler_t handler);
+WEBCEE_API const char* wce_req_method(wce_request_t* req);
+WEBCEE_API const char* wce_req_path(wce_request_t* req);                    // 不含查询串
+WEBCEE_API const char* wce_req_param(wce_request_t* req, const char* name); // ":name" 路径参数
+WEBCEE_API const char* wce_req_query(wce_request_t* req, const char* name); // 已解码的查询参数，不存在时为 NULL
+WEBCEE_API void wce_respond(wce_request_t* req, int status, const char* content_type,
+                            const char* body, size_t body_len);
+WEBCEE_API const char* wce_req_header(wce_request_t* req, const char* name); // 请求头 (名称不区分大小写)
+
+/* 流式请求体 (固件/配置等大文件上传)
+ * 支持 Content-Length 与 chunked；handler 每收到一段数据调用一次，返回非 0 中止上传。
+ * 请求体结束后再以 data == NULL 调用一次 (开始流式接收后恰好一次)，在此调用 wce_respond；
+ * 用 wce_req_aborted() 区分正常结束与中止/断开。handler 在服务线程同步执行，
+ * 慢速处理会经 TCP 流控反压到客户端，内存占用与请求体大小无关。 */
+typedef int (*wce_body_handler_t)(wce_request_t* req, const char* data, size_t len);
+WEBCEE_API int wce_route_body(const char* method, const char* pattern, wce_body_handler_t handler);
+WEBCEE_API long long wce_req_content_length(wce_request_t* req);   // chunked 时为 -1
+WEBCEE_API int wce_req_aborted(wce_request_t* req);                 // 请求体被中止或连接断开
+WEBCEE_API void wce_req_set_user(wce_request_t* req, void* user);   // 每个请求的用户数据
+WEBCEE_API void* wce_req_user(wce_request_t* req);
+WEBCEE_API int wce_write_all(int fd, const void* data, size_t len); // 将数据完整写入 fd，失败返回 -1
+
+/* 流式响应 (chunked 传输编码)
+ * wce_stream_begin 立即发送响应头，之后写入的数据按块发送；客户端接收慢时未发出的块
+ * 在连接上排队 (受 send_timeout_ms 约束)，写入方不会被阻塞；
+ * handler 返回时未结束的流会被自动结束。写入失败 (客户端断开) 时返回 -1。 */
+typedef struct wce_stream wce_stream_t;
+#define WCE_STREAM_RESERVE_MAX 1024                                  // wce_stream_reserve() 单次上限
+WEBCEE_API wce_stream_t* wce_stream_begin(wce_request_t* req, int status, const char* content_type);
+WEBCEE_API int wce_stream_write(wce_stream_t* s, const char* data, size_t len);
+WEBCEE_API int wce_stream_puts(wce_stream_t* s, const char* str);
+WEBCEE_API int wce_stream_end(wce_stream_t* s);
+WEBCEE_API char* wce_stream_reserve(wce_stream_t* s, size_t n);     // 预留 n (≤WCE_STREAM_RESERVE_MAX) 字节直接写入，失败返回 NULL
+WEBCEE_API void wce_stream_commit(wce_stream_t* s, char* end);      // 提交写到 end 为止的数据
+WEBCEE_API int wce_stream_json_string(wce_stream_t* s, const char* str, size_t max_len); // 写入转义后的 JSON 字符串
+
+/* 流式列表 (/api/list?name=...)：writer 将完整 JSON 数组写入 out，
+ * 优先于 wce_get_list_json 使用，列表大小不影响首字节时间。 */
+typedef void (*wce_list_writer_t)(wce_stream_t* out);
+WEBCEE_API int wce_register_list(const char* name, wce_list_writer_t writer);
+
+/* 渲染 */
+WEBCEE_API char* wce_render_dom(void);                // 渲染当前 UI 树为完整 HTML 页面 (调用者 free)
+WEBCEE_API void wce_ui_reset(void);                   // 一次性释放 UI 树，之后可重新构建 (服务运行时仅在服务线程调用)
+WEBCEE_API void wce_register_page(const char* html, size_t len, const char* etag); // 预渲染页面 (wce_tool 生成，html 须常驻)，UI 树改变后改为运行时渲染
+
+/* 运行时修改 UI 树 (仅在服务线程调用，如路由/函数 handler 中)
+ * 以 wce_id() 命名的节点可在页面打开时修改，已打开的页面经 /api/patch
+ * 只更新变化的部分而不重新加载。成功返回 0，找不到节点等返回 -1。 */
+WEBCEE_API int wce_node_set_label(const char* id, const char* label);   // 文本/按钮文字，输入框为 placeholder
+WEBCEE_API int wce_node_set_style(const char* id, const char* style);   // NULL 移除样式
+WEBCEE_API int wce_node_set_visible(const char* id, int visible);
+WEBCEE_API int wce_node_insert(const char* parent_id, const char* before_id, void (*build)(void)); // build 中用 wce_*() 构建，插入到 before_id 之前 (NULL 为末尾)
+WEBCEE_API int wce_node_remove(const char* id);                        // 移除节点及其子树
+WEBCEE_API char* wce_render_node(const char* id, size_t* out_len);     // 只渲染命名节点的子树 (不含页面头尾，调用者 free)，找不到返回 NULL
+
+/* 内嵌静态资源 (由 CMake 的 target_add_webcee_assets() 生成 wce_assets)
+ * 注册后静态文件只从内嵌资源提供，不再查找 web_root 目录；
+ * 资源带 ETag，URL 带 "?v=<内容哈希>" 时可被永久缓存。 */
+typedef struct {
+    const char* path;                   // URL 路径，如 "/css/app.css"；空槽为 NULL
+    const char* content_type;
+    const unsigned char* data;
+    size_t len;
+    const unsigned char* gzip;          // 预压缩的 gzip 版本，不值得压缩时为 NULL
+    size_t gzip_len;
+    const char* etag;                   // "\"wce-<16 位十六进制内容哈希>\""
+    const char* gzip_etag;
+} wce_asset_t;
+typedef struct {
+    const wce_asset_t* assets;          // 按完美哈希槽位排列
+    int slot_count;
+    const unsigned short* disp;         // 每个桶的哈希种子
+    int bucket_count;
+} wce_asset_bundle_t;
+WEBCEE_API void wce_register_assets(const wce_asset_bundle_t* bundle);  // 在 wce_start 之前注册，NULL 恢复读取 web_root
+WEBCEE_API const wce_asset_t* wce_find_asset(const char* path);         // 查找已注册的资源，不存在时为 NULL
+#if defined(WEBCEE_HAS_ASSETS)
+extern const wce_asset_bundle_t wce_assets;
+#endif
+
+/* 性能追踪 (需以 WCE_TRACE 编译，否则返回 NULL / -1) */
+WEBCEE_API char* wce_trace_json(size_t* out_len);     // 导出 Chrome/Perfetto trace JSON (调用者 free)
+WEBCEE_API int wce_trace_dump(const char* path);      // 将 trace JSON 写入文件
+
 /* 工具函数 */
 WEBCEE_API const char* wce_version(void);             // 获取框架版本
 WEBCEE_API int wce_is_connected(void);                // 检查前端连接状态
+WEBCEE_API const char* wce_io_backend(void);          // 服务器线程使用的 I/O 后端 ("epoll"/"select")
 WEBCEE_API void wce_sleep(int ms);                    // 跨平台休眠函数 (毫秒)
 
+/* 多实例 (每个实例有独立的端口、服务线程、连接、数据、函数、路由和 UI 树)
+ * 不带 server 参数的 wce_* 函数作用于“当前实例”：在实例的服务线程内 (handler、回调) 为该实例，
+ * 其他线程为 wce_server_use() 选定的实例，未选定时为默认实例。 */
+typedef struct wce_server wce_server_t;
+WEBCEE_API wce_server_t* wce_server_create(void);                  // 创建新实例
+WEBCEE_API void wce_server_destroy(wce_server_t* srv);             // 停止并释放实例 (默认实例只停止)
+WEBCEE_API wce_server_t* wce_server_default(void);                 // 默认实例
+WEBCEE_API wce_server_t* wce_server_use(wce_server_t* srv);        // 设置本线程的当前实例 (NULL 为默认)，返回原实例
+WEBCEE_API int wce_server_init(wce_server_t* srv, int port);
+WEBCEE_API int wce_server_init_unix(wce_server_t* srv, const char* path, int mode);
+WEBCEE_API int wce_server_init_ex(wce_server_t* srv, const wce_config_t* cfg);
+WEBCEE_API int wce_server_start(wce_server_t* srv);
+WEBCEE_API void wce_server_stop(wce_server_t* srv);
+WEBCEE_API void wce_server_data_set(wce_server_t* srv, const char* key, const char* val);
+WEBCEE_API const char* wce_server_data_get(wce_server_t* srv, const char* key);
+WEBCEE_API char* wce_server_data_json(wce_server_t* srv, size_t* out_len);
+WEBCEE_API char* wce_server_data_cbor(wce_server_t* srv, size_t* out_len);
+WEBCEE_API void wce_server_register_function(wce_server_t* srv, const char* name, wce_func_t func);
+WEBCEE_API int wce_server_route(wce_server_t* srv, const char* method, const char* pattern, wce_route_handler_t handler);
+WEBCEE_API int wce_server_route_body(wce_server_t* srv, const char* method, const char* pattern, wce_body_handler_t handler);
+WEBCEE_API int wce_server_register_list(wce_server_t* srv, const char* name, wce_list_writer_t writer);
+WEBCEE_API char* wce_server_render_dom(wce_server_t* srv);
+WEBCEE_API void wce_server_ui_reset(wce_server_t* srv);
+WEBCEE_API void wce_server_register_page(wce_server_t* srv, const char* html, size_t len, const char* etag);
+WEBCEE_API void wce_server_register_assets(wce_server_t* srv, const wce_asset_bundle_t* bundle);
+WEBCEE_API int wce_server_node_set_label(wce_server_t* srv, const char* id, const char* label);
+WEBCEE_API int wce_server_node_set_style(wce_server_t* srv, const char* id, const char* style);
+WEBCEE_API int wce_server_node_set_visible(wce_server_t* srv, const char* id, int visible);
+WEBCEE_API int wce_server_node_insert(wce_server_t* srv, const char* parent_id, const char* before_id, void (*build)(void));
+WEBCEE_API int wce_server_node_remove(wce_server_t* srv, const char* id);
+WEBCEE_API char* wce_server_render_node(wce_server_t* srv, const char* id, size_t* out_len);
+WEBCEE_API wce_server_t* wce_req_server(wce_request_t* req);       // 请求所属实例
+
 /*
  * 可选：当通过 CMake 的 target_add_webcee_ui() 绑定了 .wce 文件时，
  * 会自动定义 WEBCEE_HAS_GENERATED=1，并把生成目录加入 include path。
@@ -25,6 +25,8 @@ typedef enum {
 // --- Node Structure ---
 typedef struct WceNode {
     WceNodeType type;
+    short col_span;         // Small fields share the padding after type (80-byte nodes on 64-bit)
+    unsigned char hidden;   // wce_node_set_visible(id, 0)
     char* label;
     char* value_ref;
     char* event_handler;
@@ -32,8 +34,8 @@ typedef struct WceNode {
     struct WceNode* last_child;
     struct WceNode* next_sibling;
     struct WceNode* parent;
-    int col_span;
     char* style;
+    char* id;               // Name set by wce_id(), for the wce_node_* changes
 } WceNode;
 
 // --- Context Management ---
@@ -42,6 +44,7 @@ extern void _wce_push_context(WceNode* ctx);
 extern void _wce_pop_context(void);
 extern WceNode* _wce_node_create(WceNodeType type);
 extern void _wce_add_child(WceNode* parent, WceNode* child);
+extern void _wce_node_set_id(WceNode* node, const char* id);
 
 // --- Helper Functions ---
 
@@ -143,6 +146,11 @@ static inline void wce_on_click(const char* handler) {
     if (node) node->event_handler = (char*)handler;
 }
 
+// Names the node so it can be changed at runtime (wce_node_set_label() etc.)
+static inline void wce_id(const char* id) {
+    _wce_node_set_id(_wce_current_context(), id);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,162 @@
+#ifndef WEBCEE_PAGE_H
+#define WEBCEE_PAGE_H
+
+// Page shell around the rendered UI tree. Included by the runtime renderer
+// (src/webcee.c) and by wce_tool, which pre-renders static layouts, so both
+// produce identical pages. Not part of the API.
+
+static const char WCE_HTML_HEADER[] =
+    "<!DOCTYPE html><html><head><meta charset='UTF-8'>"
+    "<meta name='viewport' content='width=device-width, initial-scale=1.0'>"
+    "<title>WebCee App</title>"
+    "<style>"
+    "body{font-family:-apple-system,BlinkMacSystemFont,'Segoe UI',Roboto,sans-serif;margin:0;padding:20px;background:#f0f2f5;}"
+    ".container{max_width:800px;margin:0 auto;}"
+    ".row{display:flex;flex-wrap:wrap;margin:-10px;}"
+    ".col{flex:1;padding:10px;min-width:200px;}"
+    ".card{background:white;border-radius:8px;padding:20px;box-shadow:0 2px 4px rgba(0,0,0,0.1);margin-bottom:20px;}"
+    "button{background:#007bff;color:white;border:none;padding:8px 16px;border-radius:4px;cursor:pointer;font-size:14px;}"
+    "button:hover{background:#0056b3;}"
+    "input{padding:8px;border:1px solid #ddd;border-radius:4px;width:100%;box-sizing:border-box;}"
+    "</style></head><body><div id='app'>";
+
+// Client runtime: bound elements are indexed by key once, each poll diffs the
+// data against the last one, and only changed keys are written, batched into
+// one animation frame. An unchanged response is not even decoded. An input
+// the user is editing is left alone; if nothing was typed into it, the latest
+// value is applied when it loses focus. Data and patches are fetched as CBOR
+// (see "CBOR"), decoded by wceCbor(); a JSON answer is still understood. Clicks and input
+// changes are handled by delegation from the wce-click / wce-bind attributes,
+// so the markup carries no inline script. When a poll reports tree changes
+// newer than the page (X-Wce-Patch above its wce-seq mark), wcePatch() fetches
+// and applies them to the elements named by wce-id. wceRefresh(id) replaces
+// one named element with its current markup from /api/fragment, sending the
+// ETag it last got so an unchanged region costs a 304.
+static const char WCE_HTML_FOOTER[] =
+    "</div>"
+    "<script>"
+    "let wceIdx=null,wceLast={},wceBody=null,wcePend=null,wceBusy=false;"
+    "const wceHeld=new Set();"
+    "const wceTags={};"
+    "let wceSeq=(m=>m?+m.getAttribute('wce-seq'):0)(document.querySelector('[wce-seq]')),wcePatching=null;"
+    "async function trigger(evt){"
+    "  await fetch('/api/trigger?event='+encodeURIComponent(evt),{method:'POST'});"
+    "  sync();" // Immediate sync after trigger
+    "}"
+    "function wceCbor(buf){"
+    "  const u=new Uint8Array(buf),dv=new DataView(buf),td=new TextDecoder();let i=0;"
+    "  const arg=ai=>{let v;"
+    "    if(ai<24) return ai;"
+    "    if(ai===24) v=u[i];else if(ai===25) v=dv.getUint16(i);else if(ai===26) v=dv.getUint32(i);"
+    "    else v=dv.getUint32(i)*4294967296+dv.getUint32(i+4);"
+    "    i+=1<<(ai-24);return v;};"
+    "  const item=()=>{const h=u[i++],m=h>>5,ai=h&31;"
+    "    if(m===7){if(ai===20) return false;if(ai===21) return true;if(ai===22) return null;"
+    "      const v=ai===26?dv.getFloat32(i):dv.getFloat64(i);i+=ai===26?4:8;return v;}"
+    "    const n=arg(ai);"
+    "    if(m===0) return n;if(m===1) return -1-n;if(m===6) return item();"
+    "    if(m===2||m===3){const s=u.subarray(i,i+n);i+=n;return m===3?td.decode(s):s;}"
+    "    if(m===4){const a=[];for(let k=0;k<n;k++) a.push(item());return a;}"
+    "    const o={};for(let k=0;k<n;k++){const key=item();o[key]=item();}return o;};"
+    "  return item();"
+    "}"
+    "function wceDecode(r,b){"
+    "  return (r.headers.get('Content-Type')||'').startsWith('application/cbor')?wceCbor(b):JSON.parse(new TextDecoder().decode(b));"
+    "}"
+    "function wceSame(a,b){"
+    "  if(!b||a.byteLength!==b.byteLength) return false;"
+    "  const x=new Uint8Array(a),y=new Uint8Array(b);"
+    "  for(let i=0;i<x.length;i++) if(x[i]!==y[i]) return false;"
+    "  return true;"
+    "}"
+    "function wceIndex(){"
+    "  wceIdx={};"
+    "  document.querySelectorAll('[wce-bind]').forEach(el=>{"
+    "    const k=el.getAttribute('wce-bind');"
+    "    (wceIdx[k]||(wceIdx[k]=[])).push(el);"
+    "    if(el.tagName==='INPUT'&&el.wceValue===undefined) el.wceValue=el.value;"
+    "  });"
+    "}"
+    "function wcePut(el,v){"
+    "  if(el.tagName==='INPUT'){"
+    "    if(el===document.activeElement){wceHeld.add(el);return;}"
+    "    if(el.value!==v) el.value=v;"
+    "    el.wceValue=v;"
+    "  }else if(el.textContent!==v) el.textContent=v;"
+    "}"
+    "function wceFlush(){"
+    "  const p=wcePend;wcePend=null;"
+    "  if(!wceIdx) wceIndex();"
+    "  for(const k in p){const els=wceIdx[k];if(els) els.forEach(el=>wcePut(el,p[k]));}"
+    "}"
+    "function wceNamed(id){return document.querySelector('[wce-id=\"'+CSS.escape(id)+'\"]');}"
+    "function wceRebind(){wceIndex();for(const k in wceIdx) if(k in wceLast) wceIdx[k].forEach(el=>wcePut(el,wceLast[k]));}"
+    "async function wcePull(){"
+    "  try{const r=await fetch('/api/patch?since='+wceSeq,{headers:{Accept:'application/cbor'}});"
+    "  const d=wceDecode(r,await r.arrayBuffer());"
+    "  if(d.reload){location.reload();return;}"
+    "  let moved=false;"
+    "  for(const o of d.ops){"
+    "    const el=wceNamed(o[1]);if(!el) continue;"
+    "    if(o[0]==='label'){if(el.tagName==='INPUT') el.placeholder=o[2];else el.textContent=o[2];}"
+    "    else if(o[0]==='style'){if(o[2]===null) el.removeAttribute('style');else el.setAttribute('style',o[2]);}"
+    "    else if(o[0]==='show') el.hidden=!o[2];"
+    "    else if(o[0]==='insert'){"
+    "      const t=document.createElement('template'),ref=o[2]===null?null:wceNamed(o[2]);t.innerHTML=o[3];"
+    "      el.insertBefore(t.content,ref&&ref.parentNode===el?ref:null);moved=true;"
+    "    }else if(o[0]==='remove'){el.remove();moved=true;}"
+    "  }"
+    "  wceSeq=d.seq;"
+    "  if(moved) wceRebind();"
+    "  }catch(e){}"
+    "}"
+    "function wcePatch(){return wcePatching||(wcePatching=wcePull().finally(()=>{wcePatching=null;}));}"
+    // A fragment is swapped in only when the page has applied exactly the
+    // patches it reflects (its X-Wce-Patch), so no patch lands twice
+    "async function wceRefresh(id){"
+    "  for(let n=0;n<3;n++){"
+    "    const t=wceTags[id];"
+    "    const r=await fetch('/api/fragment?node='+encodeURIComponent(id),{cache:'no-store',headers:t?{'If-None-Match':t}:{}});"
+    "    const s=+r.headers.get('X-Wce-Patch')||0;"
+    "    if(s>wceSeq) await wcePatch();"
+    "    if(s!==wceSeq) continue;"
+    "    const el=wceNamed(id);"
+    "    if(r.status!==200||!el) return false;"
+    "    const tpl=document.createElement('template');tpl.innerHTML=await r.text();"
+    "    wceTags[id]=r.headers.get('ETag');el.replaceWith(tpl.content);wceRebind();"
+    "    return true;"
+    "  }"
+    "  return false;"
+    "}"
+    "async function sync(){"
+    "  if(wceBusy) return;"
+    "  wceBusy=true;"
+    "  try{const r=await fetch('/api/data',{headers:{Accept:'application/cbor'}});const b=await r.arrayBuffer();"
+    "  if((+r.headers.get('X-Wce-Patch')||0)>wceSeq) wcePatch();"
+    "  if(!wceSame(b,wceBody)){"
+    "    wceBody=b;const idle=!wcePend;"
+    "    const d=wceDecode(r,b);"
+    "    for(const k in d){const v=String(d[k]);if(v!==wceLast[k]){wceLast[k]=v;(wcePend||(wcePend={}))[k]=v;}}"
+    "    if(idle&&wcePend) requestAnimationFrame(wceFlush);"
+    "  }"
+    "  }catch(e){}"
+    "  wceBusy=false;"
+    "}"
+    "document.addEventListener('click',e=>{"
+    "  const el=e.target.closest&&e.target.closest('[wce-click]');"
+    "  if(el) trigger(el.getAttribute('wce-click'));"
+    "});"
+    "document.addEventListener('change',e=>{"
+    "  const el=e.target,k=el.tagName==='INPUT'&&el.getAttribute('wce-bind');"
+    "  if(k) fetch('/api/update?key='+encodeURIComponent(k)+'&val='+encodeURIComponent(el.value),{method:'POST'});"
+    "});"
+    "document.addEventListener('focusout',e=>{"
+    "  const el=e.target;"
+    "  if(!wceHeld.delete(el)||el.value!==el.wceValue) return;"
+    "  const v=wceLast[el.getAttribute('wce-bind')];"
+    "  if(v!==undefined){el.value=v;el.wceValue=v;}"
+    "});"
+    "setInterval(sync, 100); sync();" // Faster polling (100ms)
+    "</script></body></html>";
+
+#endif // WEBCEE_PAGE_H
@@ -9,6 +9,7 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 
 // --- Platform Abstraction ---
 #ifdef _WIN32
@@ -19,6 +20,7 @@
 	#include <winsock2.h>
 	#include <ws2tcpip.h>
 	#include <process.h>
+	#include <io.h>
 	#ifdef _MSC_VER
 	#pragma comment(lib, "ws2_32.lib")
 	#endif
@@ -38,14 +40,26 @@
 	int wce_get_error(void) {
 		return WSAGetLastError();
 	}
+
+	static uint64_t wce_now_ms(void) {
+		return (uint64_t)GetTickCount64();
+	}
 #else
 	#include <sys/socket.h>
+	#include <sys/stat.h>
+	#include <sys/un.h>
 	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <netdb.h>
+	#include <stddef.h>
 	#include <unistd.h>
 	#include <pthread.h>
 	#include <sys/select.h>
+	#include <poll.h>
+	#include <time.h>
 	#ifdef __linux__
 		#include <sys/epoll.h>
+		#include <sys/eventfd.h>
 	#endif
 	typedef int wce_socket_t;
 	#define WCE_INVALID_SOCKET -1
@@ -64,17 +78,308 @@
 	int wce_get_error(void) {
 		return errno;
 	}
+
+	static uint64_t wce_now_ms(void) {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+	}
 #endif
 
-// --- Dynamic Function Registry ---
+#ifdef _WIN32
+	#define WCE_THREAD_LOCAL __declspec(thread)
+#else
+	#define WCE_THREAD_LOCAL __thread
+#endif
+
+// Statically initialized lock, not recursive
+#ifdef _WIN32
+	typedef SRWLOCK wce_mutex_t;
+	#define WCE_MUTEX_INIT SRWLOCK_INIT
+	#define wce_mutex_lock(m) AcquireSRWLockExclusive(m)
+	#define wce_mutex_unlock(m) ReleaseSRWLockExclusive(m)
+	#define wce_mutex_destroy(m) ((void)(m))
+#else
+	typedef pthread_mutex_t wce_mutex_t;
+	#define WCE_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+	#define wce_mutex_lock(m) pthread_mutex_lock(m)
+	#define wce_mutex_unlock(m) pthread_mutex_unlock(m)
+	#define wce_mutex_destroy(m) pthread_mutex_destroy(m)
+#endif
+
+// --- Tracing (compile with WCE_TRACE) ---
+// Spans are recorded into a per-thread ring buffer and dumped as Chrome /
+// Perfetto trace JSON. Without WCE_TRACE the span macros expand to nothing.
+#ifdef WCE_TRACE
+	#ifndef _WIN32
+		#include <time.h>
+	#endif
+
+	#define WCE_TRACE_RING_SIZE 8192 // spans per thread, power of two
+
+	typedef struct {
+		const char* name;
+		uint64_t begin_ns;
+		uint64_t end_ns;
+	} wce_trace_span_t;
+
+	typedef struct wce_trace_ring {
+		struct wce_trace_ring* next;
+		unsigned tid;
+		volatile uint64_t head; // total spans ever written by the owning thread
+		wce_trace_span_t spans[WCE_TRACE_RING_SIZE];
+	} wce_trace_ring_t;
+
+	static wce_trace_ring_t* volatile trace_rings = NULL;
+	static volatile unsigned trace_next_tid = 0;
+	static WCE_THREAD_LOCAL wce_trace_ring_t* trace_ring = NULL;
+
+	static uint64_t wce_trace_now(void) {
+	#ifdef _WIN32
+		static LARGE_INTEGER freq;
+		LARGE_INTEGER t;
+		if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+		QueryPerformanceCounter(&t);
+		return (uint64_t)((double)t.QuadPart * 1e9 / (double)freq.QuadPart);
+	#else
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+	#endif
+	}
+
+	static wce_trace_ring_t* wce_trace_ring_get(void) {
+		if (trace_ring) return trace_ring;
+		wce_trace_ring_t* r = (wce_trace_ring_t*)calloc(1, sizeof(wce_trace_ring_t));
+		if (!r) return NULL;
+		// Rings are never freed, so readers can walk the list without locking.
+	#ifdef _MSC_VER
+		r->tid = (unsigned)InterlockedIncrement((volatile LONG*)&trace_next_tid);
+		do {
+			r->next = trace_rings;
+		} while (InterlockedCompareExchangePointer((PVOID volatile*)&trace_rings, r, r->next) != r->next);
+	#else
+		r->tid = __atomic_add_fetch(&trace_next_tid, 1, __ATOMIC_RELAXED);
+		r->next = __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&trace_rings, &r->next, r, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+	#endif
+		trace_ring = r;
+		return r;
+	}
+
+	static void wce_trace_record(const char* name, uint64_t begin_ns) {
+		uint64_t end_ns = wce_trace_now();
+		wce_trace_ring_t* r = wce_trace_ring_get();
+		if (!r) return;
+		wce_trace_span_t* sp = &r->spans[r->head & (WCE_TRACE_RING_SIZE - 1)];
+		sp->name = name;
+		sp->begin_ns = begin_ns;
+		sp->end_ns = end_ns;
+	#ifdef _MSC_VER
+		MemoryBarrier();
+		r->head++;
+	#else
+		__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+	#endif
+	}
+
+	#define WCE_TRACE_BEGIN(id) uint64_t _wce_trace_##id = wce_trace_now()
+	#define WCE_TRACE_END(id, name) wce_trace_record(name, _wce_trace_##id)
+#else
+	#define WCE_TRACE_BEGIN(id) ((void)0)
+	#define WCE_TRACE_END(id, name) ((void)0)
+#endif
+
+// --- Data Structures ---
+#define MAX_CLIENTS 65536    // Upper bound for the connection table (and max_connections)
+#define BUFFER_SIZE 16384    // Largest request buffer (largest size class)
+#define WCE_BUF_CLASSES 3    // Request buffer size classes, see "Buffer Pool"
+#define WCE_TIMER_SLOTS 512  // Timer wheel slots, power of two, see "Timers"
+#define WCE_WATCH_READ  1    // Poller interest of a connection
+#define WCE_WATCH_WRITE 2
+
+typedef struct {
+	wce_socket_t fd;
+	char* buffer;            // Pooled, only held while a request is in flight
+	int buf_cap;
+	int buf_len;
+	int head_len;            // Size of the request head once "\r\n\r\n" has arrived
+	int active;
+	int next_free;           // Free-list link while the slot is unused
+	wce_request_t* req;      // Set while a request body streams to a handler
+	struct wce_h2_conn* h2;  // Set once the connection speaks HTTP/2
+	uint64_t timer_due;      // Tick of the armed deadline, 0 when none, see "Timers"
+	int timer_prev;          // Timer wheel slot list links
+	int timer_next;
+	// Response bytes the socket has not taken yet, see "Output Queue"
+	char* out;
+	size_t out_len;
+	size_t out_sent;         // Front of `out` already sent
+	size_t out_cap;
+	uint64_t out_due;        // Loop time by which the queue has to drain
+	size_t out_progress;     // Bytes the client took since out_due was set
+	int out_failed;          // Send error: nothing more goes out
+	int closing;             // Response complete, close once the queue drains
+	int watch;               // Events the poller waits for, WCE_WATCH_*
+} wce_client_t;
+
+// KV Store
+typedef struct {
+	char* key;
+	char* value;
+} wce_kv_t;
+
+#define MAX_KV_STORE 100     // Default max_kv_entries
+
 typedef struct {
     char* name;
     wce_func_t func;
 } wce_func_entry_t;
 
-static wce_func_entry_t func_registry[256];
-static int func_count = 0;
+// Streaming list writers served by /api/list; registering a name again
+// replaces its writer.
+typedef struct {
+    char* name;
+    wce_list_writer_t writer;
+} wce_list_entry_t;
+
+// --- Server Instance ---
+// Everything one server owns: its listener and thread, connections, data,
+// functions, routes and UI tree. Instances share nothing, so a process can
+// serve several UIs on different ports, each on its own thread.
+//
+// The wce_* calls without a server argument act on the current instance:
+// on a server's own thread (handlers, callbacks) that server, elsewhere
+// the one chosen with wce_server_use(), by default the process-wide default
+// instance.
+struct wce_server {
+	wce_config_t cfg;        // Resolved configuration, see "Configuration"
+	// Connection table: grows on demand, free slots form an index free-list.
+	wce_client_t* clients;
+	int client_cap;
+	int client_free;
+	int client_count;        // Open connections, bounded by cfg.max_connections
+	// Connection deadlines, see "Timers"
+	int timer_slots[WCE_TIMER_SLOTS];
+	uint64_t timer_tick;     // Last tick whose slot has been expired
+	uint64_t loop_ms;        // Loop time, refreshed after every poll
+	int timer_count;
+	wce_socket_t listen_fd;
+	volatile int running;
+#ifdef _WIN32
+	HANDLE thread;
+	DWORD thread_id;
+#else
+	pthread_t thread;
+#endif
+	int port;
+#ifndef _WIN32
+	char unix_path[sizeof(((struct sockaddr_un*)0)->sun_path)]; // Socket file to unlink on stop
+#endif
+	// Loop wakeup and event poller, see "Loop Wakeup" and "Event Poller"
+#ifdef __linux__
+	int wakeup_fd;
+	int epoll_fd;
+#elif defined(_WIN32)
+	wce_socket_t wakeup_sock;
+#else
+	int wakeup_pipe[2];
+#endif
+	struct wce_slab* slab_partial[WCE_BUF_CLASSES]; // Buffer pool class lists
+	// Route trie, see "HTTP Routing"
+	struct wce_route_node* route_nodes;
+	int route_node_count;
+	int route_node_cap;
+	struct wce_route_edge* route_edges;
+	int route_edge_count;
+	int route_edge_cap;      // Power of two
+	wce_func_entry_t func_registry[256];
+	int func_count;
+	wce_list_entry_t list_registry[64];
+	int list_count;
+	// The data API may be called from any thread: kv_lock guards the store
+	wce_mutex_t kv_lock;
+	wce_kv_t* kv_store;      // Grows on demand up to cfg.max_kv_entries
+	int kv_count;
+	int kv_cap;
+	unsigned kv_version;     // Bumped after every change to the store
+	struct wce_snapshot* data_snapshot[2]; // Cached /api/data bodies per format, see "Data Snapshots"
+	// UI tree and its builder state, see "Runtime UI Construction"
+	struct wce_ui_block* ui_nodes;   // Node arena
+	struct wce_ui_block* ui_strings; // Interned strings
+	char** ui_intern;
+	int ui_intern_cap;       // Power of two
+	int ui_intern_count;
+	WceNode* ui_root;
+	WceNode** ui_stack;      // Open begin/end scopes, grows on demand
+	int ui_stack_cap;
+	int ui_top;
+	WceNode* ui_last;        // Node wce_css() / _wce_add_style() applies to
+	struct wce_ui_id* ui_ids; // wce_id() name -> node, open addressing
+	int ui_ids_cap;          // Power of two
+	int ui_ids_count;
+	WceNode* ui_free;        // Removed nodes for reuse, linked by next_sibling
+	volatile unsigned ui_version; // Bumped by every builder call that may change the tree
+	// Page served at "/", see "Page"
+	const char* page_html;   // Pre-rendered by wce_tool, valid while ui_version == page_version
+	size_t page_len;
+	char page_etag[48];
+	unsigned page_version;
+	struct wce_snapshot* page_render; // Runtime render of the tree, cached per ui_version
+	const wce_asset_bundle_t* assets; // Embedded static files, see "Embedded Assets"
+	// Tree changes for open pages, see "UI Patches"
+	struct wce_patch* patches; // Oldest first
+	int patch_count;
+	int patch_cap;
+	size_t patch_bytes;      // Rendered HTML held by insert patches
+	unsigned patch_seq;      // Sequence number of the newest change
+	unsigned patch_floor;    // Pages older than this cannot catch up and reload
+};
+
+#ifdef __linux__
+	#define WCE_SERVER_IO_BLANK .wakeup_fd = -1, .epoll_fd = -1
+#elif defined(_WIN32)
+	#define WCE_SERVER_IO_BLANK .wakeup_sock = WCE_INVALID_SOCKET
+#else
+	#define WCE_SERVER_IO_BLANK .wakeup_pipe = { -1, -1 }
+#endif
+#define WCE_SEND_TIMEOUT_MS 10000 // Default send_timeout_ms
+#define WCE_CONFIG_DEFAULTS { .backlog = 511, .max_connections = MAX_CLIENTS, \
+	.max_header_size = BUFFER_SIZE, .max_kv_entries = MAX_KV_STORE, .send_timeout_ms = WCE_SEND_TIMEOUT_MS, \
+	.header_timeout_ms = 10000, .body_timeout_ms = 30000, .idle_timeout_ms = 60000, .tcp_nodelay = 1 }
+#define WCE_SERVER_BLANK { .cfg = WCE_CONFIG_DEFAULTS, .client_free = -1, .listen_fd = WCE_INVALID_SOCKET, \
+	.ui_top = -1, .kv_lock = WCE_MUTEX_INIT, WCE_SERVER_IO_BLANK }
+
+static wce_server_t wce_default_server = WCE_SERVER_BLANK;
+static WCE_THREAD_LOCAL wce_server_t* wce_current = NULL;
+
+static wce_server_t* wce_self(void) {
+	return wce_current ? wce_current : &wce_default_server;
+}
+
+wce_server_t* wce_server_create(void) {
+	static const wce_server_t blank = WCE_SERVER_BLANK;
+	wce_server_t* srv = (wce_server_t*)malloc(sizeof(wce_server_t));
+	if (srv) *srv = blank;
+	return srv;
+}
+
+wce_server_t* wce_server_default(void) {
+	return &wce_default_server;
+}
+
+wce_server_t* wce_server_use(wce_server_t* srv) {
+	wce_server_t* prev = wce_self();
+	wce_current = srv;
+	return prev;
+}
+
+static void wce_body_release(wce_request_t* req);
+static void wce_h2_free(struct wce_h2_conn* h);
+static void wce_poll_watch(wce_server_t* srv, int index, int watch);
+static void wce_client_expire(wce_server_t* srv, int index);
 
+// --- Dynamic Function Registry ---
 static char* wce_strdup(const char* s) {
     if (!s) return NULL;
     size_t len = strlen(s) + 1;
@@ -83,12 +388,43 @@ static char* wce_strdup(const char* s) {
     return new_s;
 }
 
+void wce_server_register_function(wce_server_t* srv, const char* name, wce_func_t func) {
+    if (srv->func_count < 256) {
+        srv->func_registry[srv->func_count].name = wce_strdup(name);
+        srv->func_registry[srv->func_count].func = func;
+        srv->func_count++;
+    }
+}
+
 void wce_register_function(const char* name, wce_func_t func) {
-    if (func_count < 256) {
-        func_registry[func_count].name = wce_strdup(name);
-        func_registry[func_count].func = func;
-        func_count++;
+    wce_server_register_function(wce_self(), name, func);
+}
+
+int wce_server_register_list(wce_server_t* srv, const char* name, wce_list_writer_t writer) {
+    if (!name || !writer) return -1;
+    for (int i = 0; i < srv->list_count; i++) {
+        if (strcmp(srv->list_registry[i].name, name) == 0) {
+            srv->list_registry[i].writer = writer;
+            return 0;
+        }
+    }
+    if (srv->list_count >= 64) return -1;
+    srv->list_registry[srv->list_count].name = wce_strdup(name);
+    if (!srv->list_registry[srv->list_count].name) return -1;
+    srv->list_registry[srv->list_count].writer = writer;
+    srv->list_count++;
+    return 0;
+}
+
+int wce_register_list(const char* name, wce_list_writer_t writer) {
+    return wce_server_register_list(wce_self(), name, writer);
+}
+
+static wce_list_writer_t wce_find_list(wce_server_t* srv, const char* name) {
+    for (int i = 0; i < srv->list_count; i++) {
+        if (strcmp(srv->list_registry[i].name, name) == 0) return srv->list_registry[i].writer;
     }
+    return NULL;
 }
 
 // --- Generated Hooks (optional) ---
@@ -139,84 +475,21 @@ void wce_register_function(const char* name, wce_func_t func) {
 	void wce_dispatch_event(const char* event, const char* args) {
         (void)args;
         // Check dynamic registry first
-        for (int i = 0; i < func_count; i++) {
-            if (strcmp(func_registry[i].name, event) == 0) {
-                if (func_registry[i].func) func_registry[i].func();
+        wce_server_t* srv = wce_self();
+        for (int i = 0; i < srv->func_count; i++) {
+            if (strcmp(srv->func_registry[i].name, event) == 0) {
+                if (srv->func_registry[i].func) srv->func_registry[i].func();
                 return;
             }
         }
     }
 #endif
 
-// --- Data Structures ---
-#define MAX_CLIENTS 1024
-#define BUFFER_SIZE 4096
-
-typedef struct {
-	wce_socket_t fd;
-	char buffer[BUFFER_SIZE];
-	int buf_len;
-	int active;
-} wce_client_t;
-
-static wce_client_t clients[MAX_CLIENTS];
-static wce_socket_t server_fd = WCE_INVALID_SOCKET;
-static volatile int is_running = 0;
-static int server_port = 80;
-
-// KV Store
-typedef struct {
-	char* key;
-	char* value;
-} wce_kv_t;
-
-#define MAX_KV_STORE 100
-static wce_kv_t kv_store[MAX_KV_STORE];
-static int kv_count = 0;
-
 // --- Runtime UI Construction Implementation ---
-static WceNode* _wce_root = NULL;
-static WceNode* _wce_ctx_stack[32];
-static int _wce_ctx_top = -1;
-static WceNode* _wce_last_created = NULL; // Track last created node for styling
-
-// Minimal embedded UI (served when no web_root found)
-// Modified to support Runtime Rendering (SSR from C structure)
-static const char* WCE_HTML_HEADER =
-	"<!DOCTYPE html><html><head><meta charset='UTF-8'>"
-	"<meta name='viewport' content='width=device-width, initial-scale=1.0'>"
-	"<title>WebCee App</title>"
-	"<style>"
-	"body{font-family:-apple-system,BlinkMacSystemFont,'Segoe UI',Roboto,sans-serif;margin:0;padding:20px;background:#f0f2f5;}"
-	".container{max_width:800px;margin:0 auto;}"
-	".row{display:flex;flex-wrap:wrap;margin:-10px;}"
-	".col{flex:1;padding:10px;min-width:200px;}"
-	".card{background:white;border-radius:8px;padding:20px;box-shadow:0 2px 4px rgba(0,0,0,0.1);margin-bottom:20px;}"
-	"button{background:#007bff;color:white;border:none;padding:8px 16px;border-radius:4px;cursor:pointer;font-size:14px;}"
-	"button:hover{background:#0056b3;}"
-	"input{padding:8px;border:1px solid #ddd;border-radius:4px;width:100%;box-sizing:border-box;}"
-	"</style></head><body><div id='app'>";
-
-static const char* WCE_HTML_FOOTER =
-	"</div>"
-	"<script>"
-	"async function trigger(evt){"
-    "  await fetch('/api/trigger?event='+evt,{method:'POST'});"
-    "  sync();" // Immediate sync after trigger
-    "}"
-	"async function sync(){"
-	"  try{const r=await fetch('/api/data');const d=await r.json();"
-	"  document.querySelectorAll('[wce-bind]').forEach(el=>{"
-	"    const k=el.getAttribute('wce-bind');"
-	"    if(d[k]!==undefined) {"
-    "      if(el.tagName==='INPUT') el.value=d[k];"
-    "      else el.textContent=d[k];"
-    "    }"
-	"  });"
-	"  }catch(e){}"
-	"}"
-	"setInterval(sync, 100); sync();" // Faster polling (100ms)
-	"</script></body></html>";
+
+// Page shell around the rendered tree; shared with wce_tool, which
+// pre-renders static layouts into the same bytes (see "Page").
+#include "webcee_page.h"
 
 // --- Helper Functions ---
 static void str_append(char** buf, size_t* cap, size_t* len, const char* str) {
@@ -229,152 +502,457 @@ static void str_append(char** buf, size_t* cap, size_t* len, const char* str) {
     *len += l;
 }
 
-static void wce_render_node_recursive(WceNode* node, char** buf, size_t* cap, size_t* len) {
-    if (!node) return;
+// --- HTML Rendering ---
+// The page is rendered in two passes over the same code: a sizing pass
+// (out == NULL) that only adds up lengths, then a writing pass into one
+// allocation of exactly that size. Node text is escaped through a lookup
+// table. Trees repeat the same label and style pointers many times, so the
+// raw and escaped length of each string is remembered by pointer for the
+// duration of a render: a string is scanned once, and one that needs no
+// escaping is written with a single memcpy.
+#define WCE_HTML_MEMO 256    // Direct-mapped string length cache, power of two
 
-    // Helper to inject style
-    void inject_style() {
-        if (node->style) {
-            str_append(buf, cap, len, " style='");
-            str_append(buf, cap, len, node->style);
-            str_append(buf, cap, len, "'");
-        }
+typedef struct {
+    const char* str;
+    size_t len;
+    size_t esc_len;
+} wce_html_memo_t;
+
+// The emitters take the output buffer (NULL while sizing) and length as
+// plain arguments and return the length advanced, so both stay in registers.
+static size_t wce_html_put(char* out, size_t len, const char* s, size_t n) {
+    if (out) memcpy(out + len, s, n);
+    return len + n;
+}
+
+#define WCE_HTML_LIT(out, len, lit) ((len) = wce_html_put((out), (len), (lit), sizeof(lit) - 1))
+
+// Replacements for characters that may not appear literally in element
+// content or in a quoted attribute value; 0 length means copy as is.
+static const char* const wce_html_entity[256] = {
+    ['&'] = "&amp;", ['<'] = "&lt;", ['>'] = "&gt;", ['"'] = "&quot;", ['\''] = "&#39;"
+};
+static const unsigned char wce_html_entity_len[256] = {
+    ['&'] = 5, ['<'] = 4, ['>'] = 4, ['"'] = 6, ['\''] = 5
+};
+
+static void wce_html_measure(wce_html_memo_t* m, const char* str) {
+    size_t n = 0, extra = 0;
+    for (const unsigned char* p = (const unsigned char*)str; *p; p++, n++) {
+        unsigned char e = wce_html_entity_len[*p];
+        if (e) extra += e - 1u;
     }
+    m->str = str;
+    m->len = n;
+    m->esc_len = n + extra;
+}
+
+static size_t wce_html_write_escaped(char* out, size_t len, const char* str) {
+    const unsigned char* run = (const unsigned char*)str;
+    const unsigned char* p = run;
+    for (;; p++) {
+        unsigned char ch = *p;
+        if (ch && !wce_html_entity_len[ch]) continue;
+        len = wce_html_put(out, len, (const char*)run, (size_t)(p - run));
+        if (!ch) return len;
+        len = wce_html_put(out, len, wce_html_entity[ch], wce_html_entity_len[ch]);
+        run = p + 1;
+    }
+}
+
+static inline size_t wce_html_escaped(char* out, wce_html_memo_t* memo, size_t len, const char* str) {
+    wce_html_memo_t* m = &memo[((uintptr_t)str * 0x9E3779B97F4A7C15ull) >> 56 & (WCE_HTML_MEMO - 1)];
+    if (m->str != str) wce_html_measure(m, str);
+    if (!out || m->esc_len == m->len) return wce_html_put(out, len, str, m->esc_len);
+    return wce_html_write_escaped(out, len, str);
+}
+
+// Appends ` name='value'` with the value escaped; `open` is " name='".
+static inline size_t wce_html_attr(char* out, wce_html_memo_t* memo, size_t len,
+                                   const char* open, size_t open_len, const char* value) {
+    if (!value) return len;
+    len = wce_html_put(out, len, open, open_len);
+    len = wce_html_escaped(out, memo, len, value);
+    return wce_html_put(out, len, "'", 1);
+}
 
-    // Open tag
+#define WCE_HTML_ATTR(out, memo, len, open, value) \
+    ((len) = wce_html_attr((out), (memo), (len), (open), sizeof(open) - 1, (value)))
+
+// Named nodes carry wce-id, which client patches address (see "UI Patches").
+static inline size_t wce_html_node_attrs(char* out, wce_html_memo_t* memo, size_t len, const WceNode* node) {
+    WCE_HTML_ATTR(out, memo, len, " wce-id='", node->id);
+    if (node->hidden) WCE_HTML_LIT(out, len, " hidden");
+    return len;
+}
+
+// Start of a node. Leaves are written whole; containers leave their
+// </div> to wce_html_close().
+static size_t wce_html_open(char* out, wce_html_memo_t* memo, size_t len, const WceNode* node) {
     switch (node->type) {
-        case WCE_NODE_ROOT: break;
-        case WCE_NODE_CONTAINER: str_append(buf, cap, len, "<div class='container'"); inject_style(); str_append(buf, cap, len, ">"); break;
-        case WCE_NODE_ROW:       str_append(buf, cap, len, "<div class='row'"); inject_style(); str_append(buf, cap, len, ">"); break;
-        case WCE_NODE_COL:       str_append(buf, cap, len, "<div class='col'"); inject_style(); str_append(buf, cap, len, ">"); break;
-        case WCE_NODE_CARD:      str_append(buf, cap, len, "<div class='card'"); inject_style(); str_append(buf, cap, len, ">"); break;
-        case WCE_NODE_PANEL:     str_append(buf, cap, len, "<div class='panel'"); inject_style(); str_append(buf, cap, len, ">"); break;
+        case WCE_NODE_CONTAINER: WCE_HTML_LIT(out, len, "<div class='container'"); break;
+        case WCE_NODE_ROW:       WCE_HTML_LIT(out, len, "<div class='row'"); break;
+        case WCE_NODE_COL:       WCE_HTML_LIT(out, len, "<div class='col'"); break;
+        case WCE_NODE_CARD:      WCE_HTML_LIT(out, len, "<div class='card'"); break;
+        case WCE_NODE_PANEL:     WCE_HTML_LIT(out, len, "<div class='panel'"); break;
         case WCE_NODE_TEXT:
-            str_append(buf, cap, len, "<span");
-            inject_style();
-            if (node->value_ref) {
-                 str_append(buf, cap, len, " wce-bind='");
-                 str_append(buf, cap, len, node->value_ref);
-                 str_append(buf, cap, len, "'");
-            }
-            str_append(buf, cap, len, ">");
-            if (node->label) str_append(buf, cap, len, node->label);
-            str_append(buf, cap, len, "</span>");
-            break;
+            WCE_HTML_LIT(out, len, "<span");
+            len = wce_html_node_attrs(out, memo, len, node);
+            WCE_HTML_ATTR(out, memo, len, " style='", node->style);
+            WCE_HTML_ATTR(out, memo, len, " wce-bind='", node->value_ref);
+            WCE_HTML_LIT(out, len, ">");
+            if (node->label) len = wce_html_escaped(out, memo, len, node->label);
+            return WCE_HTML_LIT(out, len, "</span>");
         case WCE_NODE_BUTTON:
-            str_append(buf, cap, len, "<button");
-            inject_style();
-            if (node->event_handler) {
-                str_append(buf, cap, len, " onclick=\"trigger('");
-                str_append(buf, cap, len, node->event_handler);
-                str_append(buf, cap, len, "')\"");
-            }
-            str_append(buf, cap, len, ">");
-            if (node->label) str_append(buf, cap, len, node->label);
-            str_append(buf, cap, len, "</button>");
-            break;
+            WCE_HTML_LIT(out, len, "<button");
+            len = wce_html_node_attrs(out, memo, len, node);
+            WCE_HTML_ATTR(out, memo, len, " style='", node->style);
+            WCE_HTML_ATTR(out, memo, len, " wce-click='", node->event_handler);
+            WCE_HTML_LIT(out, len, ">");
+            if (node->label) len = wce_html_escaped(out, memo, len, node->label);
+            return WCE_HTML_LIT(out, len, "</button>");
         case WCE_NODE_INPUT:
-            str_append(buf, cap, len, "<input type='text'");
-            inject_style();
-            if (node->label) {
-                str_append(buf, cap, len, " placeholder='");
-                str_append(buf, cap, len, node->label);
-                str_append(buf, cap, len, "'");
-            }
-            if (node->value_ref) {
-                 // For input, we need two-way binding or at least value setting
-                 // Simple value setting for now
-                 str_append(buf, cap, len, " wce-bind='");
-                 str_append(buf, cap, len, node->value_ref);
-                 str_append(buf, cap, len, "'");
-                 // Also add onchange to update model? 
-                 // The current JS only does one-way from server to client via polling.
-                 // Client to server is via /api/update?key=...&val=...
-                 // Let's add a simple onchange handler
-                 str_append(buf, cap, len, " onchange=\"fetch('/api/update?key=");
-                 str_append(buf, cap, len, node->value_ref);
-                 str_append(buf, cap, len, "&val='+this.value)\"");
-            }
-            str_append(buf, cap, len, "/>");
-            break;
-        default: break;
-    }
-
-    // Children
-    WceNode* child = node->first_child;
-    while (child) {
-        wce_render_node_recursive(child, buf, cap, len);
-        child = child->next_sibling;
+            // Edits are posted to /api/update by the footer script
+            WCE_HTML_LIT(out, len, "<input type='text'");
+            len = wce_html_node_attrs(out, memo, len, node);
+            WCE_HTML_ATTR(out, memo, len, " style='", node->style);
+            WCE_HTML_ATTR(out, memo, len, " placeholder='", node->label);
+            WCE_HTML_ATTR(out, memo, len, " wce-bind='", node->value_ref);
+            return WCE_HTML_LIT(out, len, "/>");
+        default: return len;
     }
+    len = wce_html_node_attrs(out, memo, len, node);
+    WCE_HTML_ATTR(out, memo, len, " style='", node->style);
+    return WCE_HTML_LIT(out, len, ">");
+}
 
-    // Close tag
+static size_t wce_html_close(char* out, size_t len, const WceNode* node) {
     switch (node->type) {
         case WCE_NODE_CONTAINER:
         case WCE_NODE_ROW:
         case WCE_NODE_COL:
         case WCE_NODE_CARD:
         case WCE_NODE_PANEL:
-            str_append(buf, cap, len, "</div>"); break;
-        default: break;
+            return WCE_HTML_LIT(out, len, "</div>");
+        default: return len;
+    }
+}
+
+// Walks the subtree under `root` in document order without recursion, so
+// nesting depth is not limited by the stack.
+static size_t wce_html_tree(char* out, wce_html_memo_t* memo, size_t len, const WceNode* root) {
+    const WceNode* node = root;
+    for (;;) {
+        len = wce_html_open(out, memo, len, node);
+        if (node->first_child) {
+            node = node->first_child;
+            continue;
+        }
+        for (;;) {
+            len = wce_html_close(out, len, node);
+            if (node == root) return len;
+            if (node->next_sibling) {
+                node = node->next_sibling;
+                break;
+            }
+            node = node->parent;
+        }
     }
 }
 
-char* wce_render_dom() {
-    size_t cap = 8192;
+// A page rendered after tree changes records the last one it contains, so
+// its client asks only for later patches; without the mark it is 0.
+static size_t wce_html_page(char* out, wce_html_memo_t* memo, const WceNode* root, unsigned seq) {
     size_t len = 0;
-    char* buf = (char*)malloc(cap);
-    buf[0] = '\0';
-    
-    str_append(&buf, &cap, &len, WCE_HTML_HEADER);
-    
-    if (_wce_root) {
-        wce_render_node_recursive(_wce_root, &buf, &cap, &len);
+    WCE_HTML_LIT(out, len, WCE_HTML_HEADER);
+    if (root) {
+        len = wce_html_tree(out, memo, len, root);
     } else {
-        str_append(&buf, &cap, &len, "<div class='container'><div class='card'><h3>No UI Defined</h3><p>Use wce_ui_begin() ... wce_ui_end() in main.c</p></div></div>");
+        WCE_HTML_LIT(out, len, "<div class='container'><div class='card'><h3>No UI Defined</h3><p>Use wce_ui_begin() ... wce_ui_end() in main.c</p></div></div>");
     }
-    
-    str_append(&buf, &cap, &len, WCE_HTML_FOOTER);
+    if (seq) {
+        char mark[48];
+        int n = snprintf(mark, sizeof(mark), "<span hidden wce-seq='%u'></span>", seq);
+        len = wce_html_put(out, len, mark, (size_t)n);
+    }
+    return WCE_HTML_LIT(out, len, WCE_HTML_FOOTER);
+}
+
+static char* wce_render_page(wce_server_t* srv, size_t* out_len) {
+    WCE_TRACE_BEGIN(render);
+    wce_html_memo_t memo[WCE_HTML_MEMO];
+    memset(memo, 0, sizeof(memo));
+    size_t len = wce_html_page(NULL, memo, srv->ui_root, srv->patch_seq);
+    char* buf = (char*)malloc(len + 1);
+    if (buf) {
+        wce_html_page(buf, memo, srv->ui_root, srv->patch_seq);
+        buf[len] = '\0';
+        if (out_len) *out_len = len;
+    }
+    WCE_TRACE_END(render, "render");
+    return buf;
+}
+
+char* wce_server_render_dom(wce_server_t* srv) {
+    return wce_render_page(srv, NULL);
+}
+
+char* wce_render_dom(void) {
+    return wce_server_render_dom(wce_self());
+}
+
+// One subtree without the page shell, for patches and fragments.
+static char* wce_render_subtree(const WceNode* node, size_t* out_len) {
+    WCE_TRACE_BEGIN(render);
+    wce_html_memo_t memo[WCE_HTML_MEMO];
+    memset(memo, 0, sizeof(memo));
+    size_t len = wce_html_tree(NULL, memo, 0, node);
+    char* buf = (char*)malloc(len + 1);
+    if (buf) {
+        wce_html_tree(buf, memo, 0, node);
+        buf[len] = '\0';
+        if (out_len) *out_len = len;
+    }
+    WCE_TRACE_END(render, "render");
     return buf;
 }
 
+// UI tree storage. Nodes are carved from a per-server arena in creation
+// order, which for the begin/end builders is document (pre-)order, so a
+// node's first child and next sibling usually sit right behind it and the
+// renderer walks memory front to back. Strings copied into the tree are
+// interned in a second arena. Blocks double in size; wce_ui_reset() keeps
+// only the largest block of each arena, so rebuilding a tree of the same
+// size allocates nothing.
+typedef struct wce_ui_block {
+    struct wce_ui_block* next;
+    size_t used;
+    size_t cap;
+} wce_ui_block_t;
+
+#define WCE_UI_BLOCK_MIN  16384
+#define WCE_UI_BLOCK_MAX  (1 << 20)
+
+static void* wce_ui_alloc(wce_ui_block_t** arena, size_t size, size_t align) {
+    wce_ui_block_t* b = *arena;
+    size_t at = b ? (b->used + align - 1) & ~(align - 1) : 0;
+    if (!b || at + size > b->cap) {
+        size_t cap = b ? b->cap * 2 : WCE_UI_BLOCK_MIN;
+        if (cap > WCE_UI_BLOCK_MAX) cap = WCE_UI_BLOCK_MAX;
+        if (cap < size) cap = size;
+        b = (wce_ui_block_t*)malloc(sizeof(wce_ui_block_t) + cap);
+        if (!b) return NULL;
+        b->next = *arena;
+        b->cap = cap;
+        *arena = b;
+        at = 0;
+    }
+    b->used = at + size;
+    return (char*)(b + 1) + at;
+}
+
+// Keeps the newest (largest) block for reuse and frees the rest.
+static void wce_ui_arena_reset(wce_ui_block_t** arena, int keep) {
+    wce_ui_block_t* b = *arena;
+    if (keep && b) {
+        b->used = 0;
+        b = b->next;
+        (*arena)->next = NULL;
+    } else {
+        *arena = NULL;
+    }
+    while (b) {
+        wce_ui_block_t* next = b->next;
+        free(b);
+        b = next;
+    }
+}
+
+// Returns the arena copy of str[0..len), one per distinct string (open addressing).
+static char* wce_ui_intern(wce_server_t* srv, const char* str, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)str[i]) * 16777619u;
+
+    if ((srv->ui_intern_count + 1) * 2 > srv->ui_intern_cap) {
+        int cap = srv->ui_intern_cap ? srv->ui_intern_cap * 2 : 256;
+        char** table = (char**)calloc((size_t)cap, sizeof(char*));
+        if (!table) return NULL;
+        for (int i = 0; i < srv->ui_intern_cap; i++) {
+            char* old = srv->ui_intern[i];
+            if (!old) continue;
+            uint32_t oh = 2166136261u;
+            for (const char* c = old; *c; c++) oh = (oh ^ (unsigned char)*c) * 16777619u;
+            int j = (int)(oh & (uint32_t)(cap - 1));
+            while (table[j]) j = (j + 1) & (cap - 1);
+            table[j] = old;
+        }
+        free(srv->ui_intern);
+        srv->ui_intern = table;
+        srv->ui_intern_cap = cap;
+    }
+
+    int mask = srv->ui_intern_cap - 1;
+    int i = (int)(h & (uint32_t)mask);
+    for (; srv->ui_intern[i]; i = (i + 1) & mask) {
+        char* have = srv->ui_intern[i];
+        if (strncmp(have, str, len) == 0 && have[len] == '\0') return have;
+    }
+    char* copy = (char*)wce_ui_alloc(&srv->ui_strings, len + 1, 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    srv->ui_intern[i] = copy;
+    srv->ui_intern_count++;
+    return copy;
+}
+
+// Node names. Entries are never deleted: a removed node only clears its
+// entry's node, and a name given again reuses the slot.
+typedef struct wce_ui_id {
+    const char* name;        // Interned
+    WceNode* node;
+    struct wce_snapshot* fragment; // Cached render, see "Fragments"
+} wce_ui_id_t;
+
+static wce_ui_id_t* wce_ui_id_slot(wce_server_t* srv, const char* name) {
+    if (!srv->ui_ids_cap) return NULL;
+    uint32_t h = 2166136261u;
+    for (const char* c = name; *c; c++) h = (h ^ (unsigned char)*c) * 16777619u;
+    int mask = srv->ui_ids_cap - 1;
+    for (int i = (int)(h & (uint32_t)mask);; i = (i + 1) & mask) {
+        wce_ui_id_t* e = &srv->ui_ids[i];
+        if (!e->name || strcmp(e->name, name) == 0) return e;
+    }
+}
+
+static WceNode* wce_ui_find(wce_server_t* srv, const char* name) {
+    wce_ui_id_t* e = name ? wce_ui_id_slot(srv, name) : NULL;
+    return (e && e->name) ? e->node : NULL;
+}
+
+void _wce_node_set_id(WceNode* node, const char* id) {
+    wce_server_t* srv = wce_self();
+    if (!node || !id) return;
+    if ((srv->ui_ids_count + 1) * 2 > srv->ui_ids_cap) {
+        int cap = srv->ui_ids_cap ? srv->ui_ids_cap * 2 : 64;
+        wce_ui_id_t* old = srv->ui_ids;
+        int old_cap = srv->ui_ids_cap;
+        srv->ui_ids = (wce_ui_id_t*)calloc((size_t)cap, sizeof(wce_ui_id_t));
+        if (!srv->ui_ids) {
+            srv->ui_ids = old;
+            return;
+        }
+        srv->ui_ids_cap = cap;
+        for (int i = 0; i < old_cap; i++) {
+            if (old[i].name) *wce_ui_id_slot(srv, old[i].name) = old[i];
+        }
+        free(old);
+    }
+    char* name = wce_ui_intern(srv, id, strlen(id));
+    if (!name) return;
+    wce_ui_id_t* e = wce_ui_id_slot(srv, name);
+    if (!e->name) srv->ui_ids_count++;
+    if (e->node && e->node != node) e->node->id = NULL; // The name moves
+    e->name = name;
+    e->node = node;
+    node->id = name;
+    srv->ui_version++;
+}
+
+static void wce_patch_clear(wce_server_t* srv);
+static void wce_snapshot_release(struct wce_snapshot* snap);
+
+// Drops the whole tree (nodes, interned strings, builder stack) at once.
+// Arena memory is kept only when `keep` is set.
+static void wce_ui_clear(wce_server_t* srv, int keep) {
+    wce_ui_arena_reset(&srv->ui_nodes, keep);
+    wce_ui_arena_reset(&srv->ui_strings, keep);
+    if (keep && srv->ui_intern) {
+        memset(srv->ui_intern, 0, (size_t)srv->ui_intern_cap * sizeof(char*));
+    } else {
+        free(srv->ui_intern);
+        srv->ui_intern = NULL;
+        srv->ui_intern_cap = 0;
+        free(srv->ui_stack);
+        srv->ui_stack = NULL;
+        srv->ui_stack_cap = 0;
+    }
+    srv->ui_intern_count = 0;
+    for (int i = 0; i < srv->ui_ids_cap; i++) wce_snapshot_release(srv->ui_ids[i].fragment);
+    free(srv->ui_ids);
+    srv->ui_ids = NULL;
+    srv->ui_ids_cap = 0;
+    srv->ui_ids_count = 0;
+    srv->ui_free = NULL;
+    srv->ui_root = NULL;
+    srv->ui_top = -1;
+    srv->ui_last = NULL;
+    srv->ui_version++;
+    wce_patch_clear(srv);
+}
+
+void wce_server_ui_reset(wce_server_t* srv) {
+    wce_ui_clear(srv, 1);
+}
+
+void wce_ui_reset(void) {
+    wce_ui_clear(wce_self(), 1);
+}
+
 WceNode* _wce_node_create(WceNodeType type) {
-    WceNode* n = (WceNode*)malloc(sizeof(WceNode));
+    wce_server_t* srv = wce_self();
+    WceNode* n = srv->ui_free;
+    if (n) srv->ui_free = n->next_sibling;
+    else n = (WceNode*)wce_ui_alloc(&srv->ui_nodes, sizeof(WceNode), sizeof(void*));
+    if (!n) return NULL;
     memset(n, 0, sizeof(WceNode));
     n->type = type;
-    _wce_last_created = n;
+    srv->ui_last = n;
+    srv->ui_version++;
     return n;
 }
 
 void _wce_add_style(const char* style) {
-    if (_wce_last_created && style) {
-        #ifdef _WIN32
-        _wce_last_created->style = _strdup(style);
-        #else
-        _wce_last_created->style = strdup(style);
-        #endif
+    wce_server_t* srv = wce_self();
+    if (srv->ui_last && style) {
+        srv->ui_last->style = wce_ui_intern(srv, style, strlen(style));
+        srv->ui_version++;
     }
 }
 
 void _wce_push_context(WceNode* node) {
-    if (_wce_ctx_top < 31) {
-        _wce_ctx_stack[++_wce_ctx_top] = node;
+    wce_server_t* srv = wce_self();
+    if (srv->ui_top + 1 >= srv->ui_stack_cap) {
+        int cap = srv->ui_stack_cap ? srv->ui_stack_cap * 2 : 32;
+        WceNode** stack = (WceNode**)realloc(srv->ui_stack, (size_t)cap * sizeof(WceNode*));
+        if (!stack) return;
+        srv->ui_stack = stack;
+        srv->ui_stack_cap = cap;
     }
-    if (!_wce_root) _wce_root = node;
+    srv->ui_stack[++srv->ui_top] = node;
+    if (!srv->ui_root) srv->ui_root = node;
+    srv->ui_version++;
 }
 
 void _wce_pop_context(void) {
-    if (_wce_ctx_top >= 0) {
-        _wce_ctx_top--;
+    wce_server_t* srv = wce_self();
+    if (srv->ui_top >= 0) {
+        srv->ui_top--;
     }
 }
 
+// The inline wce_css() / wce_bind() / wce_on_click() write through the
+// returned node, so handing it out counts as a change.
 WceNode* _wce_current_context(void) {
-    if (_wce_ctx_top >= 0) return _wce_ctx_stack[_wce_ctx_top];
+    wce_server_t* srv = wce_self();
+    srv->ui_version++;
+    if (srv->ui_top >= 0) return srv->ui_stack[srv->ui_top];
     return NULL;
 }
 
 void _wce_add_child(WceNode* parent, WceNode* child) {
     if (!parent || !child) return;
+    wce_self()->ui_version++;
     child->parent = parent;
     if (!parent->first_child) {
         parent->first_child = child;
@@ -386,60 +964,254 @@ void _wce_add_child(WceNode* parent, WceNode* child) {
 }
 
 void _wce_node_set_prop(WceNode* node, const char* label, const char* val_ref, const char* evt) {
+    wce_server_t* srv = wce_self();
+    srv->ui_version++;
     if (label) {
         // Auto-detect binding syntax {{ key }}
-        if (strncmp(label, "{{", 2) == 0 && strstr(label, "}}")) {
-            char* start = strstr(label, "{{") + 2;
-            char* end = strstr(label, "}}");
-            size_t len = end - start;
-            char* key = (char*)malloc(len + 1);
-            strncpy(key, start, len);
-            key[len] = '\0';
-            
-            // Trim spaces
-            char* k = key;
-            while(*k == ' ') k++;
-            char* k_end = k + strlen(k) - 1;
-            while(k_end > k && *k_end == ' ') *k_end-- = '\0';
-
-            #ifdef _WIN32
-            node->value_ref = _strdup(k);
-            #else
-            node->value_ref = strdup(k);
-            #endif
-            free(key);
+        const char* end = strstr(label, "}}");
+        if (strncmp(label, "{{", 2) == 0 && end) {
+            const char* k = label + 2;
+            while (k < end && *k == ' ') k++;
+            const char* k_end = end;
+            while (k_end > k && k_end[-1] == ' ') k_end--;
+            node->value_ref = wce_ui_intern(srv, k, (size_t)(k_end - k));
             node->label = NULL; // Clear label as it is bound
         } else {
-            #ifdef _WIN32
-            node->label = _strdup(label);
-            #else
-            node->label = strdup(label);
-            #endif
+            node->label = wce_ui_intern(srv, label, strlen(label));
         }
     }
-    if (val_ref) {
-        #ifdef _WIN32
-        node->value_ref = _strdup(val_ref);
-        #else
-        node->value_ref = strdup(val_ref);
-        #endif
-    }
-    if (evt) {
-        #ifdef _WIN32
-        node->event_handler = _strdup(evt);
-        #else
-        node->event_handler = strdup(evt);
-        #endif
-    }
+    if (val_ref) node->value_ref = wce_ui_intern(srv, val_ref, strlen(val_ref));
+    if (evt) node->event_handler = wce_ui_intern(srv, evt, strlen(evt));
+}
+
+// --- Buffer Pool ---
+// Request buffers come from per-size-class slabs. A slab is released once all
+// of its buffers are free again (one spare is kept per class to avoid churn),
+// so an idle server holds next to no buffer memory. Each server instance has
+// its own slabs; a buffer returns to the slab, and so the server, it came from.
+static const int wce_buf_class_size[] = { 1024, 4096, BUFFER_SIZE };
+static const int wce_buf_class_count[] = { 16, 16, 4 }; // buffers per slab
+typedef struct wce_slab wce_slab_t;
+
+typedef union wce_buf_hdr {
+	struct {
+		wce_slab_t* slab;
+		union wce_buf_hdr* next_free;
+	} h;
+	double align;
+} wce_buf_hdr_t;
+
+struct wce_slab {
+	wce_slab_t* prev;        // Class list of slabs that have free buffers
+	wce_slab_t* next;
+	wce_buf_hdr_t* free_list;
+	wce_slab_t** partial;    // Class lists of the owning server
+	int cls;
+	int in_use;
+};
+
+static void wce_slab_unlink(wce_slab_t* slab) {
+	if (slab->prev) slab->prev->next = slab->next;
+	else slab->partial[slab->cls] = slab->next;
+	if (slab->next) slab->next->prev = slab->prev;
+	slab->prev = slab->next = NULL;
+}
+
+static void wce_slab_link(wce_slab_t* slab) {
+	slab->prev = NULL;
+	slab->next = slab->partial[slab->cls];
+	if (slab->next) slab->next->prev = slab;
+	slab->partial[slab->cls] = slab;
+}
+
+static char* wce_buf_alloc(wce_server_t* srv, int min_size, int* out_cap) {
+	int cls = 0;
+	while (cls < WCE_BUF_CLASSES && wce_buf_class_size[cls] < min_size) cls++;
+	if (cls == WCE_BUF_CLASSES) return NULL;
+
+	wce_slab_t* slab = srv->slab_partial[cls];
+	if (!slab) {
+		size_t stride = sizeof(wce_buf_hdr_t) + (size_t)wce_buf_class_size[cls];
+		slab = (wce_slab_t*)malloc(sizeof(wce_slab_t) + stride * (size_t)wce_buf_class_count[cls]);
+		if (!slab) return NULL;
+		slab->partial = srv->slab_partial;
+		slab->cls = cls;
+		slab->in_use = 0;
+		slab->free_list = NULL;
+		char* base = (char*)(slab + 1);
+		for (int i = wce_buf_class_count[cls] - 1; i >= 0; i--) {
+			wce_buf_hdr_t* hdr = (wce_buf_hdr_t*)(base + stride * (size_t)i);
+			hdr->h.slab = slab;
+			hdr->h.next_free = slab->free_list;
+			slab->free_list = hdr;
+		}
+		wce_slab_link(slab);
+	}
+
+	wce_buf_hdr_t* hdr = slab->free_list;
+	slab->free_list = hdr->h.next_free;
+	slab->in_use++;
+	if (!slab->free_list) wce_slab_unlink(slab);
+
+	*out_cap = wce_buf_class_size[cls];
+	return (char*)(hdr + 1);
+}
+
+static void wce_buf_free(char* buf) {
+	if (!buf) return;
+	wce_buf_hdr_t* hdr = (wce_buf_hdr_t*)buf - 1;
+	wce_slab_t* slab = hdr->h.slab;
+	if (!slab->free_list) wce_slab_link(slab);
+	hdr->h.next_free = slab->free_list;
+	slab->free_list = hdr;
+	slab->in_use--;
+	if (slab->in_use == 0 && (slab->prev || slab->next)) {
+		wce_slab_unlink(slab);
+		free(slab);
+	}
+}
+
+// --- Timers ---
+// Connection deadlines live on a hashed timer wheel: WCE_TIMER_SLOTS slots of
+// WCE_TIMER_TICK_MS each, every slot a doubly linked list threaded through
+// the client table. Arming, re-arming and cancelling are O(1); a deadline
+// further out than one revolution stays in its slot until its tick comes
+// round. Deadlines count from the loop time (srv->loop_ms), read once per
+// poll and again only where a handler may have run for a while.
+#define WCE_TIMER_TICK_MS 100
+
+static void wce_timer_cancel(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	if (!c->timer_due) return;
+	if (c->timer_prev >= 0) srv->clients[c->timer_prev].timer_next = c->timer_next;
+	else srv->timer_slots[c->timer_due & (WCE_TIMER_SLOTS - 1)] = c->timer_next;
+	if (c->timer_next >= 0) srv->clients[c->timer_next].timer_prev = c->timer_prev;
+	c->timer_due = 0;
+	srv->timer_count--;
+}
+
+// (Re)arms the connection's deadline `timeout_ms` from now; a negative
+// timeout leaves it without one.
+static void wce_timer_arm(wce_server_t* srv, int index, int timeout_ms) {
+	wce_timer_cancel(srv, index);
+	if (timeout_ms < 0) return;
+	wce_client_t* c = &srv->clients[index];
+	uint64_t due = srv->loop_ms / WCE_TIMER_TICK_MS + (uint64_t)(timeout_ms + WCE_TIMER_TICK_MS - 1) / WCE_TIMER_TICK_MS;
+	if (due <= srv->timer_tick) due = srv->timer_tick + 1;
+	int* head = &srv->timer_slots[due & (WCE_TIMER_SLOTS - 1)];
+	c->timer_due = due;
+	c->timer_prev = -1;
+	c->timer_next = *head;
+	if (*head >= 0) srv->clients[*head].timer_prev = index;
+	*head = index;
+	srv->timer_count++;
+}
+
+static void wce_timers_init(wce_server_t* srv) {
+	for (int i = 0; i < WCE_TIMER_SLOTS; i++) srv->timer_slots[i] = -1;
+	srv->loop_ms = wce_now_ms();
+	srv->timer_tick = srv->loop_ms / WCE_TIMER_TICK_MS;
+	srv->timer_count = 0;
+}
+
+// Visits the slots of every tick that has passed (each slot at most once)
+// and expires the connections whose deadline is due.
+static void wce_timers_run(wce_server_t* srv) {
+	uint64_t now = srv->loop_ms / WCE_TIMER_TICK_MS;
+	uint64_t tick = srv->timer_tick;
+	if (now - tick > WCE_TIMER_SLOTS) tick = now - WCE_TIMER_SLOTS;
+	while (tick < now && srv->timer_count) {
+		tick++;
+		int i = srv->timer_slots[tick & (WCE_TIMER_SLOTS - 1)];
+		while (i >= 0) {
+			int next = srv->clients[i].timer_next;
+			if (srv->clients[i].timer_due <= now) {
+				wce_timer_cancel(srv, i);
+				wce_client_expire(srv, i);
+			}
+			i = next;
+		}
+	}
+	srv->timer_tick = now;
+}
+
+// Poll timeout until the next occupied slot comes round, -1 without deadlines.
+static int wce_timers_wait_ms(wce_server_t* srv) {
+	if (!srv->timer_count) return -1;
+	uint64_t tick = srv->timer_tick + 1;
+	while (srv->timer_slots[tick & (WCE_TIMER_SLOTS - 1)] < 0 && tick < srv->timer_tick + WCE_TIMER_SLOTS) tick++;
+	uint64_t now = wce_now_ms();
+	uint64_t at = tick * WCE_TIMER_TICK_MS;
+	return at > now ? (int)(at - now) : 0;
+}
+
+// --- Connection Slots ---
+
+// Returns a free slot index in O(1), growing the table when the free-list is
+// empty. Returns -1 once max_connections connections are open.
+static int wce_client_alloc(wce_server_t* srv, wce_socket_t fd) {
+	if (srv->client_count >= srv->cfg.max_connections) return -1;
+	if (srv->client_free < 0) {
+		int new_cap = srv->client_cap ? srv->client_cap * 2 : 64;
+		if (new_cap > srv->cfg.max_connections) new_cap = srv->cfg.max_connections;
+		wce_client_t* grown = (wce_client_t*)realloc(srv->clients, sizeof(wce_client_t) * (size_t)new_cap);
+		if (!grown) return -1;
+		srv->clients = grown;
+		for (int i = new_cap - 1; i >= srv->client_cap; i--) {
+			srv->clients[i].fd = WCE_INVALID_SOCKET;
+			srv->clients[i].buffer = NULL;
+			srv->clients[i].buf_cap = 0;
+			srv->clients[i].buf_len = 0;
+			srv->clients[i].active = 0;
+			srv->clients[i].req = NULL;
+			srv->clients[i].h2 = NULL;
+			srv->clients[i].timer_due = 0;
+			srv->clients[i].out = NULL;
+			srv->clients[i].out_len = srv->clients[i].out_sent = srv->clients[i].out_cap = 0;
+			srv->clients[i].next_free = srv->client_free;
+			srv->client_free = i;
+		}
+		srv->client_cap = new_cap;
+	}
+
+	int index = srv->client_free;
+	srv->client_free = srv->clients[index].next_free;
+	srv->clients[index].fd = fd;
+	srv->clients[index].buf_len = 0;
+	srv->clients[index].head_len = 0;
+	srv->clients[index].out_failed = 0;
+	srv->clients[index].closing = 0;
+	srv->clients[index].watch = WCE_WATCH_READ;
+	srv->clients[index].active = 1;
+	srv->client_count++;
+	return index;
 }
 
-void wce_reset_client(int index) {
-	if (clients[index].fd != WCE_INVALID_SOCKET) {
-		wce_close_socket(clients[index].fd);
+static void wce_reset_client(wce_server_t* srv, int index) {
+	if (srv->clients[index].req) {
+		wce_body_release(srv->clients[index].req);
+		srv->clients[index].req = NULL;
+	}
+	if (srv->clients[index].h2) {
+		wce_h2_free(srv->clients[index].h2);
+		srv->clients[index].h2 = NULL;
+	}
+	wce_timer_cancel(srv, index);
+	if (srv->clients[index].fd != WCE_INVALID_SOCKET) wce_close_socket(srv->clients[index].fd);
+	wce_buf_free(srv->clients[index].buffer);
+	free(srv->clients[index].out);
+	srv->clients[index].out = NULL;
+	srv->clients[index].out_len = srv->clients[index].out_sent = srv->clients[index].out_cap = 0;
+	srv->clients[index].fd = WCE_INVALID_SOCKET;
+	srv->clients[index].buffer = NULL;
+	srv->clients[index].buf_cap = 0;
+	srv->clients[index].buf_len = 0;
+	if (srv->clients[index].active) {
+		srv->clients[index].active = 0;
+		srv->client_count--;
+		srv->clients[index].next_free = srv->client_free;
+		srv->client_free = index;
 	}
-	clients[index].fd = WCE_INVALID_SOCKET;
-	clients[index].buf_len = 0;
-	clients[index].active = 0;
 }
 
 char* read_file_content(const char* path, size_t* out_len) {
@@ -458,244 +1230,3770 @@ char* read_file_content(const char* path, size_t* out_len) {
 	return buffer;
 }
 
-void send_response(wce_socket_t client_fd, const char* status, const char* content_type, const char* body, size_t body_len) {
-	char header[1024];
-	int header_len = snprintf(header, sizeof(header),
-		"HTTP/1.1 %s\r\n"
-		"Content-Type: %s\r\n"
-		"Content-Length: %zu\r\n"
-		"Connection: close\r\n"
-		"Access-Control-Allow-Origin: *\r\n"
-		"\r\n",
-		status, content_type, body_len);
+// --- Output Queue ---
+// Writes never block the loop. What the socket does not take right away is
+// copied to the connection's queue, and the loop sends it once the poller
+// reports the socket writable. The write deadline starts when the socket
+// first refuses data and does not move while the client takes bytes; only
+// every WCE_SEND_PROGRESS bytes taken restart it. A client that reads a
+// byte at a time is dropped after send_timeout_ms, a slow download is not.
+#ifdef MSG_NOSIGNAL
+	#define WCE_SEND_FLAGS MSG_NOSIGNAL  // A peer that went away is an error, not SIGPIPE
+#else
+	#define WCE_SEND_FLAGS 0
+#endif
+#define WCE_SEND_PROGRESS 65536 // Bytes taken from the queue that restart the write deadline
 
-	send(client_fd, header, header_len, 0);
-	if (body && body_len > 0) {
-		send(client_fd, body, body_len, 0);
-	}
+static void wce_client_deadline(wce_server_t* srv, int index);
+
+// One non-blocking send. Returns the bytes sent, 0 when the socket buffer
+// is full, -1 on error.
+static int wce_send_some(wce_socket_t fd, const char* data, size_t len) {
+	int chunk = len > (1u << 30) ? (1 << 30) : (int)len;
+	int n = (int)send(fd, data, chunk, WCE_SEND_FLAGS);
+	if (n >= 0) return n;
+	return wce_get_error() == WCE_EAGAIN ? 0 : -1;
 }
 
-void process_request(int client_idx) {
-	wce_client_t* c = &clients[client_idx];
-	c->buffer[c->buf_len] = '\0';
+// Poller interest follows the connection: reads until the response is
+// complete, writes while output is queued.
+static void wce_client_watch(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	int watch = (c->closing ? 0 : WCE_WATCH_READ) | (c->out_sent < c->out_len ? WCE_WATCH_WRITE : 0);
+	if (watch == c->watch) return;
+	c->watch = watch;
+	wce_poll_watch(srv, index, watch);
+}
 
-	char method[16], path[256];
-	if (sscanf(c->buffer, "%15s %255s", method, path) != 2) {
-		return;
-	}
+static void wce_out_fail(wce_client_t* c) {
+	free(c->out);
+	c->out = NULL;
+	c->out_len = c->out_sent = c->out_cap = 0;
+	c->out_failed = 1;
+}
 
-	// API: List Data
-	if (strncmp(path, "/api/list", 9) == 0 && strcmp(method, "GET") == 0) {
-		char* q = strchr(path, '?');
-		if (q) {
-			char* name_param = strstr(q, "name=");
-			if (name_param) {
-				char* list_name = name_param + 5;
-				char* end = strchr(list_name, '&');
-				if (end) *end = '\0';
-				char* json = wce_get_list_json(list_name);
-				send_response(c->fd, "200 OK", "application/json", json, strlen(json));
-				return;
-			}
+// Sends from the front of the queue until the socket is full; an emptied
+// queue gives its memory back. Returns -1 on a send error.
+static int wce_out_flush(wce_server_t* srv, wce_client_t* c) {
+	while (c->out_sent < c->out_len) {
+		int n = wce_send_some(c->fd, c->out + c->out_sent, c->out_len - c->out_sent);
+		if (n < 0) {
+			wce_out_fail(c);
+			return -1;
 		}
-		send_response(c->fd, "400 Bad Request", "text/plain", "Missing name param", 18);
-		return;
-	}
-
-	// API: Model Update
-	if (strncmp(path, "/api/update", 11) == 0 && strcmp(method, "POST") == 0) {
-		char* q = strchr(path, '?');
-		if (q) {
-			char* key_param = strstr(q, "key=");
-			char* val_param = strstr(q, "val=");
-			if (key_param && val_param) {
-				char* key = key_param + 4;
-				char* end_key = strchr(key, '&');
-				if (end_key) *end_key = '\0';
-				char* val = val_param + 4;
-				char* end_val = strchr(val, '&');
-				if (end_val) *end_val = '\0';
-				
-				// Update KV store directly
-				wce_data_set(key, val);
-				
-				// Also call hook if needed (optional)
-				wce_handle_model_update(key, val);
-				
-				send_response(c->fd, "200 OK", "text/plain", "OK", 2);
-				return;
-			}
+		if (!n) return 0;
+		c->out_sent += (size_t)n;
+		c->out_progress += (size_t)n;
+		if (c->out_progress >= WCE_SEND_PROGRESS) {
+			c->out_progress = 0;
+			c->out_due = wce_now_ms() + (uint64_t)srv->cfg.send_timeout_ms;
 		}
-		send_response(c->fd, "400 Bad Request", "text/plain", "Missing params", 14);
-		return;
 	}
+	free(c->out);
+	c->out = NULL;
+	c->out_len = c->out_sent = c->out_cap = 0;
+	return 0;
+}
 
-	// API: Data Sync
-	if (strcmp(path, "/api/data") == 0 && strcmp(method, "GET") == 0) {
-		char json[4096] = "{";
-		for (int i = 0; i < kv_count; i++) {
-			if (i > 0) strcat(json, ",");
-			char entry[256];
-			snprintf(entry, sizeof(entry), "\"%s\":\"%s\"", kv_store[i].key, kv_store[i].value);
-			strcat(json, entry);
-		}
-		strcat(json, "}");
-		send_response(c->fd, "200 OK", "application/json", json, strlen(json));
+// Whether output waits for the socket to become writable.
+static int wce_conn_blocked(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	return c->out_sent < c->out_len;
+}
+
+// Appends `data` to the queue without trying the socket. Returns -1 once
+// the connection has failed.
+static int wce_conn_queue(wce_server_t* srv, int index, const char* data, size_t len) {
+	wce_client_t* c = &srv->clients[index];
+	if (c->out_failed) return -1;
+	if (!len) return 0;
+	int started = c->out_sent == c->out_len;
+	if (c->out_len + len > c->out_cap && c->out_sent) {
+		memmove(c->out, c->out + c->out_sent, c->out_len - c->out_sent);
+		c->out_len -= c->out_sent;
+		c->out_sent = 0;
+	}
+	if (c->out_len + len > c->out_cap) {
+		size_t cap = c->out_cap ? c->out_cap : 4096;
+		while (cap < c->out_len + len) cap *= 2;
+		char* grown = (char*)realloc(c->out, cap);
+		if (!grown) {
+			wce_out_fail(c);
+			return -1;
+		}
+		c->out = grown;
+		c->out_cap = cap;
+	}
+	memcpy(c->out + c->out_len, data, len);
+	c->out_len += len;
+	if (started) {
+		c->out_due = wce_now_ms() + (uint64_t)srv->cfg.send_timeout_ms;
+		c->out_progress = 0;
+		wce_client_watch(srv, index);
+	}
+	return 0;
+}
+
+// Sends `data` on connection `index`, queueing whatever the socket does not
+// take. Returns -1 once the connection has failed.
+static int wce_conn_send(wce_server_t* srv, int index, const char* data, size_t len) {
+	wce_client_t* c = &srv->clients[index];
+	if (c->out_failed) return -1;
+	WCE_TRACE_BEGIN(send);
+	if (c->out_sent < c->out_len && wce_out_flush(srv, c) != 0) return -1;
+	while (len > 0 && c->out_sent == c->out_len) {
+		int n = wce_send_some(c->fd, data, len);
+		if (n < 0) {
+			wce_out_fail(c);
+			return -1;
+		}
+		if (!n) break;
+		data += n;
+		len -= (size_t)n;
+	}
+	WCE_TRACE_END(send, "send");
+	return wce_conn_queue(srv, index, data, len);
+}
+
+// The socket has room again. Once the queue is empty a closing connection
+// is closed; any other goes back to waiting for reads.
+static void wce_conn_writable(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	uint64_t due = c->out_due;
+	WCE_TRACE_BEGIN(send);
+	int rc = wce_out_flush(srv, c);
+	WCE_TRACE_END(send, "send");
+	if (rc != 0 || (c->closing && c->out_sent == c->out_len)) {
+		wce_reset_client(srv, index);
+		return;
+	}
+	if (c->out_sent == c->out_len) wce_client_watch(srv, index);
+	if (c->out_sent == c->out_len || c->out_due != due) wce_client_deadline(srv, index);
+}
+
+// The response is complete: the connection closes as soon as its queued
+// output has gone out, or when the write deadline passes.
+static void wce_client_close(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	if (c->out_failed || c->out_sent == c->out_len) {
+		wce_reset_client(srv, index);
+		return;
+	}
+	if (c->req) {
+		wce_body_release(c->req);
+		c->req = NULL;
+	}
+	if (c->h2) {
+		wce_h2_free(c->h2);
+		c->h2 = NULL;
+	}
+	wce_buf_free(c->buffer);
+	c->buffer = NULL;
+	c->buf_cap = 0;
+	c->buf_len = 0;
+	c->closing = 1;
+	wce_client_watch(srv, index);
+	wce_client_deadline(srv, index);
+}
+
+// Optional response headers; NULL fields are left out.
+typedef struct {
+	const char* etag;
+	const char* cache_control;
+	const char* content_encoding;
+	const char* vary;
+	const char* patch_seq;   // X-Wce-Patch, see "UI Patches"
+} wce_resp_headers_t;
+
+// Appends "Name: value\r\n" when value is set and fits.
+static int wce_head_field(char* head, int len, int cap, const char* name, const char* value) {
+	if (!value || len < 0 || len >= cap) return len;
+	int n = snprintf(head + len, (size_t)(cap - len), "%s: %s\r\n", name, value);
+	return (n < 0 || n >= cap - len) ? len : len + n;
+}
+
+// Formats an HTTP/1.1 response head into `header` (1024 bytes) and returns
+// its length.
+static int wce_response_head(char* header, int code, const char* status, const char* content_type,
+	size_t body_len, const wce_resp_headers_t* extra) {
+	const int cap = 1024;
+	int header_len = snprintf(header, (size_t)cap,
+		"HTTP/1.1 %s\r\n"
+		"Content-Type: %s\r\n",
+		status, content_type);
+	// A 304 has no body, and its Content-Length would describe the 200 one
+	if (code != 304) header_len += snprintf(header + header_len, (size_t)(cap - header_len),
+		"Content-Length: %zu\r\n", body_len);
+	if (extra) {
+		header_len = wce_head_field(header, header_len, cap - 64, "ETag", extra->etag);
+		header_len = wce_head_field(header, header_len, cap - 64, "Cache-Control", extra->cache_control);
+		header_len = wce_head_field(header, header_len, cap - 64, "Content-Encoding", extra->content_encoding);
+		header_len = wce_head_field(header, header_len, cap - 64, "Vary", extra->vary);
+		header_len = wce_head_field(header, header_len, cap - 64, "X-Wce-Patch", extra->patch_seq);
+	}
+	header_len += snprintf(header + header_len, (size_t)(cap - header_len),
+		"Connection: close\r\n"
+		"Access-Control-Allow-Origin: *\r\n"
+		"\r\n");
+	return header_len;
+}
+
+static void wce_send_response(wce_server_t* srv, int index, int code, const char* status, const char* content_type,
+	const char* body, size_t body_len, const wce_resp_headers_t* extra) {
+	char header[1024];
+	if (code == 304) body_len = 0;
+	int header_len = wce_response_head(header, code, status, content_type, body_len, extra);
+	if (wce_conn_send(srv, index, header, (size_t)header_len) == 0 && body && body_len > 0) {
+		wce_conn_send(srv, index, body, body_len);
+	}
+}
+
+// For a socket without a connection slot, closed right after: whatever the
+// socket buffer takes in one go.
+void send_response(wce_socket_t client_fd, const char* status, const char* content_type, const char* body, size_t body_len) {
+	char header[1024];
+	int header_len = wce_response_head(header, 0, status, content_type, body_len, NULL);
+	if (wce_send_some(client_fd, header, (size_t)header_len) == header_len && body && body_len > 0) {
+		wce_send_some(client_fd, body, body_len);
+	}
+}
+
+// --- Requests ---
+#define WCE_MAX_PATH_PARAMS 8
+#define WCE_MAX_QUERY_PARAMS 32
+#define WCE_MAX_QUERY_SEGMENTS 128 // "&"-separated parts looked at, repeated names included
+#define WCE_QUERY_SLOTS 64       // Lookup index size, power of two > 2 * WCE_MAX_QUERY_PARAMS
+
+typedef struct {
+	const char* name;        // Decoded, NUL-terminated, in the request scratch area
+	const char* value;
+	unsigned hash;
+} wce_query_param_t;
+
+// Chunked response stream. Payload is staged in one pooled buffer with room
+// for the chunk-size line in front, so each chunk goes out in a single send.
+// The writer is never held up by the client: once the socket is full,
+// chunks join the connection's output queue (see "Output Queue") and the
+// loop sends them when it has room.
+#define WCE_STREAM_BUF 4096
+#define WCE_CHUNK_HEAD 8         // Room for "%x\r\n" in front of the payload
+
+struct wce_stream {
+	wce_request_t* req;
+	char* buf;
+	int cap;
+	int len;                 // Payload bytes staged after WCE_CHUNK_HEAD
+	int open;
+	int failed;
+	size_t queued;           // Bytes queued since the socket was last tried
+};
+
+struct wce_request {
+	wce_server_t* srv;       // Instance serving the request
+	wce_socket_t fd;
+	int conn;                // Connection slot, its queue carries the response
+	const char* method;
+	const char* path;        // Without the query string
+	const char* query;       // Raw text after '?', or "" when absent
+	int param_count;
+	const char* param_names[WCE_MAX_PATH_PARAMS];
+	char* param_values[WCE_MAX_PATH_PARAMS];
+	int query_parsed;
+	int query_count;
+	wce_query_param_t query_params[WCE_MAX_QUERY_PARAMS];
+	unsigned char query_index[WCE_QUERY_SLOTS]; // Slot -> param index + 1, 0 when empty
+	char* scratch;           // Pooled buffer holding the decoded query
+	int scratch_cap;
+	char* headers;           // Header lines in the request head, split on first lookup
+	char* headers_end;
+	int headers_split;
+	int responded;
+	wce_stream_t stream;
+	// Streaming body state, see "Request Bodies"
+	wce_body_handler_t body_handler;
+	void* user;
+	long long content_length; // -1 for a chunked body
+	unsigned long long body_left; // Bytes left in the body or the current chunk
+	unsigned long long body_total; // Body bytes handed to the handler, checked against max_body_size
+	int chunked;
+	int chunk_state;
+	int chunk_digits;
+	int chunk_line;          // Length of the current trailer line
+	int finished;
+	int aborted;
+	char* body_buf;          // Pooled receive buffer for body data
+	int body_cap;
+	struct wce_h2_conn* h2;  // HTTP/2 connection the request arrived on, see "HTTP/2"
+	unsigned h2_stream;
+};
+
+static int wce_h2_head(wce_request_t* req, int status, const char* content_type, long long content_length,
+	const wce_resp_headers_t* extra);
+static int wce_h2_data(wce_request_t* req, const char* data, size_t len, int end_stream);
+
+static const char* wce_status_text(int status) {
+	switch (status) {
+		case 200: return "200 OK";
+		case 201: return "201 Created";
+		case 204: return "204 No Content";
+		case 304: return "304 Not Modified";
+		case 400: return "400 Bad Request";
+		case 403: return "403 Forbidden";
+		case 404: return "404 Not Found";
+		case 405: return "405 Method Not Allowed";
+		case 408: return "408 Request Timeout";
+		case 409: return "409 Conflict";
+		case 411: return "411 Length Required";
+		case 413: return "413 Payload Too Large";
+		case 500: return "500 Internal Server Error";
+		case 501: return "501 Not Implemented";
+		case 503: return "503 Service Unavailable";
+		default:  return status >= 500 ? "500 Internal Server Error" : status >= 400 ? "400 Bad Request" : "200 OK";
+	}
+}
+
+static void wce_respond_with(wce_request_t* req, int status, const char* content_type, const char* body, size_t body_len,
+	const wce_resp_headers_t* extra) {
+	if (!req || req->responded) return;
+	req->responded = 1;
+	if (req->h2) {
+		size_t len = (body && status != 304) ? body_len : 0;
+		if (wce_h2_head(req, status, content_type, (long long)len, extra) == 0 && len) wce_h2_data(req, body, len, 1);
+		return;
+	}
+	wce_send_response(req->srv, req->conn, status, wce_status_text(status), content_type ? content_type : "text/plain",
+		body, body_len, extra);
+}
+
+void wce_respond(wce_request_t* req, int status, const char* content_type, const char* body, size_t body_len) {
+	wce_respond_with(req, status, content_type, body, body_len, NULL);
+}
+
+wce_stream_t* wce_stream_begin(wce_request_t* req, int status, const char* content_type) {
+	if (!req || req->responded) return NULL;
+	wce_stream_t* s = &req->stream;
+	s->buf = wce_buf_alloc(req->srv, WCE_STREAM_BUF, &s->cap);
+	if (!s->buf) {
+		wce_respond(req, 500, "text/plain", "Out of memory", 13);
+		return NULL;
+	}
+	req->responded = 1;
+	s->req = req;
+	s->len = 0;
+	s->open = 1;
+	s->failed = 0;
+	s->queued = 0;
+	if (req->h2) {
+		if (wce_h2_head(req, status, content_type, -1, NULL) != 0) s->failed = 1;
+		return s;
+	}
+
+	// The head goes out right away: time to first byte does not depend on
+	// how much the writer produces.
+	char header[512];
+	int header_len = snprintf(header, sizeof(header),
+		"HTTP/1.1 %s\r\n"
+		"Content-Type: %s\r\n"
+		"Transfer-Encoding: chunked\r\n"
+		"Connection: close\r\n"
+		"Access-Control-Allow-Origin: *\r\n"
+		"\r\n",
+		wce_status_text(status), content_type ? content_type : "text/plain");
+	if (wce_conn_send(req->srv, req->conn, header, (size_t)header_len) != 0) s->failed = 1;
+	return s;
+}
+
+static int wce_stream_flush(wce_stream_t* s) {
+	if (!s->len || s->failed) return s->failed ? -1 : 0;
+	if (s->req->h2) {
+		if (wce_h2_data(s->req, s->buf + WCE_CHUNK_HEAD, (size_t)s->len, 0) != 0) s->failed = 1;
+		s->len = 0;
+		return s->failed ? -1 : 0;
+	}
+	char size_line[WCE_CHUNK_HEAD + 1];
+	int n = snprintf(size_line, sizeof(size_line), "%x\r\n", (unsigned)s->len);
+	char* chunk = s->buf + WCE_CHUNK_HEAD - n;
+	memcpy(chunk, size_line, (size_t)n);
+	memcpy(s->buf + WCE_CHUNK_HEAD + s->len, "\r\n", 2);
+	size_t size = (size_t)(n + s->len + 2);
+	wce_server_t* srv = s->req->srv;
+	int rc;
+	// While earlier chunks wait for the socket this one joins them; the
+	// socket is tried again only every WCE_SEND_PROGRESS bytes.
+	if (wce_conn_blocked(srv, s->req->conn) && s->queued < WCE_SEND_PROGRESS) {
+		s->queued += size;
+		rc = wce_conn_queue(srv, s->req->conn, chunk, size);
+	} else {
+		s->queued = 0;
+		rc = wce_conn_send(srv, s->req->conn, chunk, size);
+	}
+	if (rc != 0) s->failed = 1;
+	s->len = 0;
+	return s->failed ? -1 : 0;
+}
+
+int wce_stream_write(wce_stream_t* s, const char* data, size_t len) {
+	if (!s || !s->open || s->failed) return -1;
+	while (len > 0) {
+		size_t room = (size_t)(s->cap - WCE_CHUNK_HEAD - 2 - s->len);
+		if (!room) {
+			if (wce_stream_flush(s) != 0) return -1;
+			continue;
+		}
+		size_t take = len < room ? len : room;
+		memcpy(s->buf + WCE_CHUNK_HEAD + s->len, data, take);
+		s->len += (int)take;
+		data += take;
+		len -= take;
+	}
+	return 0;
+}
+
+int wce_stream_puts(wce_stream_t* s, const char* str) {
+	return str ? wce_stream_write(s, str, strlen(str)) : 0;
+}
+
+// Direct access to the staging buffer for serializers: reserve room for up
+// to `n` (at most WCE_STREAM_RESERVE_MAX) bytes, write them in place, then
+// commit up to the end pointer.
+
+char* wce_stream_reserve(wce_stream_t* s, size_t n) {
+	if (!s || !s->open || s->failed || n > WCE_STREAM_RESERVE_MAX) return NULL;
+	if ((size_t)(s->cap - WCE_CHUNK_HEAD - 2 - s->len) < n && wce_stream_flush(s) != 0) return NULL;
+	return s->buf + WCE_CHUNK_HEAD + s->len;
+}
+
+void wce_stream_commit(wce_stream_t* s, char* end) {
+	if (!s || !s->open || !end) return;
+	s->len = (int)(end - (s->buf + WCE_CHUNK_HEAD));
+}
+
+// Writes `str` (at most max_len bytes, stopping at NUL) as a quoted JSON
+// string, escaping straight into the staging buffer. NULL becomes null.
+int wce_stream_json_string(wce_stream_t* s, const char* str, size_t max_len) {
+	static const char hex[] = "0123456789abcdef";
+	if (!str) return wce_stream_write(s, "null", 4);
+	char* p = wce_stream_reserve(s, 1);
+	if (!p) return -1;
+	*p++ = '"';
+	size_t i = 0;
+	for (;;) {
+		// Each input byte expands to at most 6 output bytes.
+		wce_stream_commit(s, p);
+		p = wce_stream_reserve(s, WCE_STREAM_RESERVE_MAX);
+		if (!p) return -1;
+		char* limit = p + WCE_STREAM_RESERVE_MAX - 7;
+		for (; i < max_len && str[i] && p < limit; i++) {
+			unsigned char ch = (unsigned char)str[i];
+			if (ch >= 0x20 && ch != '"' && ch != '\\') {
+				*p++ = (char)ch;
+			} else if (ch == '"' || ch == '\\') {
+				*p++ = '\\';
+				*p++ = (char)ch;
+			} else {
+				memcpy(p, "\\u00", 4);
+				p[4] = hex[ch >> 4];
+				p[5] = hex[ch & 0xF];
+				p += 6;
+			}
+		}
+		if (i == max_len || !str[i]) break;
+	}
+	*p++ = '"';
+	wce_stream_commit(s, p);
+	return 0;
+}
+
+int wce_stream_end(wce_stream_t* s) {
+	if (!s || !s->open) return -1;
+	if (s->req->h2) {
+		// The last DATA frame carries END_STREAM, even when it is empty
+		if (!s->failed && wce_h2_data(s->req, s->buf + WCE_CHUNK_HEAD, (size_t)s->len, 1) != 0) s->failed = 1;
+		s->len = 0;
+	} else {
+		wce_stream_flush(s);
+		if (!s->failed && wce_conn_send(s->req->srv, s->req->conn, "0\r\n\r\n", 5) != 0) s->failed = 1;
+	}
+	wce_buf_free(s->buf);
+	s->buf = NULL;
+	s->open = 0;
+	return s->failed ? -1 : 0;
+}
+
+const char* wce_req_method(wce_request_t* req) { return req ? req->method : NULL; }
+
+const char* wce_req_path(wce_request_t* req) { return req ? req->path : NULL; }
+
+const char* wce_req_param(wce_request_t* req, const char* name) {
+	if (!req || !name) return NULL;
+	for (int i = 0; i < req->param_count; i++) {
+		if (strcmp(req->param_names[i], name) == 0) return req->param_values[i];
+	}
+	return NULL;
+}
+
+static int wce_ascii_ieq(const char* a, const char* b, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		char x = a[i], y = b[i];
+		if (x >= 'A' && x <= 'Z') x = (char)(x - 'A' + 'a');
+		if (y >= 'A' && y <= 'Z') y = (char)(y - 'A' + 'a');
+		if (x != y) return 0;
+	}
+	return 1;
+}
+
+// Header lines are split into NUL-terminated strings in place on the first
+// lookup; later lookups are a linear scan over the (few) lines.
+const char* wce_req_header(wce_request_t* req, const char* name) {
+	if (!req || !name || !req->headers) return NULL;
+	if (!req->headers_split) {
+		for (char* p = req->headers; p < req->headers_end; p++) {
+			if (*p == '\r' || *p == '\n') *p = '\0';
+		}
+		req->headers_split = 1;
+	}
+	size_t name_len = strlen(name);
+	for (char* line = req->headers; line < req->headers_end; line += strlen(line) + 1) {
+		if (line[0] && wce_ascii_ieq(line, name, name_len) && line[name_len] == ':') {
+			char* v = line + name_len + 1;
+			while (*v == ' ' || *v == '\t') v++;
+			char* e = v + strlen(v);
+			while (e > v && (e[-1] == ' ' || e[-1] == '\t')) *--e = '\0';
+			return v;
+		}
+	}
+	return NULL;
+}
+
+// --- Query String ---
+
+static int wce_hex_value(char ch) {
+	if (ch >= '0' && ch <= '9') return ch - '0';
+	if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+	return -1;
+}
+
+// application/x-www-form-urlencoded decoding: '+' is a space and %XX a byte.
+// Malformed escapes are copied through unchanged. Returns the decoded length.
+static size_t wce_url_decode(char* dst, const char* src, size_t len) {
+	size_t out = 0;
+	for (size_t i = 0; i < len; i++) {
+		char ch = src[i];
+		if (ch == '+') {
+			ch = ' ';
+		} else if (ch == '%' && i + 2 < len) {
+			int hi = wce_hex_value(src[i + 1]);
+			int lo = wce_hex_value(src[i + 2]);
+			if (hi >= 0 && lo >= 0) {
+				ch = (char)((hi << 4) | lo);
+				i += 2;
+			}
+		}
+		dst[out++] = ch;
+	}
+	return out;
+}
+
+static unsigned wce_query_hash(const char* s) {
+	unsigned h = 2166136261u;
+	for (; *s; s++) {
+		h ^= (unsigned char)*s;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+// Tokenizes the raw query once: every name and value is decoded into the
+// scratch area and indexed by name hash. The raw query is left untouched.
+// The first occurrence of a repeated name wins.
+static void wce_query_parse(wce_request_t* req) {
+	req->query_parsed = 1;
+	size_t qlen = strlen(req->query);
+	if (qlen == 0) return;
+
+	// A part decodes to at most its length plus two NULs, and each part but
+	// the last also consumes a '&', so "a&a&..." needs 3 bytes per 2 of input.
+	req->scratch = wce_buf_alloc(req->srv, (int)(qlen + qlen / 2 + 2), &req->scratch_cap);
+	if (!req->scratch) return;
+
+	char* out = req->scratch;
+	const char* p = req->query;
+	const char* end = p + qlen;
+	int segments = 0;
+	while (p < end && req->query_count < WCE_MAX_QUERY_PARAMS && segments++ < WCE_MAX_QUERY_SEGMENTS) {
+		const char* amp = memchr(p, '&', (size_t)(end - p));
+		if (!amp) amp = end;
+		const char* eq = memchr(p, '=', (size_t)(amp - p));
+		if (amp > p) {
+			const char* name_end = eq ? eq : amp;
+			const char* value = eq ? eq + 1 : amp;
+
+			wce_query_param_t* qp = &req->query_params[req->query_count];
+			qp->name = out;
+			out += wce_url_decode(out, p, (size_t)(name_end - p));
+			*out++ = '\0';
+			qp->value = out;
+			out += wce_url_decode(out, value, (size_t)(amp - value));
+			*out++ = '\0';
+			qp->hash = wce_query_hash(qp->name);
+
+			unsigned slot = qp->hash & (WCE_QUERY_SLOTS - 1);
+			int duplicate = 0;
+			while (req->query_index[slot]) {
+				const wce_query_param_t* other = &req->query_params[req->query_index[slot] - 1];
+				if (other->hash == qp->hash && strcmp(other->name, qp->name) == 0) { duplicate = 1; break; }
+				slot = (slot + 1) & (WCE_QUERY_SLOTS - 1);
+			}
+			if (!duplicate) req->query_index[slot] = (unsigned char)(++req->query_count);
+		}
+		p = amp + 1;
+	}
+}
+
+const char* wce_req_query(wce_request_t* req, const char* name) {
+	if (!req || !name) return NULL;
+	if (!req->query_parsed) wce_query_parse(req);
+	unsigned h = wce_query_hash(name);
+	for (unsigned slot = h & (WCE_QUERY_SLOTS - 1); req->query_index[slot]; slot = (slot + 1) & (WCE_QUERY_SLOTS - 1)) {
+		const wce_query_param_t* qp = &req->query_params[req->query_index[slot] - 1];
+		if (qp->hash == h && strcmp(qp->name, name) == 0) return qp->value;
+	}
+	return NULL;
+}
+
+// --- Request Bodies ---
+// A route registered with wce_route_body() receives its body as it arrives
+// instead of after buffering: Content-Length and chunked bodies are decoded
+// incrementally and handed over one receive buffer at a time. The handler
+// runs synchronously on the server thread, so nothing more is read from the
+// connection while it works; a slow consumer fills the socket buffers and
+// TCP flow control throttles the sender. Memory per upload is the request
+// head plus one pooled receive buffer, whatever the body size.
+#define WCE_BODY_READS_PER_WAKE 4    // Receive buffers per readiness event, keeps other clients served
+
+enum {
+	WCE_CHUNK_SIZE,          // Hex digits of the chunk size
+	WCE_CHUNK_EXT,           // Rest of the size line (extensions, CRLF)
+	WCE_CHUNK_DATA,
+	WCE_CHUNK_DATA_END,      // CRLF after the chunk data
+	WCE_CHUNK_TRAILER        // Trailer lines up to the final empty line
+};
+
+// Final handler call, exactly once per body. Answers for the handler when
+// it did not respond itself.
+static void wce_body_finish(wce_request_t* req, int aborted) {
+	if (req->finished) return;
+	req->finished = 1;
+	req->aborted = aborted;
+	WCE_TRACE_BEGIN(handler);
+	req->body_handler(req, NULL, 0);
+	WCE_TRACE_END(handler, "handler");
+	if (req->stream.open) wce_stream_end(&req->stream);
+	if (!req->responded) {
+		if (aborted) wce_respond(req, 400, "text/plain", "Bad Request", 11);
+		else wce_respond(req, 204, "text/plain", NULL, 0);
+	}
+}
+
+static int wce_body_deliver(wce_request_t* req, const char* data, size_t len) {
+	req->body_total += len;
+	if (req->srv->cfg.max_body_size && req->body_total > (unsigned long long)req->srv->cfg.max_body_size) {
+		wce_respond(req, 413, "text/plain", "Payload Too Large", 17);
+		wce_body_finish(req, 1);
+		return 1;
+	}
+	WCE_TRACE_BEGIN(handler);
+	int rc = req->body_handler(req, data, len);
+	WCE_TRACE_END(handler, "handler");
+	if (rc != 0) wce_body_finish(req, 1);
+	return rc;
+}
+
+// Validates the framing headers and prepares the decoder. Returns 0 when
+// the body can be streamed; otherwise the request has been answered.
+static int wce_body_begin(wce_request_t* req, wce_body_handler_t handler) {
+	req->body_handler = handler;
+	const char* te = wce_req_header(req, "Transfer-Encoding");
+	const char* cl = wce_req_header(req, "Content-Length");
+	if (te) {
+		if (strlen(te) != 7 || !wce_ascii_ieq(te, "chunked", 7)) {
+			wce_respond(req, 501, "text/plain", "Unsupported Transfer-Encoding", 29);
+			return -1;
+		}
+		req->chunked = 1;
+		req->content_length = -1;
+		req->chunk_state = WCE_CHUNK_SIZE;
+	} else if (cl) {
+		unsigned long long n = 0;
+		const char* p = cl;
+		if (!*p) p = "x";
+		for (; *p; p++) {
+			if (*p < '0' || *p > '9' || n > (1ULL << 58)) {
+				wce_respond(req, 400, "text/plain", "Bad Content-Length", 18);
+				return -1;
+			}
+			n = n * 10 + (unsigned)(*p - '0');
+		}
+		req->content_length = (long long)n;
+		req->body_left = n;
+		if (req->srv->cfg.max_body_size && req->content_length > req->srv->cfg.max_body_size) {
+			wce_respond(req, 413, "text/plain", "Payload Too Large", 17);
+			return -1;
+		}
+	}
+
+	const char* expect = req->h2 ? NULL : wce_req_header(req, "Expect");
+	if (expect && strlen(expect) == 12 && wce_ascii_ieq(expect, "100-continue", 12)) {
+		wce_conn_send(req->srv, req->conn, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+	}
+	return 0;
+}
+
+// Feeds received bytes through the decoder. Returns 1 once the body has
+// ended (or failed) and the final handler call has been made.
+static int wce_body_feed(wce_request_t* req, const char* data, size_t len) {
+	if (req->finished) return 1;
+	if (!req->chunked) {
+		size_t take = len < req->body_left ? len : (size_t)req->body_left;
+		if (take && wce_body_deliver(req, data, take) != 0) return 1;
+		req->body_left -= take;
+		if (!req->body_left) {
+			wce_body_finish(req, 0);
+			return 1;
+		}
+		return 0;
+	}
+
+	size_t i = 0;
+	while (i < len) {
+		char ch = data[i];
+		switch (req->chunk_state) {
+			case WCE_CHUNK_SIZE: {
+				int d = wce_hex_value(ch);
+				if (d >= 0 && req->chunk_digits < 15) {
+					req->body_left = req->body_left * 16 + (unsigned)d;
+					req->chunk_digits++;
+					i++;
+				} else if (d < 0 && req->chunk_digits) {
+					req->chunk_state = WCE_CHUNK_EXT;
+				} else {
+					wce_body_finish(req, 1);
+					return 1;
+				}
+				break;
+			}
+			case WCE_CHUNK_EXT:
+				i++;
+				if (ch == '\n') {
+					req->chunk_digits = 0;
+					req->chunk_line = 0;
+					req->chunk_state = req->body_left ? WCE_CHUNK_DATA : WCE_CHUNK_TRAILER;
+				}
+				break;
+			case WCE_CHUNK_DATA: {
+				size_t take = len - i < req->body_left ? len - i : (size_t)req->body_left;
+				if (wce_body_deliver(req, data + i, take) != 0) return 1;
+				i += take;
+				req->body_left -= take;
+				if (!req->body_left) req->chunk_state = WCE_CHUNK_DATA_END;
+				break;
+			}
+			case WCE_CHUNK_DATA_END:
+				i++;
+				if (ch == '\n') {
+					req->chunk_state = WCE_CHUNK_SIZE;
+				} else if (ch != '\r') {
+					wce_body_finish(req, 1);
+					return 1;
+				}
+				break;
+			case WCE_CHUNK_TRAILER:
+				i++;
+				if (ch == '\n') {
+					if (!req->chunk_line) {
+						wce_body_finish(req, 0);
+						return 1;
+					}
+					req->chunk_line = 0;
+				} else if (ch != '\r') {
+					req->chunk_line++;
+				}
+				break;
+		}
+	}
+	return 0;
+}
+
+// Drops a streaming request. A body cut short by a disconnect or shutdown
+// still gets its final handler call, with nothing sent back.
+static void wce_body_release(wce_request_t* req) {
+	if (!req) return;
+	if (!req->finished) {
+		req->responded = 1;
+		wce_body_finish(req, 1);
+	}
+	wce_buf_free(req->body_buf);
+	wce_buf_free(req->scratch);
+	free(req);
+}
+
+long long wce_req_content_length(wce_request_t* req) { return req ? req->content_length : 0; }
+
+int wce_req_aborted(wce_request_t* req) { return req ? req->aborted : 0; }
+
+void wce_req_set_user(wce_request_t* req, void* user) { if (req) req->user = user; }
+
+void* wce_req_user(wce_request_t* req) { return req ? req->user : NULL; }
+
+int wce_write_all(int fd, const void* data, size_t len) {
+	const char* p = (const char*)data;
+	while (len > 0) {
+#ifdef _WIN32
+		int n = _write(fd, p, len > 0x40000000 ? 0x40000000u : (unsigned)len);
+#else
+		ssize_t n = write(fd, p, len);
+		if (n < 0 && errno == EINTR) continue;
+#endif
+		if (n <= 0) return -1;
+		p += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+// --- Route Table ---
+// Routes form a trie of path segments. Literal edges live in one hash table
+// keyed by (parent node, segment), so matching costs one probe per segment
+// no matter how many routes are registered. A ":name" segment becomes the
+// node's parameter child and is tried when no literal edge matches.
+enum {
+	WCE_METHOD_GET, WCE_METHOD_HEAD, WCE_METHOD_POST, WCE_METHOD_PUT,
+	WCE_METHOD_PATCH, WCE_METHOD_DELETE, WCE_METHOD_OPTIONS, WCE_METHOD_ANY,
+	WCE_METHOD_COUNT
+};
+
+static const char* wce_method_names[WCE_METHOD_ANY] = {
+	"GET", "HEAD", "POST", "PUT", "PATCH", "DELETE", "OPTIONS"
+};
+
+#define WCE_MAX_PATH_SEGMENTS 32
+
+typedef struct wce_route_node {
+	int param_child;         // Node index of the ":name" child, or -1
+	char* param_name;        // Set on parameter nodes
+	wce_route_handler_t handlers[WCE_METHOD_COUNT];
+	wce_body_handler_t body_handlers[WCE_METHOD_COUNT];
+} wce_route_node_t;
+
+typedef struct wce_route_edge {
+	int parent;              // -1 marks an empty slot
+	int child;
+	unsigned hash;
+	int seg_len;
+	char* segment;
+} wce_route_edge_t;
+
+static unsigned wce_route_hash(int parent, const char* seg, int len) {
+	unsigned h = 2166136261u ^ (unsigned)parent * 16777619u;
+	for (int i = 0; i < len; i++) {
+		h ^= (unsigned char)seg[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static int wce_route_method_index(const char* method) {
+	if (!method || strcmp(method, "*") == 0) return WCE_METHOD_ANY;
+	for (int i = 0; i < WCE_METHOD_ANY; i++) {
+		if (strcmp(wce_method_names[i], method) == 0) return i;
+	}
+	return -1;
+}
+
+static int wce_route_node_new(wce_server_t* srv) {
+	if (srv->route_node_count == srv->route_node_cap) {
+		int new_cap = srv->route_node_cap ? srv->route_node_cap * 2 : 16;
+		wce_route_node_t* grown = (wce_route_node_t*)realloc(srv->route_nodes, sizeof(wce_route_node_t) * (size_t)new_cap);
+		if (!grown) return -1;
+		srv->route_nodes = grown;
+		srv->route_node_cap = new_cap;
+	}
+	wce_route_node_t* n = &srv->route_nodes[srv->route_node_count];
+	memset(n, 0, sizeof(*n));
+	n->param_child = -1;
+	return srv->route_node_count++;
+}
+
+static int wce_route_edge_find(wce_server_t* srv, int parent, const char* seg, int len) {
+	if (!srv->route_edge_cap) return -1;
+	unsigned h = wce_route_hash(parent, seg, len);
+	for (int i = (int)(h & (unsigned)(srv->route_edge_cap - 1)); ; i = (i + 1) & (srv->route_edge_cap - 1)) {
+		wce_route_edge_t* e = &srv->route_edges[i];
+		if (e->parent < 0) return -1;
+		if (e->hash == h && e->parent == parent && e->seg_len == len && memcmp(e->segment, seg, (size_t)len) == 0) {
+			return e->child;
+		}
+	}
+}
+
+static int wce_route_edge_insert(wce_server_t* srv, int parent, char* seg, int len, int child) {
+	if ((srv->route_edge_count + 1) * 2 > srv->route_edge_cap) {
+		int new_cap = srv->route_edge_cap ? srv->route_edge_cap * 2 : 64;
+		wce_route_edge_t* grown = (wce_route_edge_t*)malloc(sizeof(wce_route_edge_t) * (size_t)new_cap);
+		if (!grown) return -1;
+		for (int i = 0; i < new_cap; i++) grown[i].parent = -1;
+		for (int i = 0; i < srv->route_edge_cap; i++) {
+			wce_route_edge_t* e = &srv->route_edges[i];
+			if (e->parent < 0) continue;
+			int j = (int)(e->hash & (unsigned)(new_cap - 1));
+			while (grown[j].parent >= 0) j = (j + 1) & (new_cap - 1);
+			grown[j] = *e;
+		}
+		free(srv->route_edges);
+		srv->route_edges = grown;
+		srv->route_edge_cap = new_cap;
+	}
+	unsigned h = wce_route_hash(parent, seg, len);
+	int i = (int)(h & (unsigned)(srv->route_edge_cap - 1));
+	while (srv->route_edges[i].parent >= 0) i = (i + 1) & (srv->route_edge_cap - 1);
+	srv->route_edges[i].parent = parent;
+	srv->route_edges[i].child = child;
+	srv->route_edges[i].hash = h;
+	srv->route_edges[i].seg_len = len;
+	srv->route_edges[i].segment = seg;
+	srv->route_edge_count++;
+	return 0;
+}
+
+// Splits a path into (pointer, length) segments; empty segments are skipped.
+static int wce_path_split(const char* path, const char** segs, int* lens, int max) {
+	int n = 0;
+	const char* p = path;
+	while (*p) {
+		while (*p == '/') p++;
+		if (!*p) break;
+		const char* start = p;
+		while (*p && *p != '/') p++;
+		if (n == max) return -1;
+		segs[n] = start;
+		lens[n] = (int)(p - start);
+		n++;
+	}
+	return n;
+}
+
+// Walks the trie along `pattern`, creating missing nodes; returns the node.
+static int wce_route_node_for(wce_server_t* srv, const char* pattern) {
+	if (!pattern || pattern[0] != '/') return -1;
+	if (!srv->route_node_count && wce_route_node_new(srv) != 0) return -1;
+
+	const char* segs[WCE_MAX_PATH_SEGMENTS];
+	int lens[WCE_MAX_PATH_SEGMENTS];
+	int n = wce_path_split(pattern, segs, lens, WCE_MAX_PATH_SEGMENTS);
+	if (n < 0) return -1;
+
+	int node = 0;
+	for (int i = 0; i < n; i++) {
+		int child;
+		if (segs[i][0] == ':') {
+			child = srv->route_nodes[node].param_child;
+			if (child < 0) {
+				child = wce_route_node_new(srv);
+				if (child < 0) return -1;
+				srv->route_nodes[child].param_name = (char*)malloc((size_t)lens[i]);
+				if (!srv->route_nodes[child].param_name) return -1;
+				memcpy(srv->route_nodes[child].param_name, segs[i] + 1, (size_t)lens[i] - 1);
+				srv->route_nodes[child].param_name[lens[i] - 1] = '\0';
+				srv->route_nodes[node].param_child = child;
+			}
+		} else {
+			child = wce_route_edge_find(srv, node, segs[i], lens[i]);
+			if (child < 0) {
+				char* seg = (char*)malloc((size_t)lens[i] + 1);
+				if (!seg) return -1;
+				memcpy(seg, segs[i], (size_t)lens[i]);
+				seg[lens[i]] = '\0';
+				child = wce_route_node_new(srv);
+				if (child < 0 || wce_route_edge_insert(srv, node, seg, lens[i], child) != 0) { free(seg); return -1; }
+			}
+		}
+		node = child;
+	}
+	return node;
+}
+
+// A method slot holds either a plain handler or a body handler.
+static int wce_route_add(wce_server_t* srv, const char* method, const char* pattern, wce_route_handler_t handler, int replace) {
+	int m = wce_route_method_index(method);
+	if (m < 0 || !handler) return -1;
+	int node = wce_route_node_for(srv, pattern);
+	if (node < 0) return -1;
+	wce_route_node_t* n = &srv->route_nodes[node];
+	if ((n->handlers[m] || n->body_handlers[m]) && !replace) return 0;
+	n->handlers[m] = handler;
+	n->body_handlers[m] = NULL;
+	return 0;
+}
+
+// Depth-first match preferring literal edges. Parameter values are recorded
+// as pointers to their segment start; the caller terminates them.
+static int wce_route_match(wce_server_t* srv, int node, const char** segs, int* lens, int i, int n, wce_request_t* req) {
+	if (i == n) {
+		for (int m = 0; m < WCE_METHOD_COUNT; m++) {
+			if (srv->route_nodes[node].handlers[m] || srv->route_nodes[node].body_handlers[m]) return node;
+		}
+		return -1;
+	}
+	int child = wce_route_edge_find(srv, node, segs[i], lens[i]);
+	if (child >= 0) {
+		int found = wce_route_match(srv, child, segs, lens, i + 1, n, req);
+		if (found >= 0) return found;
+	}
+	child = srv->route_nodes[node].param_child;
+	if (child >= 0 && req->param_count < WCE_MAX_PATH_PARAMS) {
+		int slot = req->param_count++;
+		req->param_names[slot] = srv->route_nodes[child].param_name;
+		req->param_values[slot] = (char*)segs[i];
+		int found = wce_route_match(srv, child, segs, lens, i + 1, n, req);
+		if (found >= 0) return found;
+		req->param_count--;
+	}
+	return -1;
+}
+
+int wce_server_route(wce_server_t* srv, const char* method, const char* pattern, wce_route_handler_t handler) {
+	return wce_route_add(srv, method, pattern, handler, 1);
+}
+
+int wce_route(const char* method, const char* pattern, wce_route_handler_t handler) {
+	return wce_server_route(wce_self(), method, pattern, handler);
+}
+
+int wce_server_route_body(wce_server_t* srv, const char* method, const char* pattern, wce_body_handler_t handler) {
+	int m = wce_route_method_index(method);
+	if (m < 0 || !handler) return -1;
+	int node = wce_route_node_for(srv, pattern);
+	if (node < 0) return -1;
+	srv->route_nodes[node].handlers[m] = NULL;
+	srv->route_nodes[node].body_handlers[m] = handler;
+	return 0;
+}
+
+int wce_route_body(const char* method, const char* pattern, wce_body_handler_t handler) {
+	return wce_server_route_body(wce_self(), method, pattern, handler);
+}
+
+// --- CBOR ---
+// Binary form of the store (RFC 8949): one map of text keys to values. A
+// value that is a canonical integer within JavaScript's exact range goes out
+// as a CBOR integer (1-9 bytes), everything else as a text string, so the
+// client's String(value) gives back exactly the stored text. No escaping is
+// needed; the exact size is computed first and the map written in one pass.
+// /api/patch answers in CBOR too, streamed with wce_stream_cbor_*().
+#define WCE_CBOR_UINT 0
+#define WCE_CBOR_NINT 1
+#define WCE_CBOR_TEXT 3
+#define WCE_CBOR_ARRAY 4
+#define WCE_CBOR_MAP  5
+#define WCE_CBOR_INT_MAX 9007199254740991ULL // 2^53 - 1
+
+static size_t wce_cbor_head_size(uint64_t v) {
+	return v < 24 ? 1 : v <= 0xFF ? 2 : v <= 0xFFFF ? 3 : v <= 0xFFFFFFFFULL ? 5 : 9;
+}
+
+static unsigned char* wce_cbor_head(unsigned char* p, int major, uint64_t v) {
+	static const unsigned char info[] = { 0, 0, 24, 25, 0, 26, 0, 0, 0, 27 }; // By head size
+	size_t n = wce_cbor_head_size(v);
+	*p++ = (unsigned char)((major << 5) | (n == 1 ? (int)v : info[n]));
+	for (int shift = (int)(n - 2) * 8; shift >= 0; shift -= 8) *p++ = (unsigned char)(v >> shift);
+	return p;
+}
+
+// Parses `s` as a canonical decimal integer ("0", "42", "-7"; no sign on
+// zero, no leading zeros). Sets the CBOR major type and argument.
+static int wce_cbor_int(const char* s, int* major, uint64_t* arg) {
+	int neg = *s == '-';
+	const char* p = s + neg;
+	if (*p < '0' || *p > '9' || (*p == '0' && (p[1] || neg))) return 0;
+	uint64_t v = 0;
+	for (; *p; p++) {
+		if (*p < '0' || *p > '9') return 0;
+		v = v * 10 + (uint64_t)(*p - '0');
+		if (v > WCE_CBOR_INT_MAX) return 0;
+	}
+	*major = neg ? WCE_CBOR_NINT : WCE_CBOR_UINT;
+	*arg = neg ? v - 1 : v;
+	return 1;
+}
+
+char* wce_server_data_cbor(wce_server_t* srv, size_t* out_len) {
+	WCE_TRACE_BEGIN(cbor);
+	int major;
+	uint64_t arg;
+	wce_mutex_lock(&srv->kv_lock);
+	size_t size = wce_cbor_head_size((uint64_t)srv->kv_count);
+	for (int i = 0; i < srv->kv_count; i++) {
+		size_t key_len = strlen(srv->kv_store[i].key);
+		size += wce_cbor_head_size(key_len) + key_len;
+		if (wce_cbor_int(srv->kv_store[i].value, &major, &arg)) {
+			size += wce_cbor_head_size(arg);
+		} else {
+			size_t val_len = strlen(srv->kv_store[i].value);
+			size += wce_cbor_head_size(val_len) + val_len;
+		}
+	}
+
+	unsigned char* buf = (unsigned char*)malloc(size ? size : 1);
+	if (!buf) {
+		wce_mutex_unlock(&srv->kv_lock);
+		return NULL;
+	}
+	unsigned char* p = wce_cbor_head(buf, WCE_CBOR_MAP, (uint64_t)srv->kv_count);
+	for (int i = 0; i < srv->kv_count; i++) {
+		size_t key_len = strlen(srv->kv_store[i].key);
+		p = wce_cbor_head(p, WCE_CBOR_TEXT, key_len);
+		memcpy(p, srv->kv_store[i].key, key_len);
+		p += key_len;
+		if (wce_cbor_int(srv->kv_store[i].value, &major, &arg)) {
+			p = wce_cbor_head(p, major, arg);
+		} else {
+			size_t val_len = strlen(srv->kv_store[i].value);
+			p = wce_cbor_head(p, WCE_CBOR_TEXT, val_len);
+			memcpy(p, srv->kv_store[i].value, val_len);
+			p += val_len;
+		}
+	}
+	wce_mutex_unlock(&srv->kv_lock);
+
+	if (out_len) *out_len = (size_t)(p - buf);
+	WCE_TRACE_END(cbor, "cbor");
+	return (char*)buf;
+}
+
+char* wce_data_cbor(size_t* out_len) {
+	return wce_server_data_cbor(wce_self(), out_len);
+}
+
+static int wce_stream_cbor_head(wce_stream_t* s, int major, uint64_t v) {
+	char* p = wce_stream_reserve(s, 9);
+	if (!p) return -1;
+	wce_stream_commit(s, (char*)wce_cbor_head((unsigned char*)p, major, v));
+	return 0;
+}
+
+// Writes `str` (at most max_len bytes, stopping at NUL) as a text string.
+// NULL becomes null.
+static int wce_stream_cbor_text(wce_stream_t* s, const char* str, size_t max_len) {
+	if (!str) return wce_stream_write(s, "\xF6", 1); // Simple value null
+	size_t len = 0;
+	while (len < max_len && str[len]) len++;
+	if (wce_stream_cbor_head(s, WCE_CBOR_TEXT, len) != 0) return -1;
+	return wce_stream_write(s, str, len);
+}
+
+// --- Data Snapshots ---
+// Every open page polls /api/data, and between two updates they all get the
+// same bytes. The serialized store is cached as a snapshot tagged with the
+// store version and rebuilt only once wce_data_set() has changed something,
+// so serialization follows the update rate rather than the client count.
+// Responses send straight from the snapshot and hold a reference meanwhile;
+// a rebuild replaces the cached one without pulling bytes from under them.
+// JSON and CBOR (see "CBOR") are cached side by side.
+enum { WCE_DATA_JSON, WCE_DATA_CBOR };
+
+typedef struct wce_snapshot {
+	int refs;                // One for the server's cache, one per response sending it
+	unsigned version;        // kv_version it was serialized at
+	size_t len;
+	char* bytes;
+	char etag[24];           // Rendered HTML only, see "Page" and "Fragments"
+} wce_snapshot_t;
+
+static void wce_snapshot_release(wce_snapshot_t* snap) {
+	if (snap && --snap->refs == 0) {
+		free(snap->bytes);
+		free(snap);
+	}
+}
+
+// Returns a referenced snapshot of the current store, or NULL when out of memory.
+static wce_snapshot_t* wce_snapshot_acquire(wce_server_t* srv, int format) {
+	wce_snapshot_t* snap = srv->data_snapshot[format];
+	// Read first: a change while serializing forces a rebuild. The
+	// serializers take kv_lock themselves, so it is not held across them.
+	wce_mutex_lock(&srv->kv_lock);
+	unsigned version = srv->kv_version;
+	wce_mutex_unlock(&srv->kv_lock);
+	if (!snap || snap->version != version) {
+		snap = (wce_snapshot_t*)malloc(sizeof(wce_snapshot_t));
+		if (!snap) return NULL;
+		snap->bytes = format == WCE_DATA_CBOR ? wce_server_data_cbor(srv, &snap->len) : wce_server_data_json(srv, &snap->len);
+		if (!snap->bytes) {
+			free(snap);
+			return NULL;
+		}
+		snap->refs = 1;
+		snap->version = version;
+		wce_snapshot_release(srv->data_snapshot[format]);
+		srv->data_snapshot[format] = snap;
+	}
+	snap->refs++;
+	return snap;
+}
+
+// --- Page ---
+// "/" is the same document for every client until the UI tree changes.
+// wce_tool pre-renders layouts that have no runtime logic into a constant
+// with its ETag (wce_register_page), which is served as is. Otherwise the
+// tree is rendered on the first request and the bytes are cached as a
+// snapshot of the current ui_version. Both carry an ETag (FNV-1a over the
+// page, the same hash wce_tool uses), so a reload costs a 304.
+
+void wce_server_register_page(wce_server_t* srv, const char* html, size_t len, const char* etag) {
+	if (!html || !etag || strlen(etag) >= sizeof(srv->page_etag)) {
+		srv->page_html = NULL;
+		return;
+	}
+	srv->page_html = html;
+	srv->page_len = len;
+	strcpy(srv->page_etag, etag);
+	srv->page_version = srv->ui_version;
+}
+
+void wce_register_page(const char* html, size_t len, const char* etag) {
+	wce_server_register_page(wce_self(), html, len, etag);
+}
+
+// Takes rendered HTML (freed on failure) into a snapshot of `version`.
+static wce_snapshot_t* wce_html_snapshot(char* html, size_t len, unsigned version) {
+	wce_snapshot_t* snap = html ? (wce_snapshot_t*)malloc(sizeof(wce_snapshot_t)) : NULL;
+	if (!snap) {
+		free(html);
+		return NULL;
+	}
+	unsigned long long h = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)html[i]) * 1099511628211ULL;
+	snprintf(snap->etag, sizeof(snap->etag), "\"wce-%016llx\"", h);
+	snap->bytes = html;
+	snap->len = len;
+	snap->refs = 1;
+	snap->version = version;
+	return snap;
+}
+
+static wce_snapshot_t* wce_page_acquire(wce_server_t* srv) {
+	wce_snapshot_t* snap = srv->page_render;
+	unsigned version = srv->ui_version;
+	if (!snap || snap->version != version) {
+		size_t len = 0;
+		char* html = wce_render_page(srv, &len);
+		snap = wce_html_snapshot(html, len, version);
+		if (!snap) return NULL;
+		wce_snapshot_release(srv->page_render);
+		srv->page_render = snap;
+	}
+	snap->refs++;
+	return snap;
+}
+
+// Always revalidated (no-cache), answered with 304 while the ETag matches.
+static void wce_page_serve(wce_request_t* req) {
+	wce_server_t* srv = req->srv;
+	wce_snapshot_t* snap = NULL;
+	const char* html = srv->page_html;
+	size_t len = srv->page_len;
+	const char* etag = srv->page_etag;
+	// The constant carries no wce-seq mark, so it also stops once patched
+	if (!html || srv->page_version != srv->ui_version || srv->patch_seq) {
+		snap = wce_page_acquire(srv);
+		if (!snap) {
+			wce_respond(req, 500, "text/plain", "Out of memory", 13);
+			return;
+		}
+		html = snap->bytes;
+		len = snap->len;
+		etag = snap->etag;
+	}
+	wce_resp_headers_t extra = { etag, "no-cache", NULL, NULL, NULL };
+	const char* match = wce_req_header(req, "If-None-Match");
+	if (match && strstr(match, etag)) wce_respond_with(req, 304, "text/html", NULL, 0, &extra);
+	else wce_respond_with(req, 200, "text/html", html, len, &extra);
+	wce_snapshot_release(snap);
+}
+
+// --- UI Patches ---
+// wce_node_*() change named parts of the tree (wce_id()) while pages are
+// open. Each change is logged once, already rendered, under a sequence
+// number; /api/data reports the newest in X-Wce-Patch, and a page behind it
+// fetches what it lacks from /api/patch?since=N and applies it to its DOM
+// instead of reloading. A later change of the same kind to the same node
+// supersedes the logged one, and a removal supersedes everything inside the
+// removed subtree. Pages the bounded log can no longer bring up to date, or
+// rendered before wce_ui_reset(), are told to reload.
+
+#define WCE_PATCH_MAX_OPS 256
+#define WCE_PATCH_MAX_BYTES (256 * 1024) // Rendered HTML held by inserts
+
+enum { WCE_PATCH_LABEL, WCE_PATCH_STYLE, WCE_PATCH_SHOW, WCE_PATCH_INSERT, WCE_PATCH_REMOVE };
+static const char* const wce_patch_names[] = { "label", "style", "show", "insert", "remove" };
+
+typedef struct wce_patch {
+	unsigned seq;
+	int kind;
+	int flag;                // show: visible
+	int dead;                // Superseded by a later entry
+	const WceNode* node;     // Changed node (the inserted one for inserts)
+	const char* id;          // Interned; the parent for inserts
+	const char* before;      // insert: interned sibling id, NULL to append
+	const char* text;        // label/style: interned, NULL removes the style
+	char* html;              // insert: rendered subtree, owned
+	size_t html_len;
+} wce_patch_t;
+
+static void wce_patch_clear(wce_server_t* srv) {
+	for (int i = 0; i < srv->patch_count; i++) free(srv->patches[i].html);
+	free(srv->patches);
+	srv->patches = NULL;
+	srv->patch_count = 0;
+	srv->patch_cap = 0;
+	srv->patch_bytes = 0;
+	// Pages holding patches describe a tree that is gone
+	if (srv->patch_seq) srv->patch_floor = ++srv->patch_seq;
+}
+
+// Makes room for one entry of `bytes`: superseded entries go first, then
+// the oldest, which raises the floor past them.
+static wce_patch_t* wce_patch_push(wce_server_t* srv, int kind, const WceNode* node, const char* id, size_t bytes) {
+	if (srv->patch_count >= WCE_PATCH_MAX_OPS || srv->patch_bytes + bytes > WCE_PATCH_MAX_BYTES) {
+		int n = 0;
+		for (int i = 0; i < srv->patch_count; i++) {
+			if (srv->patches[i].dead) {
+				srv->patch_bytes -= srv->patches[i].html_len;
+				free(srv->patches[i].html);
+			} else {
+				srv->patches[n++] = srv->patches[i];
+			}
+		}
+		srv->patch_count = n;
+		int drop = 0;
+		while (drop < n && (n - drop >= WCE_PATCH_MAX_OPS || srv->patch_bytes + bytes > WCE_PATCH_MAX_BYTES)) {
+			srv->patch_bytes -= srv->patches[drop].html_len;
+			free(srv->patches[drop].html);
+			srv->patch_floor = srv->patches[drop].seq;
+			drop++;
+		}
+		if (drop) {
+			memmove(srv->patches, srv->patches + drop, (size_t)(n - drop) * sizeof(wce_patch_t));
+			srv->patch_count = n - drop;
+		}
+	}
+	if (srv->patch_count == srv->patch_cap) {
+		int cap = srv->patch_cap ? srv->patch_cap * 2 : 16;
+		wce_patch_t* grown = (wce_patch_t*)realloc(srv->patches, (size_t)cap * sizeof(wce_patch_t));
+		if (!grown) return NULL;
+		srv->patches = grown;
+		srv->patch_cap = cap;
+	}
+	// Superseded by this one; inserts and removals are never replaced
+	if (kind < WCE_PATCH_INSERT) {
+		for (int i = 0; i < srv->patch_count; i++) {
+			wce_patch_t* old = &srv->patches[i];
+			if (old->kind == kind && old->node == node) old->dead = 1;
+		}
+	}
+	wce_patch_t* p = &srv->patches[srv->patch_count++];
+	memset(p, 0, sizeof(*p));
+	p->seq = ++srv->patch_seq;
+	p->kind = kind;
+	p->node = node;
+	p->id = id;
+	srv->ui_version++;
+	return p;
+}
+
+int wce_server_node_set_label(wce_server_t* srv, const char* id, const char* label) {
+	WceNode* node = wce_ui_find(srv, id);
+	if (!node || !label) return -1;
+	if (node->type != WCE_NODE_TEXT && node->type != WCE_NODE_BUTTON && node->type != WCE_NODE_INPUT) return -1;
+	if (node->label && strcmp(node->label, label) == 0) return 0;
+	char* text = wce_ui_intern(srv, label, strlen(label));
+	if (!text) return -1;
+	wce_patch_t* p = wce_patch_push(srv, WCE_PATCH_LABEL, node, node->id, 0);
+	if (!p) return -1;
+	node->label = text;
+	p->text = text;
+	return 0;
+}
+
+int wce_server_node_set_style(wce_server_t* srv, const char* id, const char* style) {
+	WceNode* node = wce_ui_find(srv, id);
+	if (!node) return -1;
+	if (!style && !node->style) return 0;
+	if (style && node->style && strcmp(node->style, style) == 0) return 0;
+	char* text = style ? wce_ui_intern(srv, style, strlen(style)) : NULL;
+	if (style && !text) return -1;
+	wce_patch_t* p = wce_patch_push(srv, WCE_PATCH_STYLE, node, node->id, 0);
+	if (!p) return -1;
+	node->style = text;
+	p->text = text;
+	return 0;
+}
+
+int wce_server_node_set_visible(wce_server_t* srv, const char* id, int visible) {
+	WceNode* node = wce_ui_find(srv, id);
+	if (!node) return -1;
+	if (!node->hidden == !!visible) return 0;
+	wce_patch_t* p = wce_patch_push(srv, WCE_PATCH_SHOW, node, node->id, 0);
+	if (!p) return -1;
+	node->hidden = !visible;
+	p->flag = !!visible;
+	return 0;
+}
+
+static int wce_node_is_container(const WceNode* node) {
+	return node->type == WCE_NODE_ROOT || node->type == WCE_NODE_CONTAINER || node->type == WCE_NODE_ROW ||
+		node->type == WCE_NODE_COL || node->type == WCE_NODE_CARD || node->type == WCE_NODE_PANEL;
+}
+
+// The builder runs under a scratch node on this server, with the usual
+// wce_*() calls; what it adds at the top level is spliced in before
+// `before_id` (appended when NULL), one entry each.
+int wce_server_node_insert(wce_server_t* srv, const char* parent_id, const char* before_id, void (*build)(void)) {
+	WceNode* parent = wce_ui_find(srv, parent_id);
+	WceNode* before = before_id ? wce_ui_find(srv, before_id) : NULL;
+	if (!parent || !build || !wce_node_is_container(parent)) return -1;
+	if (before_id && (!before || before->parent != parent)) return -1;
+
+	wce_server_t* prev = wce_server_use(srv);
+	int top = srv->ui_top;
+	WceNode* last = srv->ui_last;
+	WceNode* root = srv->ui_root;
+	WceNode* scratch = _wce_node_create(WCE_NODE_CONTAINER);
+	if (scratch) {
+		_wce_push_context(scratch);
+		build();
+	}
+	srv->ui_top = top;
+	srv->ui_last = last;
+	srv->ui_root = root;
+	wce_server_use(prev);
+	if (!scratch) return -1;
+
+	int rc = 0;
+	WceNode* child = scratch->first_child;
+	while (child) {
+		WceNode* next = child->next_sibling;
+		child->parent = parent;
+		child->next_sibling = before;
+		if (before) {
+			WceNode** link = &parent->first_child;
+			while (*link != before) link = &(*link)->next_sibling;
+			*link = child;
+		} else {
+			if (parent->last_child) parent->last_child->next_sibling = child;
+			else parent->first_child = child;
+			parent->last_child = child;
+		}
+		size_t len = 0;
+		char* html = wce_render_subtree(child, &len);
+		wce_patch_t* p = html ? wce_patch_push(srv, WCE_PATCH_INSERT, child, parent->id, len) : NULL;
+		if (p) {
+			p->before = before ? before->id : NULL;
+			p->html = html;
+			p->html_len = len;
+			srv->patch_bytes += len;
+		} else {
+			// Pages cannot follow a change that was not logged
+			free(html);
+			wce_patch_clear(srv);
+			rc = -1;
+		}
+		child = next;
+	}
+	scratch->first_child = scratch->last_child = NULL;
+	scratch->next_sibling = srv->ui_free;
+	srv->ui_free = scratch;
+	return rc;
+}
+
+// The subtree's nodes are recycled by later builders, and its names freed.
+int wce_server_node_remove(wce_server_t* srv, const char* id) {
+	WceNode* node = wce_ui_find(srv, id);
+	if (!node || node == srv->ui_root || !node->parent) return -1;
+	const char* name = node->id;
+	for (int i = 0; i < srv->patch_count; i++) {
+		wce_patch_t* p = &srv->patches[i];
+		for (const WceNode* n = p->node; n && !p->dead; n = n->parent) {
+			if (n == node) p->dead = 1;
+		}
+	}
+	if (!wce_patch_push(srv, WCE_PATCH_REMOVE, NULL, name, 0)) wce_patch_clear(srv);
+
+	WceNode* parent = node->parent;
+	WceNode** link = &parent->first_child;
+	WceNode* prev = NULL;
+	while (*link != node) {
+		prev = *link;
+		link = &(*link)->next_sibling;
+	}
+	*link = node->next_sibling;
+	if (parent->last_child == node) parent->last_child = prev;
+	srv->ui_version++;
+
+	// Walks the subtree in document order, unlinking each node after leaving it
+	WceNode* n = node;
+	for (;;) {
+		if (n->first_child) {
+			n = n->first_child;
+			continue;
+		}
+		for (;;) {
+			WceNode* up = n->parent;
+			WceNode* next = n->next_sibling;
+			if (n->id) {
+				wce_ui_id_t* e = wce_ui_id_slot(srv, n->id);
+				if (e && e->node == n) {
+					e->node = NULL;
+					wce_snapshot_release(e->fragment);
+					e->fragment = NULL;
+				}
+			}
+			if (srv->ui_last == n) srv->ui_last = NULL;
+			n->next_sibling = srv->ui_free;
+			srv->ui_free = n;
+			if (n == node) return 0;
+			if (next) {
+				n = next;
+				break;
+			}
+			n = up;
+			n->first_child = NULL;
+		}
+	}
+}
+
+int wce_node_set_label(const char* id, const char* label) {
+	return wce_server_node_set_label(wce_self(), id, label);
+}
+
+int wce_node_set_style(const char* id, const char* style) {
+	return wce_server_node_set_style(wce_self(), id, style);
+}
+
+int wce_node_set_visible(const char* id, int visible) {
+	return wce_server_node_set_visible(wce_self(), id, visible);
+}
+
+int wce_node_insert(const char* parent_id, const char* before_id, void (*build)(void)) {
+	return wce_server_node_insert(wce_self(), parent_id, before_id, build);
+}
+
+int wce_node_remove(const char* id) {
+	return wce_server_node_remove(wce_self(), id);
+}
+
+// The same message as a CBOR map, for clients that accept it
+static void api_patch_cbor(wce_request_t* req, unsigned long since) {
+	wce_server_t* srv = req->srv;
+	wce_stream_t* out = wce_stream_begin(req, 200, "application/cbor");
+	if (!out) return;
+	wce_stream_cbor_head(out, WCE_CBOR_MAP, 2);
+	wce_stream_cbor_text(out, "seq", 3);
+	wce_stream_cbor_head(out, WCE_CBOR_UINT, srv->patch_seq);
+	if (since < srv->patch_floor || since > srv->patch_seq) {
+		wce_stream_cbor_text(out, "reload", 6);
+		wce_stream_cbor_head(out, WCE_CBOR_UINT, 1);
+		wce_stream_end(out);
+		return;
+	}
+	int count = 0;
+	for (int i = 0; i < srv->patch_count; i++) {
+		if (!srv->patches[i].dead && srv->patches[i].seq > since) count++;
+	}
+	wce_stream_cbor_text(out, "ops", 3);
+	wce_stream_cbor_head(out, WCE_CBOR_ARRAY, (uint64_t)count);
+	for (int i = 0; i < srv->patch_count; i++) {
+		const wce_patch_t* p = &srv->patches[i];
+		if (p->dead || p->seq <= since) continue;
+		static const int fields[] = { 3, 3, 3, 4, 2 }; // By kind
+		wce_stream_cbor_head(out, WCE_CBOR_ARRAY, (uint64_t)fields[p->kind]);
+		wce_stream_cbor_text(out, wce_patch_names[p->kind], (size_t)-1);
+		wce_stream_cbor_text(out, p->id, (size_t)-1);
+		switch (p->kind) {
+			case WCE_PATCH_LABEL:
+			case WCE_PATCH_STYLE:
+				wce_stream_cbor_text(out, p->text, (size_t)-1);
+				break;
+			case WCE_PATCH_SHOW:
+				wce_stream_cbor_head(out, WCE_CBOR_UINT, p->flag ? 1 : 0);
+				break;
+			case WCE_PATCH_INSERT:
+				wce_stream_cbor_text(out, p->before, (size_t)-1);
+				wce_stream_cbor_text(out, p->html, p->html_len);
+				break;
+			default: break;
+		}
+	}
+	wce_stream_end(out);
+}
+
+// GET /api/patch?since=N -> {"seq":S,"ops":[...]} with the live entries
+// after N, or {"seq":S,"reload":1} when the page must be fetched again.
+// CBOR when the Accept header asks for it, like /api/data.
+static void api_patch(wce_request_t* req) {
+	wce_server_t* srv = req->srv;
+	const char* since_str = wce_req_query(req, "since");
+	unsigned long since = since_str ? strtoul(since_str, NULL, 10) : 0;
+	const char* accept = wce_req_header(req, "Accept");
+	if (accept && strstr(accept, "application/cbor")) {
+		api_patch_cbor(req, since);
+		return;
+	}
+	char head[48];
+	if (since < srv->patch_floor || since > srv->patch_seq) {
+		int n = snprintf(head, sizeof(head), "{\"seq\":%u,\"reload\":1}", srv->patch_seq);
+		wce_respond(req, 200, "application/json", head, (size_t)n);
+		return;
+	}
+	wce_stream_t* out = wce_stream_begin(req, 200, "application/json");
+	if (!out) return;
+	snprintf(head, sizeof(head), "{\"seq\":%u,\"ops\":[", srv->patch_seq);
+	wce_stream_puts(out, head);
+	int first = 1;
+	for (int i = 0; i < srv->patch_count; i++) {
+		const wce_patch_t* p = &srv->patches[i];
+		if (p->dead || p->seq <= since) continue;
+		wce_stream_puts(out, first ? "[\"" : ",[\"");
+		first = 0;
+		wce_stream_puts(out, wce_patch_names[p->kind]);
+		wce_stream_puts(out, "\",");
+		wce_stream_json_string(out, p->id, (size_t)-1);
+		switch (p->kind) {
+			case WCE_PATCH_LABEL:
+			case WCE_PATCH_STYLE:
+				wce_stream_puts(out, ",");
+				wce_stream_json_string(out, p->text, (size_t)-1);
+				break;
+			case WCE_PATCH_SHOW:
+				wce_stream_puts(out, p->flag ? ",1" : ",0");
+				break;
+			case WCE_PATCH_INSERT:
+				wce_stream_puts(out, ",");
+				wce_stream_json_string(out, p->before, (size_t)-1);
+				wce_stream_puts(out, ",");
+				wce_stream_json_string(out, p->html, p->html_len);
+				break;
+			default: break;
+		}
+		wce_stream_puts(out, "]");
+	}
+	wce_stream_puts(out, "]}");
+	wce_stream_end(out);
+}
+
+// --- Fragments ---
+// /api/fragment?node=<id> sends one named subtree, rendered like the page
+// and cached the same way: per name, until the tree changes, with an ETag
+// over the bytes. A region that came out the same after changes elsewhere
+// is therefore still answered with 304. The client's wceRefresh(id) swaps
+// the element in place, so a dashboard pays only for the region it asks for.
+
+char* wce_server_render_node(wce_server_t* srv, const char* id, size_t* out_len) {
+	WceNode* node = wce_ui_find(srv, id);
+	return node ? wce_render_subtree(node, out_len) : NULL;
+}
+
+char* wce_render_node(const char* id, size_t* out_len) {
+	return wce_server_render_node(wce_self(), id, out_len);
+}
+
+static wce_snapshot_t* wce_fragment_acquire(wce_server_t* srv, wce_ui_id_t* e) {
+	wce_snapshot_t* snap = e->fragment;
+	unsigned version = srv->ui_version;
+	if (!snap || snap->version != version) {
+		size_t len = 0;
+		char* html = wce_render_subtree(e->node, &len);
+		snap = wce_html_snapshot(html, len, version);
+		if (!snap) return NULL;
+		wce_snapshot_release(e->fragment);
+		e->fragment = snap;
+	}
+	snap->refs++;
+	return snap;
+}
+
+// Always revalidated (no-cache), answered with 304 while the ETag matches.
+static void api_fragment(wce_request_t* req) {
+	wce_server_t* srv = req->srv;
+	const char* id = wce_req_query(req, "node");
+	wce_ui_id_t* e = id ? wce_ui_id_slot(srv, id) : NULL;
+	if (!e || !e->node) {
+		wce_respond(req, 404, "text/plain", "Unknown node", 12);
+		return;
+	}
+	wce_snapshot_t* snap = wce_fragment_acquire(srv, e);
+	if (!snap) {
+		wce_respond(req, 500, "text/plain", "Out of memory", 13);
+		return;
+	}
+	// The patches the fragment reflects, so the page can catch up first
+	char seq[16];
+	wce_resp_headers_t extra = { snap->etag, "no-cache", NULL, NULL, NULL };
+	if (srv->patch_seq) {
+		snprintf(seq, sizeof(seq), "%u", srv->patch_seq);
+		extra.patch_seq = seq;
+	}
+	const char* match = wce_req_header(req, "If-None-Match");
+	if (match && strstr(match, snap->etag)) wce_respond_with(req, 304, "text/html", NULL, 0, &extra);
+	else wce_respond_with(req, 200, "text/html", snap->bytes, snap->len, &extra);
+	wce_snapshot_release(snap);
+}
+
+// --- Embedded Assets ---
+// target_add_webcee_assets() compiles a directory into a bundle: the bytes,
+// a gzip variant where it pays off, ETags and MIME types are all constants,
+// found through a perfect hash. Once a bundle is registered, static files
+// come only from it, with no filesystem access. An ETag names the content,
+// so a URL carrying it as "?v=" can be cached for good; plain URLs are
+// revalidated and answered with 304 while unchanged.
+
+// Must match asset_hash() in compiler/core/assets.c
+static uint32_t wce_asset_hash(uint32_t seed, const char* s) {
+	uint32_t h = 2166136261u ^ (seed * 0x9E3779B1u);
+	for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	return h;
+}
+
+static const wce_asset_t* wce_asset_lookup(const wce_asset_bundle_t* b, const char* path) {
+	if (!b || b->slot_count <= 0 || b->bucket_count <= 0) return NULL;
+	uint32_t bucket = wce_asset_hash(0, path) % (uint32_t)b->bucket_count;
+	const wce_asset_t* a = &b->assets[wce_asset_hash(b->disp[bucket], path) % (uint32_t)b->slot_count];
+	return (a->path && strcmp(a->path, path) == 0) ? a : NULL;
+}
+
+void wce_server_register_assets(wce_server_t* srv, const wce_asset_bundle_t* bundle) {
+	srv->assets = bundle;
+}
+
+void wce_register_assets(const wce_asset_bundle_t* bundle) {
+	wce_server_register_assets(wce_self(), bundle);
+}
+
+const wce_asset_t* wce_find_asset(const char* path) {
+	return path ? wce_asset_lookup(wce_self()->assets, path) : NULL;
+}
+
+static void wce_asset_send(wce_request_t* req, const wce_asset_t* a) {
+	const char* accept = a->gzip ? wce_req_header(req, "Accept-Encoding") : NULL;
+	int gz = accept && strstr(accept, "gzip");
+	const char* v = wce_req_query(req, "v");
+	int pinned = v && a->etag && strlen(v) == 16 && strlen(a->etag) == 22 && strncmp(a->etag + 5, v, 16) == 0;
+	wce_resp_headers_t extra = {
+		gz ? a->gzip_etag : a->etag,
+		pinned ? "public, max-age=31536000, immutable" : "no-cache",
+		gz ? "gzip" : NULL,
+		a->gzip ? "Accept-Encoding" : NULL,
+		NULL
+	};
+	const char* match = extra.etag ? wce_req_header(req, "If-None-Match") : NULL;
+	if (match && strstr(match, extra.etag)) wce_respond_with(req, 304, a->content_type, NULL, 0, &extra);
+	else if (gz) wce_respond_with(req, 200, a->content_type, (const char*)a->gzip, a->gzip_len, &extra);
+	else wce_respond_with(req, 200, a->content_type, (const char*)a->data, a->len, &extra);
+}
+
+// --- Built-in API Routes ---
+
+// API: List Data
+static void api_list(wce_request_t* req) {
+	const char* list_name = wce_req_query(req, "name");
+	if (!list_name) {
+		wce_respond(req, 400, "text/plain", "Missing name param", 18);
+		return;
+	}
+	wce_list_writer_t writer = wce_find_list(req->srv, list_name);
+	if (writer) {
+		wce_stream_t* out = wce_stream_begin(req, 200, "application/json");
+		if (out) {
+			writer(out);
+			wce_stream_end(out);
+		}
+		return;
+	}
+	char* json = wce_get_list_json(list_name);
+	wce_respond(req, 200, "application/json", json, strlen(json));
+}
+
+// API: Model Update
+static void api_update(wce_request_t* req) {
+	const char* key = wce_req_query(req, "key");
+	const char* val = wce_req_query(req, "val");
+	if (!key || !val) {
+		wce_respond(req, 400, "text/plain", "Missing params", 14);
+		return;
+	}
+
+	// Update KV store directly
+	wce_server_data_set(req->srv, key, val);
+
+	// Also call hook if needed (optional)
+	wce_handle_model_update(key, val);
+
+	wce_respond(req, 200, "text/plain", "OK", 2);
+}
+
+// API: Data Sync (CBOR for clients that accept it, JSON otherwise)
+static void api_data(wce_request_t* req) {
+	const char* accept = wce_req_header(req, "Accept");
+	int format = accept && strstr(accept, "application/cbor") ? WCE_DATA_CBOR : WCE_DATA_JSON;
+	wce_snapshot_t* snap = wce_snapshot_acquire(req->srv, format);
+	if (!snap) {
+		wce_respond(req, 500, "text/plain", "Out of memory", 13);
+		return;
+	}
+	// Tells open pages when the tree has changed since they were rendered
+	char seq[16];
+	wce_resp_headers_t extra = { NULL, NULL, NULL, NULL, NULL };
+	if (req->srv->patch_seq) {
+		snprintf(seq, sizeof(seq), "%u", req->srv->patch_seq);
+		extra.patch_seq = seq;
+	}
+	wce_respond_with(req, 200, format == WCE_DATA_CBOR ? "application/cbor" : "application/json",
+		snap->bytes, snap->len, &extra);
+	wce_snapshot_release(snap);
+}
+
+// API: Event Trigger
+static void api_trigger(wce_request_t* req) {
+	const char* event_name = wce_req_query(req, "event");
+	if (!event_name) {
+		wce_respond(req, 400, "text/plain", "Missing event param", 19);
+		return;
+	}
+	const char* arg = wce_req_query(req, "arg");
+	wce_dispatch_event(event_name, arg ? arg : "");
+	wce_respond(req, 200, "text/plain", "OK", 2);
+}
+
+#ifdef WCE_TRACE
+// Debug: Chrome / Perfetto trace of the recorded spans
+static void api_debug_trace(wce_request_t* req) {
+	size_t trace_len = 0;
+	char* trace = wce_trace_json(&trace_len);
+	wce_respond(req, 200, "application/json", trace, trace_len);
+	free(trace);
+}
+#endif
+
+// Registers the built-in API without replacing handlers the application
+// already installed for the same method and pattern.
+static void wce_routes_init(wce_server_t* srv) {
+	wce_route_add(srv, "GET", "/api/list", api_list, 0);
+	wce_route_add(srv, "POST", "/api/update", api_update, 0);
+	wce_route_add(srv, "GET", "/api/data", api_data, 0);
+	wce_route_add(srv, "GET", "/api/patch", api_patch, 0);
+	wce_route_add(srv, "GET", "/api/fragment", api_fragment, 0);
+	wce_route_add(srv, "POST", "/api/trigger", api_trigger, 0);
+#ifdef WCE_TRACE
+	wce_route_add(srv, "GET", "/debug/trace", api_debug_trace, 0);
+#endif
+}
+
+// Static assets from the embedded bundle or web_root, then the
+// runtime-rendered page.
+static void serve_static(wce_request_t* req) {
+	const char* path = req->path;
+	const char* file_path = path;
+	if (strcmp(path, "/") == 0) file_path = "/index.html";
+
+	if (req->srv->assets) {
+		const wce_asset_t* asset = wce_asset_lookup(req->srv->assets, file_path);
+		if (asset) {
+			wce_asset_send(req, asset);
+			return;
+		}
+	} else {
+		const char* search_paths[] = {
+			"web_root",
+			"./web_root",
+			"generated/web_root",
+			"../web_root",
+			"../../web_root",
+			NULL
+		};
+
+		char full_path[512];
+		char* content = NULL;
+		size_t len = 0;
+
+		for (int i = 0; search_paths[i] != NULL; i++) {
+			snprintf(full_path, sizeof(full_path), "%s%s", search_paths[i], file_path);
+			content = read_file_content(full_path, &len);
+			if (content) break;
+		}
+
+		if (content) {
+			const char* type = "text/plain";
+			if (strstr(path, ".html") || strcmp(path, "/") == 0) type = "text/html";
+			else if (strstr(path, ".css")) type = "text/css";
+			else if (strstr(path, ".js")) type = "application/javascript";
+			wce_respond(req, 200, type, content, len);
+			free(content);
+			return;
+		}
+	}
+
+	// Embedded fallback for include-only usage
+	if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0) {
+		wce_page_serve(req);
+		return;
+	}
+
+	wce_respond(req, 404, "text/plain", "Not Found", 9);
+}
+
+// Returns 1 when the route streams the request body: the caller keeps the
+// request alive and feeds it the body as it arrives.
+static int wce_route_dispatch(wce_request_t* req, int node) {
+	const wce_route_node_t* n = &req->srv->route_nodes[node];
+	int m = wce_route_method_index(req->method);
+	if (m < 0 || (!n->handlers[m] && !n->body_handlers[m])) m = WCE_METHOD_ANY;
+	wce_route_handler_t handler = n->handlers[m];
+	wce_body_handler_t body_handler = n->body_handlers[m];
+	if (!handler && !body_handler) {
+		wce_respond(req, 405, "text/plain", "Method Not Allowed", 18);
+		return 0;
+	}
+
+	// Path parameters become NUL-terminated in place; matching is done, so
+	// the segment slices of the path can be cut.
+	for (int i = 0; i < req->param_count; i++) {
+		char* v = req->param_values[i];
+		while (*v && *v != '/') v++;
+		*v = '\0';
+	}
+
+	if (body_handler) return wce_body_begin(req, body_handler) == 0;
+
+	WCE_TRACE_BEGIN(handler);
+	handler(req);
+	WCE_TRACE_END(handler, "handler");
+	if (req->stream.open) wce_stream_end(&req->stream);
+	if (!req->responded) wce_respond(req, 204, "text/plain", NULL, 0);
+	return 0;
+}
+
+// Splits the request line of `head` in place and points `req` at its parts.
+// Returns -1 for a malformed request line.
+static int wce_request_parse(wce_request_t* req, char* head, int head_len) {
+	// Request line: METHOD SP target SP version
+	char* line_end = memchr(head, '\n', (size_t)head_len);
+	if (!line_end) return -1;
+	*line_end = '\0';
+	char* method = head;
+	char* sp = strchr(method, ' ');
+	if (!sp || sp == method) return -1;
+	*sp = '\0';
+	char* path = sp + 1;
+	char* path_end = strpbrk(path, " \r");
+	if (!path_end) path_end = path + strlen(path);
+	if (path_end == path) return -1;
+	*path_end = '\0';
+
+	memset(req, 0, sizeof(*req));
+	req->method = method;
+	req->path = path;
+	req->query = "";
+	req->headers = line_end + 1;
+	req->headers_end = head + head_len;
+	char* q = strchr(path, '?');
+	if (q) {
+		*q = '\0';
+		req->query = q + 1;
+	}
+	return 0;
+}
+
+// Serves a parsed request from the route table or static files. Returns 1
+// when the route streams the request body and `req` has to stay alive.
+static int wce_request_run(wce_request_t* req) {
+	const char* segs[WCE_MAX_PATH_SEGMENTS];
+	int lens[WCE_MAX_PATH_SEGMENTS];
+	int n = wce_path_split(req->path, segs, lens, WCE_MAX_PATH_SEGMENTS);
+	int node = (n >= 0 && req->srv->route_node_count) ? wce_route_match(req->srv, 0, segs, lens, 0, n, req) : -1;
+	if (node < 0) {
+		serve_static(req);
+		return 0;
+	}
+	return wce_route_dispatch(req, node);
+}
+
+static int wce_h2_upgrade(wce_server_t* srv, int client_idx, wce_request_t* req);
+
+// Returns 1 when the connection stays open to stream the request body.
+static int process_request(wce_server_t* srv, int client_idx) {
+	wce_client_t* c = &srv->clients[client_idx];
+	wce_request_t req;
+	if (wce_request_parse(&req, c->buffer, c->head_len) != 0) return 0;
+	req.srv = srv;
+	req.fd = c->fd;
+	req.conn = client_idx;
+
+	int upgraded = wce_h2_upgrade(srv, client_idx, &req);
+	if (upgraded >= 0) return upgraded;
+
+	if (wce_request_run(&req)) {
+		c->req = (wce_request_t*)malloc(sizeof(wce_request_t));
+		if (!c->req) {
+			wce_respond(&req, 500, "text/plain", "Out of memory", 13);
+			wce_buf_free(req.scratch);
+			return 0;
+		}
+		*c->req = req;
+		// Body bytes that arrived together with the head
+		return !wce_body_feed(c->req, c->buffer + c->head_len, (size_t)(c->buf_len - c->head_len));
+	}
+	wce_buf_free(req.scratch);
+	return 0;
+}
+
+// --- HTTP/2 (h2c) ---
+// Cleartext HTTP/2 on the same listener, entered with prior knowledge (the
+// client opens with the connection preface) or through "Upgrade: h2c" on an
+// HTTP/1.1 request. A client multiplexes all of its requests over one
+// connection. Each stream becomes an ordinary wce_request_t: the decoded
+// header block is rewritten into an HTTP/1-style head, so routing, query and
+// header lookups are shared, and wce_respond()/wce_stream_*() emit HEADERS
+// and DATA frames instead of HTTP/1 text.
+//
+// Handlers still run one at a time on the server thread, in the order their
+// requests arrive. Response DATA that does not fit the send windows is
+// parked on its stream and goes out as WINDOW_UPDATE frames arrive; the
+// handler and the loop carry on in the meantime. PRIORITY information is
+// validated but does not reorder responses.
+#define WCE_H2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define WCE_H2_PREFACE_LEN 24
+#define WCE_H2_FRAME_MAX 16384       // Largest frame we accept and send (protocol default)
+#define WCE_H2_MAX_STREAMS 32        // Streams waiting for request body DATA
+#define WCE_H2_TABLE_MAX 4096        // HPACK dynamic table size (protocol default)
+#define WCE_H2_TABLE_ENTRIES (WCE_H2_TABLE_MAX / 32)
+#define WCE_H2_BLOCK_MAX 65536       // Header block across CONTINUATION frames
+#define WCE_H2_FIELDS_MAX 262144     // Decoded header fields of one block
+#define WCE_H2_IN_CAP (3 * (9 + WCE_H2_FRAME_MAX))
+#define WCE_H2_OUT_CAP (2 * (9 + WCE_H2_FRAME_MAX))
+#define WCE_H2_WINDOW 65535          // Initial flow-control window (protocol default)
+#define WCE_H2_CREDIT_AT 32768       // Received bytes before a WINDOW_UPDATE goes out
+
+enum {
+	WCE_H2_DATA, WCE_H2_HEADERS, WCE_H2_PRIORITY, WCE_H2_RST_STREAM, WCE_H2_SETTINGS,
+	WCE_H2_PUSH_PROMISE, WCE_H2_PING, WCE_H2_GOAWAY, WCE_H2_WINDOW_UPDATE, WCE_H2_CONTINUATION
+};
+
+#define WCE_H2_END_STREAM  0x1
+#define WCE_H2_ACK         0x1
+#define WCE_H2_END_HEADERS 0x4
+#define WCE_H2_PADDED      0x8
+#define WCE_H2_PRIORITY_FLAG 0x20
+
+enum {
+	WCE_H2_NO_ERROR = 0x0, WCE_H2_PROTOCOL_ERROR = 0x1, WCE_H2_INTERNAL_ERROR = 0x2,
+	WCE_H2_FLOW_CONTROL_ERROR = 0x3, WCE_H2_STREAM_CLOSED = 0x5, WCE_H2_FRAME_SIZE_ERROR = 0x6,
+	WCE_H2_REFUSED_STREAM = 0x7, WCE_H2_COMPRESSION_ERROR = 0x9, WCE_H2_ENHANCE_YOUR_CALM = 0xb
+};
+
+// A stream holds a slot while its request body streams in or its response
+// is being sent, until both are done.
+typedef struct {
+	unsigned id;             // 0 while the slot is free
+	wce_request_t* req;      // Body route waiting for DATA
+	char* head;              // Pooled request head `req` points into
+	long long window;        // Send window for the response
+	int credit;              // Consumed DATA not yet returned by WINDOW_UPDATE
+	int reset;               // RST_STREAM arrived, closed after the current frame
+	int answered;            // END_STREAM sent, or parked behind the DATA below
+	char* parked;            // Response DATA waiting for send window
+	size_t parked_len;
+	size_t parked_off;       // Front of `parked` already sent
+	size_t parked_cap;
+} wce_h2_stream_t;
+
+typedef struct {
+	char* data;              // Name followed by value
+	unsigned name_len;
+	unsigned value_len;
+} wce_hpack_entry_t;
+
+typedef struct wce_h2_conn {
+	wce_server_t* srv;
+	wce_socket_t fd;
+	int conn;                // Connection slot, its queue carries the frames
+	char* in;                // Received frames, WCE_H2_IN_CAP
+	int in_len;
+	unsigned char* out;      // Frames waiting to be sent, WCE_H2_OUT_CAP
+	int out_len;
+	int preface;             // Preface bytes verified so far
+	int dead;                // Connection error: close once the stack unwinds
+	int goaway;              // Peer is done opening streams
+	unsigned last_stream;    // Highest stream the client opened
+	// Header block being assembled across CONTINUATION frames
+	char* block;
+	int block_len;
+	int block_cap;
+	int block_open;
+	unsigned block_stream;
+	int block_end_stream;
+	// Decoded fields of the current block: "name\0value\0" records
+	char* fields;
+	int fields_len;
+	int fields_cap;
+	int fields_bad;          // Malformed field, the stream gets PROTOCOL_ERROR
+	// HPACK decoder dynamic table, newest entry at table_first
+	wce_hpack_entry_t table[WCE_H2_TABLE_ENTRIES];
+	int table_first;
+	int table_count;
+	int table_size;
+	int table_max;
+	// Flow control
+	long long send_window;   // Connection-level
+	long long initial_window; // Peer SETTINGS_INITIAL_WINDOW_SIZE
+	size_t parked;           // Parked DATA bytes across the streams
+	uint64_t parked_due;     // Time by which parked DATA has to move, like out_due
+	size_t parked_progress;  // Parked bytes sent since parked_due was set
+	int credit;              // Connection-level receive credit
+	int open;                // Used stream slots
+	wce_h2_stream_t streams[WCE_H2_MAX_STREAMS];
+} wce_h2_conn_t;
+
+// HPACK static table (RFC 7541, Appendix A), index 1..61
+static const char* const wce_hpack_static[61][2] = {
+	{ ":authority", "" },
+	{ ":method", "GET" },
+	{ ":method", "POST" },
+	{ ":path", "/" },
+	{ ":path", "/index.html" },
+	{ ":scheme", "http" },
+	{ ":scheme", "https" },
+	{ ":status", "200" },
+	{ ":status", "204" },
+	{ ":status", "206" },
+	{ ":status", "304" },
+	{ ":status", "400" },
+	{ ":status", "404" },
+	{ ":status", "500" },
+	{ "accept-charset", "" },
+	{ "accept-encoding", "gzip, deflate" },
+	{ "accept-language", "" },
+	{ "accept-ranges", "" },
+	{ "accept", "" },
+	{ "access-control-allow-origin", "" },
+	{ "age", "" },
+	{ "allow", "" },
+	{ "authorization", "" },
+	{ "cache-control", "" },
+	{ "content-disposition", "" },
+	{ "content-encoding", "" },
+	{ "content-language", "" },
+	{ "content-length", "" },
+	{ "content-location", "" },
+	{ "content-range", "" },
+	{ "content-type", "" },
+	{ "cookie", "" },
+	{ "date", "" },
+	{ "etag", "" },
+	{ "expect", "" },
+	{ "expires", "" },
+	{ "from", "" },
+	{ "host", "" },
+	{ "if-match", "" },
+	{ "if-modified-since", "" },
+	{ "if-none-match", "" },
+	{ "if-range", "" },
+	{ "if-unmodified-since", "" },
+	{ "last-modified", "" },
+	{ "link", "" },
+	{ "location", "" },
+	{ "max-forwards", "" },
+	{ "proxy-authenticate", "" },
+	{ "proxy-authorization", "" },
+	{ "range", "" },
+	{ "referer", "" },
+	{ "refresh", "" },
+	{ "retry-after", "" },
+	{ "server", "" },
+	{ "set-cookie", "" },
+	{ "strict-transport-security", "" },
+	{ "transfer-encoding", "" },
+	{ "user-agent", "" },
+	{ "vary", "" },
+	{ "via", "" },
+	{ "www-authenticate", "" },
+};
+
+// Huffman code lengths of symbols 0..256 (RFC 7541, Appendix B). The code
+// is canonical, so the codes themselves follow from the lengths.
+static const unsigned char wce_hpack_huff_len[257] = {
+	13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+	28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+	6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+	5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+	13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+	15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+	6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+	20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+	24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+	22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+	21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+	26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+	19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+	20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+	26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+	30,
+};
+static unsigned short wce_huff_sym[257];    // Symbols ordered by (length, symbol)
+static unsigned wce_huff_first[31];         // First code of each length
+static unsigned short wce_huff_offset[31];  // Index in wce_huff_sym of that code
+static unsigned short wce_huff_count[31];
+static int wce_huff_ready = 0;
+
+static void wce_huff_init(void) {
+	unsigned code = 0;
+	int n = 0;
+	for (int len = 1; len <= 30; len++) {
+		wce_huff_first[len] = code;
+		wce_huff_offset[len] = (unsigned short)n;
+		for (int sym = 0; sym < 257; sym++) {
+			if (wce_hpack_huff_len[sym] == len) wce_huff_sym[n++] = (unsigned short)sym;
+		}
+		wce_huff_count[len] = (unsigned short)(n - wce_huff_offset[len]);
+		code = (code + wce_huff_count[len]) << 1;
+	}
+	wce_huff_ready = 1;
+}
+
+// Decodes a Huffman string into dst. Returns its length, or -1 when the
+// input is invalid or does not fit.
+static int wce_huff_decode(const unsigned char* s, size_t len, char* dst, size_t cap) {
+	if (!wce_huff_ready) wce_huff_init();
+	unsigned code = 0;
+	int bits = 0;
+	size_t out = 0;
+	for (size_t i = 0; i < len; i++) {
+		for (int b = 7; b >= 0; b--) {
+			code = (code << 1) | ((s[i] >> b) & 1u);
+			bits++;
+			if (code - wce_huff_first[bits] < wce_huff_count[bits]) {
+				unsigned sym = wce_huff_sym[wce_huff_offset[bits] + code - wce_huff_first[bits]];
+				if (sym == 256 || out >= cap) return -1;
+				dst[out++] = (char)sym;
+				code = 0;
+				bits = 0;
+			} else if (bits == 30) {
+				return -1;
+			}
+		}
+	}
+	// Padding: at most 7 bits, all ones (a prefix of EOS)
+	if (bits > 7 || code != (1u << bits) - 1) return -1;
+	return (int)out;
+}
+
+static int wce_hpack_int(const unsigned char** p, const unsigned char* end, int prefix, unsigned* out) {
+	if (*p >= end) return -1;
+	unsigned max = (1u << prefix) - 1;
+	unsigned v = *(*p)++ & max;
+	if (v < max) {
+		*out = v;
+		return 0;
+	}
+	for (int shift = 0; shift <= 21; shift += 7) {
+		if (*p >= end) return -1;
+		unsigned char b = *(*p)++;
+		v += (unsigned)(b & 0x7F) << shift;
+		if (!(b & 0x80)) {
+			*out = v;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static unsigned char* wce_hpack_put_int(unsigned char* p, int prefix, unsigned char flags, size_t v) {
+	size_t max = ((size_t)1 << prefix) - 1;
+	if (v < max) {
+		*p++ = (unsigned char)(flags | v);
+		return p;
+	}
+	*p++ = (unsigned char)(flags | max);
+	for (v -= max; v >= 128; v >>= 7) *p++ = (unsigned char)(0x80 | (v & 0x7F));
+	*p++ = (unsigned char)v;
+	return p;
+}
+
+// Literal header field without indexing, name from the static table.
+static unsigned char* wce_hpack_put_field(unsigned char* p, int name_index, const char* value, size_t len) {
+	p = wce_hpack_put_int(p, 4, 0x00, (size_t)name_index);
+	p = wce_hpack_put_int(p, 7, 0x00, len);
+	memcpy(p, value, len);
+	return p + len;
+}
+
+// Literal header field without indexing, with a literal (lowercase) name.
+static unsigned char* wce_hpack_put_named(unsigned char* p, const char* name, const char* value, size_t len) {
+	size_t name_len = strlen(name);
+	*p++ = 0x00;
+	p = wce_hpack_put_int(p, 7, 0x00, name_len);
+	memcpy(p, name, name_len);
+	p = wce_hpack_put_int(p + name_len, 7, 0x00, len);
+	memcpy(p, value, len);
+	return p + len;
+}
+
+static void wce_hpack_evict(wce_h2_conn_t* h, int max) {
+	while (h->table_count && h->table_size > max) {
+		wce_hpack_entry_t* e = &h->table[(h->table_first + h->table_count - 1) % WCE_H2_TABLE_ENTRIES];
+		h->table_size -= (int)(e->name_len + e->value_len + 32);
+		free(e->data);
+		e->data = NULL;
+		h->table_count--;
+	}
+}
+
+static int wce_hpack_insert(wce_h2_conn_t* h, const char* name, unsigned name_len, const char* value, unsigned value_len) {
+	int size = (int)(name_len + value_len + 32);
+	wce_hpack_evict(h, h->table_max - size);
+	if (size > h->table_max) return 0; // Too large: the table is just emptied
+	char* data = (char*)malloc(name_len + value_len + 1);
+	if (!data) return -1;
+	memcpy(data, name, name_len);
+	memcpy(data + name_len, value, value_len);
+	h->table_first = (h->table_first + WCE_H2_TABLE_ENTRIES - 1) % WCE_H2_TABLE_ENTRIES;
+	wce_hpack_entry_t* e = &h->table[h->table_first];
+	e->data = data;
+	e->name_len = name_len;
+	e->value_len = value_len;
+	h->table_count++;
+	h->table_size += size;
+	return 0;
+}
+
+static int wce_hpack_get(wce_h2_conn_t* h, unsigned index, const char** name, unsigned* name_len, const char** value, unsigned* value_len) {
+	if (index >= 1 && index <= 61) {
+		*name = wce_hpack_static[index - 1][0];
+		*value = wce_hpack_static[index - 1][1];
+		*name_len = (unsigned)strlen(*name);
+		*value_len = (unsigned)strlen(*value);
+		return 0;
+	}
+	if (index < 62 || index - 62 >= (unsigned)h->table_count) return -1;
+	const wce_hpack_entry_t* e = &h->table[(h->table_first + (int)(index - 62)) % WCE_H2_TABLE_ENTRIES];
+	*name = e->data;
+	*name_len = e->name_len;
+	*value = e->data + e->name_len;
+	*value_len = e->value_len;
+	return 0;
+}
+
+static int wce_h2_grow(char** buf, int* cap, size_t need, size_t max) {
+	if (need <= (size_t)*cap) return 0;
+	size_t new_cap = *cap ? (size_t)*cap : 1024;
+	while (new_cap < need) new_cap *= 2;
+	if (new_cap > max) new_cap = max;
+	if (need > new_cap) return -1;
+	char* grown = (char*)realloc(*buf, new_cap);
+	if (!grown) return -1;
+	*buf = grown;
+	*cap = (int)new_cap;
+	return 0;
+}
+
+// Field bytes end up in an HTTP/1-style head, so CR, LF and NUL make the
+// request malformed.
+static void wce_h2_field_check(wce_h2_conn_t* h, const char* s, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] == '\r' || s[i] == '\n' || s[i] == '\0') h->fields_bad = 1;
+	}
+}
+
+static int wce_h2_field_put(wce_h2_conn_t* h, const char* s, unsigned len) {
+	if (wce_h2_grow(&h->fields, &h->fields_cap, (size_t)h->fields_len + len + 1, WCE_H2_FIELDS_MAX) != 0) return -1;
+	memcpy(h->fields + h->fields_len, s, len);
+	h->fields[h->fields_len + len] = '\0';
+	h->fields_len += (int)len + 1;
+	return 0;
+}
+
+// Decodes a string literal straight into the field records.
+static int wce_h2_field_string(wce_h2_conn_t* h, const unsigned char** p, const unsigned char* end) {
+	if (*p >= end) return -1;
+	int huffman = **p & 0x80;
+	unsigned len;
+	if (wce_hpack_int(p, end, 7, &len) != 0 || len > (unsigned)(end - *p)) return -1;
+	const unsigned char* s = *p;
+	*p += len;
+	if (!huffman) return wce_h2_field_put(h, (const char*)s, len);
+
+	size_t room = (size_t)len * 8 / 5 + 1; // Shortest code is 5 bits
+	if (wce_h2_grow(&h->fields, &h->fields_cap, (size_t)h->fields_len + room + 1, WCE_H2_FIELDS_MAX) != 0) return -1;
+	int n = wce_huff_decode(s, len, h->fields + h->fields_len, room);
+	if (n < 0) return -1;
+	h->fields[h->fields_len + n] = '\0';
+	h->fields_len += n + 1;
+	return 0;
+}
+
+// Decodes a complete header block into h->fields. Returns -1 on a
+// compression error, which ends the connection: the table is out of sync.
+static int wce_hpack_decode(wce_h2_conn_t* h, const unsigned char* p, const unsigned char* end) {
+	h->fields_len = 0;
+	h->fields_bad = 0;
+	while (p < end) {
+		unsigned char b = *p;
+		unsigned index;
+		if ((b & 0xE0) == 0x20) {
+			// Dynamic table size update
+			if (wce_hpack_int(&p, end, 5, &index) != 0 || index > WCE_H2_TABLE_MAX) return -1;
+			h->table_max = (int)index;
+			wce_hpack_evict(h, h->table_max);
+			continue;
+		}
+		int prefix = (b & 0x80) ? 7 : (b & 0x40) ? 6 : 4;
+		if (wce_hpack_int(&p, end, prefix, &index) != 0) return -1;
+
+		int name_at = h->fields_len;
+		if (index || (b & 0x80)) {
+			const char *name, *value;
+			unsigned name_len, value_len;
+			if (wce_hpack_get(h, index, &name, &name_len, &value, &value_len) != 0) return -1;
+			if (wce_h2_field_put(h, name, name_len) != 0) return -1;
+			if (b & 0x80) {
+				if (wce_h2_field_put(h, value, value_len) != 0) return -1;
+				continue;
+			}
+		} else if (wce_h2_field_string(h, &p, end) != 0) {
+			return -1;
+		}
+		int value_at = h->fields_len;
+		if (wce_h2_field_string(h, &p, end) != 0) return -1;
+		wce_h2_field_check(h, h->fields + name_at, (size_t)(value_at - name_at - 1));
+		wce_h2_field_check(h, h->fields + value_at, (size_t)(h->fields_len - value_at - 1));
+		if ((b & 0x40) && wce_hpack_insert(h, h->fields + name_at, (unsigned)(value_at - name_at - 1),
+			h->fields + value_at, (unsigned)(h->fields_len - value_at - 1)) != 0) return -1;
+	}
+	return 0;
+}
+
+static int wce_h2_append(char* head, int cap, int* len, const char* s, size_t n) {
+	if ((size_t)(cap - *len) <= n) return -1;
+	memcpy(head + *len, s, n);
+	*len += (int)n;
+	return 0;
+}
+
+// Rewrites the decoded fields as "METHOD path HTTP/2" plus header lines.
+// Returns the head length, -1 for a malformed request, -2 when too large.
+static int wce_h2_build_head(wce_h2_conn_t* h, char* head, int cap) {
+	const char* method = NULL;
+	const char* path = NULL;
+	const char* authority = NULL;
+	const char* end = h->fields + h->fields_len;
+	int regular = 0;
+	if (h->fields_bad) return -1;
+	for (const char* f = h->fields; f < end; ) {
+		const char* name = f;
+		const char* value = name + strlen(name) + 1;
+		f = value + strlen(value) + 1;
+		if (name[0] == ':') {
+			// Pseudo-headers come first
+			if (regular) return -1;
+			if (strcmp(name, ":method") == 0) method = value;
+			else if (strcmp(name, ":path") == 0) path = value;
+			else if (strcmp(name, ":authority") == 0) authority = value;
+			else if (strcmp(name, ":scheme") != 0) return -1;
+		} else {
+			regular = 1;
+			if (strcmp(name, "connection") == 0 || strcmp(name, "transfer-encoding") == 0 ||
+				strcmp(name, "upgrade") == 0 || strcmp(name, "keep-alive") == 0 ||
+				strcmp(name, "proxy-connection") == 0) return -1;
+		}
+	}
+	if (!method || !path || !*method || !*path || strchr(method, ' ') || strchr(path, ' ')) return -1;
+
+	int len = 0;
+	int fail = wce_h2_append(head, cap, &len, method, strlen(method));
+	fail |= wce_h2_append(head, cap, &len, " ", 1);
+	fail |= wce_h2_append(head, cap, &len, path, strlen(path));
+	fail |= wce_h2_append(head, cap, &len, " HTTP/2\r\n", 9);
+	if (authority) {
+		fail |= wce_h2_append(head, cap, &len, "host: ", 6);
+		fail |= wce_h2_append(head, cap, &len, authority, strlen(authority));
+		fail |= wce_h2_append(head, cap, &len, "\r\n", 2);
+	}
+	for (const char* f = h->fields; f < end && !fail; ) {
+		const char* name = f;
+		size_t name_len = strlen(name);
+		const char* value = name + name_len + 1;
+		size_t value_len = strlen(value);
+		f = value + value_len + 1;
+		if (name[0] == ':') continue;
+		fail |= wce_h2_append(head, cap, &len, name, name_len);
+		fail |= wce_h2_append(head, cap, &len, ": ", 2);
+		fail |= wce_h2_append(head, cap, &len, value, value_len);
+		fail |= wce_h2_append(head, cap, &len, "\r\n", 2);
+	}
+	fail |= wce_h2_append(head, cap, &len, "\r\n", 2);
+	if (fail) return -2;
+	head[len] = '\0';
+	return len;
+}
+
+// --- HTTP/2 framing ---
+
+static unsigned wce_h2_u32(const unsigned char* p) {
+	return ((unsigned)p[0] << 24) | ((unsigned)p[1] << 16) | ((unsigned)p[2] << 8) | p[3];
+}
+
+static int wce_h2_flush(wce_h2_conn_t* h) {
+	if (!h->out_len) return 0;
+	int rc = wce_conn_send(h->srv, h->conn, (const char*)h->out, (size_t)h->out_len);
+	h->out_len = 0;
+	if (rc != 0) h->dead = 1;
+	return rc;
+}
+
+// Returns room for a frame of up to `max` payload bytes at the end of the
+// output buffer, flushing first when it does not fit.
+static unsigned char* wce_h2_frame_begin(wce_h2_conn_t* h, int max) {
+	if (h->dead) return NULL;
+	if (h->out_len + 9 + max > WCE_H2_OUT_CAP && wce_h2_flush(h) != 0) return NULL;
+	return h->out + h->out_len + 9;
+}
+
+static void wce_h2_frame_end(wce_h2_conn_t* h, int type, int flags, unsigned stream, int len) {
+	unsigned char* f = h->out + h->out_len;
+	f[0] = (unsigned char)(len >> 16);
+	f[1] = (unsigned char)(len >> 8);
+	f[2] = (unsigned char)len;
+	f[3] = (unsigned char)type;
+	f[4] = (unsigned char)flags;
+	f[5] = (unsigned char)(stream >> 24);
+	f[6] = (unsigned char)(stream >> 16);
+	f[7] = (unsigned char)(stream >> 8);
+	f[8] = (unsigned char)stream;
+	h->out_len += 9 + len;
+}
+
+static void wce_h2_frame_u32(wce_h2_conn_t* h, int type, unsigned stream, unsigned a, int two, unsigned b) {
+	unsigned char* p = wce_h2_frame_begin(h, 8);
+	if (!p) return;
+	unsigned v[2] = { a, b };
+	for (int i = 0; i < (two ? 2 : 1); i++) {
+		p[i * 4] = (unsigned char)(v[i] >> 24);
+		p[i * 4 + 1] = (unsigned char)(v[i] >> 16);
+		p[i * 4 + 2] = (unsigned char)(v[i] >> 8);
+		p[i * 4 + 3] = (unsigned char)v[i];
+	}
+	wce_h2_frame_end(h, type, 0, stream, two ? 8 : 4);
+}
+
+static void wce_h2_rst(wce_h2_conn_t* h, unsigned stream, unsigned code) {
+	wce_h2_frame_u32(h, WCE_H2_RST_STREAM, stream, code, 0, 0);
+}
+
+// Connection error: GOAWAY, then the connection is closed.
+static void wce_h2_fail(wce_h2_conn_t* h, unsigned code) {
+	if (h->dead) return;
+	wce_h2_frame_u32(h, WCE_H2_GOAWAY, 0, h->last_stream, 1, code);
+	wce_h2_flush(h);
+	h->dead = 1;
+}
+
+// Slot of stream `id`; id 0 finds a free slot.
+static wce_h2_stream_t* wce_h2_stream_find(wce_h2_conn_t* h, unsigned id) {
+	if (id && !h->open) return NULL;
+	for (int i = 0; i < WCE_H2_MAX_STREAMS; i++) {
+		if (h->streams[i].id == id) return &h->streams[i];
+	}
+	return NULL;
+}
+
+// Slot of stream `id`, taking a free one if the stream has none yet.
+static wce_h2_stream_t* wce_h2_stream_get(wce_h2_conn_t* h, unsigned id) {
+	wce_h2_stream_t* st = wce_h2_stream_find(h, id);
+	if (st) return st;
+	st = wce_h2_stream_find(h, 0);
+	if (!st) return NULL;
+	st->id = id;
+	st->window = h->initial_window;
+	h->open++;
+	return st;
+}
+
+// Abandons the stream: its body handler gets the final call and parked
+// DATA is dropped.
+static void wce_h2_stream_close(wce_h2_conn_t* h, wce_h2_stream_t* st) {
+	wce_body_release(st->req);
+	wce_buf_free(st->head);
+	h->parked -= st->parked_len - st->parked_off;
+	free(st->parked);
+	memset(st, 0, sizeof(*st));
+	h->open--;
+}
+
+// Frees the slot once the request has been read and the response sent.
+static void wce_h2_stream_done(wce_h2_conn_t* h, wce_h2_stream_t* st) {
+	if (!st->req && st->answered && st->parked_off == st->parked_len) wce_h2_stream_close(h, st);
+}
+
+// The request body has been delivered in full.
+static void wce_h2_stream_ended(wce_h2_conn_t* h, wce_h2_stream_t* st) {
+	wce_body_release(st->req);
+	wce_buf_free(st->head);
+	st->req = NULL;
+	st->head = NULL;
+	wce_h2_stream_done(h, st);
+}
+
+// Writes the response HEADERS frame. A known length of 0 ends the stream
+// here; -1 starts a streamed response whose head is sent right away.
+static int wce_h2_head(wce_request_t* req, int status, const char* content_type, long long content_length,
+	const wce_resp_headers_t* extra) {
+	wce_h2_conn_t* h = req->h2;
+	unsigned sid = req->h2_stream;
+	wce_h2_stream_t* st = wce_h2_stream_get(h, sid);
+	if (!st || st->reset) return -1;
+
+	if (!content_type) content_type = "text/plain";
+	size_t type_len = strlen(content_type);
+	if (type_len > 256) {
+		content_type = "application/octet-stream";
+		type_len = 24;
+	}
+	// Optional fields by HPACK static table index: etag, cache-control,
+	// content-encoding, vary. Each takes its length plus a few prefix bytes.
+	static const int extra_index[4] = { 34, 24, 26, 59 };
+	const char* extra_value[4] = { NULL, NULL, NULL, NULL };
+	size_t extra_len[4] = { 0, 0, 0, 0 };
+	size_t reserve = 320;
+	if (extra && extra->patch_seq) reserve += 16 + strlen(extra->patch_seq);
+	if (extra) {
+		extra_value[0] = extra->etag;
+		extra_value[1] = extra->cache_control;
+		extra_value[2] = extra->content_encoding;
+		extra_value[3] = extra->vary;
+		for (int i = 0; i < 4; i++) {
+			if (!extra_value[i]) continue;
+			extra_len[i] = strlen(extra_value[i]);
+			if (extra_len[i] > 256) extra_value[i] = NULL;
+			else reserve += extra_len[i] + 8;
+		}
+	}
+	unsigned char* p = wce_h2_frame_begin(h, (int)reserve);
+	if (!p) return -1;
+	unsigned char* start = p;
+	switch (status) {
+		case 200: *p++ = 0x80 | 8; break;
+		case 204: *p++ = 0x80 | 9; break;
+		case 400: *p++ = 0x80 | 12; break;
+		case 404: *p++ = 0x80 | 13; break;
+		case 500: *p++ = 0x80 | 14; break;
+		default: {
+			char digits[4];
+			snprintf(digits, sizeof(digits), "%03d", status >= 100 && status <= 999 ? status : 500);
+			p = wce_hpack_put_field(p, 8, digits, 3);
+			break;
+		}
+	}
+	p = wce_hpack_put_field(p, 31, content_type, type_len);
+	if (content_length >= 0 && status != 304) {
+		char num[24];
+		int n = snprintf(num, sizeof(num), "%lld", content_length);
+		p = wce_hpack_put_field(p, 28, num, (size_t)n);
+	}
+	for (int i = 0; i < 4; i++) {
+		if (extra_value[i]) p = wce_hpack_put_field(p, extra_index[i], extra_value[i], extra_len[i]);
+	}
+	if (extra && extra->patch_seq) {
+		p = wce_hpack_put_named(p, "x-wce-patch", extra->patch_seq, strlen(extra->patch_seq));
+	}
+	p = wce_hpack_put_field(p, 20, "*", 1);
+	wce_h2_frame_end(h, WCE_H2_HEADERS, WCE_H2_END_HEADERS | (content_length == 0 ? WCE_H2_END_STREAM : 0),
+		sid, (int)(p - start));
+	if (content_length > 0) return 0;
+	int rc = wce_h2_flush(h);
+	if (content_length == 0) {
+		st->answered = 1;
+		wce_h2_stream_done(h, st);
+	}
+	return rc;
+}
+
+// Sends DATA frames within the connection and stream send windows and
+// returns the bytes sent. END_STREAM goes on the frame carrying the last
+// byte when `end_stream` is set, on an empty frame when `len` is 0.
+static size_t wce_h2_send_data(wce_h2_conn_t* h, wce_h2_stream_t* st, const char* data, size_t len, int end_stream) {
+	size_t sent = 0;
+	for (;;) {
+		long long avail = h->send_window < st->window ? h->send_window : st->window;
+		size_t n = len - sent < WCE_H2_FRAME_MAX ? len - sent : WCE_H2_FRAME_MAX;
+		if ((long long)n > avail) n = avail > 0 ? (size_t)avail : 0;
+		int last = sent + n == len;
+		if (!n && !(last && end_stream)) break;
+		unsigned char* p = wce_h2_frame_begin(h, (int)n);
+		if (!p) break;
+		memcpy(p, data + sent, n);
+		wce_h2_frame_end(h, WCE_H2_DATA, last && end_stream ? WCE_H2_END_STREAM : 0, st->id, (int)n);
+		h->send_window -= (long long)n;
+		st->window -= (long long)n;
+		sent += n;
+		if (last) break;
+	}
+	return sent;
+}
+
+// Keeps DATA that did not fit the send windows on the stream. The first
+// parked bytes of the connection start the parked_due deadline.
+static int wce_h2_park(wce_h2_conn_t* h, wce_h2_stream_t* st, const char* data, size_t len) {
+	if (st->parked_off && st->parked_len + len > st->parked_cap) {
+		memmove(st->parked, st->parked + st->parked_off, st->parked_len - st->parked_off);
+		st->parked_len -= st->parked_off;
+		st->parked_off = 0;
+	}
+	if (st->parked_len + len > st->parked_cap) {
+		size_t cap = st->parked_cap ? st->parked_cap : WCE_H2_FRAME_MAX;
+		while (cap < st->parked_len + len) cap *= 2;
+		char* grown = (char*)realloc(st->parked, cap);
+		if (!grown) return -1;
+		st->parked = grown;
+		st->parked_cap = cap;
+	}
+	memcpy(st->parked + st->parked_len, data, len);
+	st->parked_len += len;
+	if (!h->parked) {
+		h->parked_due = wce_now_ms() + (uint64_t)h->srv->cfg.send_timeout_ms;
+		h->parked_progress = 0;
+	}
+	h->parked += len;
+	return 0;
+}
+
+// Sends response DATA. What does not fit the send windows is parked and
+// goes out from wce_h2_resume(); the handler does not wait for it.
+static int wce_h2_data(wce_request_t* req, const char* data, size_t len, int end_stream) {
+	wce_h2_conn_t* h = req->h2;
+	wce_h2_stream_t* st = wce_h2_stream_find(h, req->h2_stream);
+	if (!st || st->answered || st->reset || h->dead) return -1;
+	if (!len && !end_stream) return 0;
+	// Parked DATA goes first
+	size_t sent = st->parked_off < st->parked_len ? 0 : wce_h2_send_data(h, st, data, len, end_stream);
+	if (h->dead) return -1;
+	if (sent < len && wce_h2_park(h, st, data + sent, len - sent) != 0) {
+		wce_h2_rst(h, st->id, WCE_H2_INTERNAL_ERROR);
+		st->reset = 1;
+		return -1;
+	}
+	if (!end_stream) return 0;
+	st->answered = 1;
+	int rc = wce_h2_flush(h);
+	wce_h2_stream_done(h, st);
+	return rc;
+}
+
+// The send windows opened: parked DATA goes out, stream slot by slot.
+static void wce_h2_resume(wce_h2_conn_t* h) {
+	for (int i = 0; i < WCE_H2_MAX_STREAMS && h->parked && h->send_window > 0 && !h->dead; i++) {
+		wce_h2_stream_t* st = &h->streams[i];
+		size_t left = st->parked_len - st->parked_off;
+		if (!st->id || st->reset || !left) continue;
+		size_t sent = wce_h2_send_data(h, st, st->parked + st->parked_off, left, st->answered);
+		st->parked_off += sent;
+		h->parked -= sent;
+		h->parked_progress += sent;
+		if (sent == left) {
+			free(st->parked);
+			st->parked = NULL;
+			st->parked_len = st->parked_off = st->parked_cap = 0;
+			wce_h2_stream_done(h, st);
+		}
+	}
+	if (h->parked && h->parked_progress >= WCE_SEND_PROGRESS) {
+		h->parked_due = wce_now_ms() + (uint64_t)h->srv->cfg.send_timeout_ms;
+		h->parked_progress = 0;
+	}
+}
+
+// Runs a parsed request on stream `sid`. `head` is the pooled buffer the
+// request points into; it is released when the stream is done.
+static void wce_h2_run(wce_h2_conn_t* h, unsigned sid, wce_request_t* req, char* head, int end_stream) {
+	req->srv = h->srv;
+	req->fd = h->fd;
+	req->conn = h->conn;
+	req->h2 = h;
+	req->h2_stream = sid;
+	req->content_length = -1; // Unknown unless the request sends content-length
+
+	WCE_TRACE_BEGIN(request);
+	int streaming = wce_request_run(req);
+	WCE_TRACE_END(request, "process_request");
+	if (streaming && end_stream) {
+		wce_body_finish(req, 0);
+		streaming = 0;
+	}
+	if (streaming) {
+		// A response the handler already completed has given its slot back
+		int answered = req->responded && !wce_h2_stream_find(h, sid);
+		wce_h2_stream_t* st = wce_h2_stream_get(h, sid);
+		wce_request_t* kept = st ? (wce_request_t*)malloc(sizeof(wce_request_t)) : NULL;
+		if (kept) {
+			*kept = *req;
+			st->req = kept;
+			st->head = head;
+			st->answered |= answered;
+			return;
+		}
+		req->responded = 1;
+		wce_body_finish(req, 1);
+		wce_h2_rst(h, sid, WCE_H2_REFUSED_STREAM);
+		if (st) wce_h2_stream_close(h, st);
+	} else if (!end_stream && !wce_h2_stream_find(h, sid)) {
+		// Answered before the client finished sending: stop the upload,
+		// unless response DATA is still parked or the stream was reset
+		wce_h2_rst(h, sid, WCE_H2_NO_ERROR);
+	}
+	wce_buf_free(req->scratch);
+	wce_buf_free(head);
+}
+
+// A complete header block: a new request, or trailers ending a body.
+static void wce_h2_headers(wce_h2_conn_t* h) {
+	unsigned sid = h->block_stream;
+	int end_stream = h->block_end_stream;
+	const unsigned char* block = (const unsigned char*)h->block;
+	if (wce_hpack_decode(h, block, block + h->block_len) != 0) {
+		wce_h2_fail(h, WCE_H2_COMPRESSION_ERROR);
+		return;
+	}
+
+	wce_h2_stream_t* st = wce_h2_stream_find(h, sid);
+	if (st) {
+		if (!st->req) return; // Trailers of a request answered before its body
+		if (!end_stream) {
+			wce_h2_rst(h, sid, WCE_H2_PROTOCOL_ERROR);
+			wce_h2_stream_close(h, st);
+			return;
+		}
+		wce_body_finish(st->req, 0);
+		wce_h2_stream_ended(h, st);
+		return;
+	}
+	if (sid <= h->last_stream) {
+		wce_h2_fail(h, WCE_H2_STREAM_CLOSED);
+		return;
+	}
+	h->last_stream = sid;
+	if (h->open >= WCE_H2_MAX_STREAMS) {
+		wce_h2_rst(h, sid, WCE_H2_REFUSED_STREAM);
+		return;
+	}
+
+	int cap = 0;
+	char* head = wce_buf_alloc(h->srv, BUFFER_SIZE, &cap);
+	if (!head) {
+		wce_h2_rst(h, sid, WCE_H2_REFUSED_STREAM);
+		return;
+	}
+	int len = wce_h2_build_head(h, head, cap);
+	wce_request_t req;
+	if (len == -2) {
+		memset(&req, 0, sizeof(req));
+		req.h2 = h;
+		req.h2_stream = sid;
+		wce_respond(&req, 431, "text/plain", "Request too large", 17);
+		if (!end_stream) wce_h2_rst(h, sid, WCE_H2_NO_ERROR);
+	} else if (len < 0 || wce_request_parse(&req, head, len) != 0) {
+		wce_h2_rst(h, sid, WCE_H2_PROTOCOL_ERROR);
+	} else {
+		wce_h2_run(h, sid, &req, head, end_stream);
+		return;
+	}
+	wce_buf_free(head);
+}
+
+static void wce_h2_settings(wce_h2_conn_t* h, const unsigned char* p, int len) {
+	for (int i = 0; i + 6 <= len; i += 6) {
+		unsigned id = ((unsigned)p[i] << 8) | p[i + 1];
+		unsigned value = wce_h2_u32(p + i + 2);
+		if (id == 0x2 && value > 1) {
+			wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+			return;
+		}
+		if (id == 0x4) {
+			// SETTINGS_INITIAL_WINDOW_SIZE moves every open stream's window
+			if (value > 0x7FFFFFFF) {
+				wce_h2_fail(h, WCE_H2_FLOW_CONTROL_ERROR);
+				return;
+			}
+			long long delta = (long long)value - h->initial_window;
+			h->initial_window = value;
+			for (int s = 0; s < WCE_H2_MAX_STREAMS; s++) {
+				if (h->streams[s].id) h->streams[s].window += delta;
+			}
+		}
+		if (id == 0x5 && (value < WCE_H2_FRAME_MAX || value > 0xFFFFFF)) {
+			wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+			return;
+		}
+	}
+}
+
+static void wce_h2_block_append(wce_h2_conn_t* h, const unsigned char* p, int len) {
+	if (!len) return; // Empty fragment: the block may not be allocated yet
+	if (wce_h2_grow(&h->block, &h->block_cap, (size_t)h->block_len + (size_t)len, WCE_H2_BLOCK_MAX) != 0) {
+		wce_h2_fail(h, WCE_H2_ENHANCE_YOUR_CALM);
+		return;
+	}
+	memcpy(h->block + h->block_len, p, (size_t)len);
+	h->block_len += len;
+}
+
+static void wce_h2_frame(wce_h2_conn_t* h, int type, int flags, unsigned sid, const unsigned char* p, int len) {
+	if (h->block_open && (type != WCE_H2_CONTINUATION || sid != h->block_stream)) {
+		wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+		return;
+	}
+	int pad = 0;
+	if ((type == WCE_H2_DATA || type == WCE_H2_HEADERS) && (flags & WCE_H2_PADDED)) {
+		if (len < 1 || p[0] >= len) {
+			wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+			return;
+		}
+		pad = p[0];
+		p++;
+		len -= 1 + pad;
+	}
+
+	switch (type) {
+		case WCE_H2_DATA: {
+			if (!sid || sid > h->last_stream) {
+				wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+				return;
+			}
+			// Our receive windows are the protocol default less the credit
+			// not yet returned (see wce_h2_credit)
+			int frame_len = len + pad + ((flags & WCE_H2_PADDED) ? 1 : 0);
+			if (frame_len > WCE_H2_WINDOW - h->credit) {
+				wce_h2_fail(h, WCE_H2_FLOW_CONTROL_ERROR);
+				return;
+			}
+			h->credit += frame_len;
+			wce_h2_stream_t* st = wce_h2_stream_find(h, sid);
+			// Closed or answered stream: only the connection window counts
+			if (!st || st->reset || !st->req) return;
+			if (frame_len > WCE_H2_WINDOW - st->credit) {
+				wce_h2_rst(h, sid, WCE_H2_FLOW_CONTROL_ERROR);
+				wce_h2_stream_close(h, st);
+				return;
+			}
+			st->credit += frame_len;
+			if (len && wce_body_deliver(st->req, (const char*)p, (size_t)len) != 0) {
+				// Stop the upload, unless that would drop parked response DATA
+				wce_h2_stream_ended(h, st);
+				if (!wce_h2_stream_find(h, sid)) wce_h2_rst(h, sid, WCE_H2_NO_ERROR);
+			} else if (flags & WCE_H2_END_STREAM) {
+				wce_body_finish(st->req, 0);
+				wce_h2_stream_ended(h, st);
+			}
+			return;
+		}
+		case WCE_H2_HEADERS:
+			if (!sid || !(sid & 1)) {
+				wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+				return;
+			}
+			if (flags & WCE_H2_PRIORITY_FLAG) {
+				if (len < 5) {
+					wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+					return;
+				}
+				p += 5;
+				len -= 5;
+			}
+			h->block_len = 0;
+			h->block_stream = sid;
+			h->block_end_stream = flags & WCE_H2_END_STREAM;
+			wce_h2_block_append(h, p, len);
+			if (h->dead) return;
+			if (flags & WCE_H2_END_HEADERS) wce_h2_headers(h);
+			else h->block_open = 1;
+			return;
+		case WCE_H2_CONTINUATION:
+			if (!h->block_open) {
+				wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+				return;
+			}
+			wce_h2_block_append(h, p, len);
+			if (!h->dead && (flags & WCE_H2_END_HEADERS)) {
+				h->block_open = 0;
+				wce_h2_headers(h);
+			}
+			return;
+		case WCE_H2_PRIORITY:
+			if (!sid) {
+				wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+			} else if (len != 5) {
+				wce_h2_rst(h, sid, WCE_H2_FRAME_SIZE_ERROR);
+			} else if ((wce_h2_u32(p) & 0x7FFFFFFF) == sid) {
+				wce_h2_rst(h, sid, WCE_H2_PROTOCOL_ERROR);
+			}
+			return;
+		case WCE_H2_RST_STREAM: {
+			if (len != 4) {
+				wce_h2_fail(h, WCE_H2_FRAME_SIZE_ERROR);
+				return;
+			}
+			if (!sid || sid > h->last_stream) {
+				wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+				return;
+			}
+			// Closing a body stream runs its handler, so that is left to the
+			// frame loop; a response in progress stops at its next frame.
+			wce_h2_stream_t* st = wce_h2_stream_find(h, sid);
+			if (st) st->reset = 1;
+			return;
+		}
+		case WCE_H2_SETTINGS:
+			if (sid) {
+				wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+			} else if (flags & WCE_H2_ACK) {
+				if (len) wce_h2_fail(h, WCE_H2_FRAME_SIZE_ERROR);
+			} else if (len % 6) {
+				wce_h2_fail(h, WCE_H2_FRAME_SIZE_ERROR);
+			} else {
+				wce_h2_settings(h, p, len);
+				if (!h->dead && wce_h2_frame_begin(h, 0)) wce_h2_frame_end(h, WCE_H2_SETTINGS, WCE_H2_ACK, 0, 0);
+				wce_h2_resume(h);
+			}
+			return;
+		case WCE_H2_PING: {
+			if (sid) {
+				wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+				return;
+			}
+			if (len != 8) {
+				wce_h2_fail(h, WCE_H2_FRAME_SIZE_ERROR);
+				return;
+			}
+			if (flags & WCE_H2_ACK) return;
+			unsigned char* out = wce_h2_frame_begin(h, 8);
+			if (!out) return;
+			memcpy(out, p, 8);
+			wce_h2_frame_end(h, WCE_H2_PING, WCE_H2_ACK, 0, 8);
+			return;
+		}
+		case WCE_H2_GOAWAY:
+			if (sid) wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+			else if (len < 8) wce_h2_fail(h, WCE_H2_FRAME_SIZE_ERROR);
+			else h->goaway = 1;
+			return;
+		case WCE_H2_WINDOW_UPDATE: {
+			if (len != 4) {
+				wce_h2_fail(h, WCE_H2_FRAME_SIZE_ERROR);
+				return;
+			}
+			unsigned inc = wce_h2_u32(p) & 0x7FFFFFFF;
+			if (!sid) {
+				h->send_window += inc;
+				if (!inc || h->send_window > 0x7FFFFFFF) wce_h2_fail(h, inc ? WCE_H2_FLOW_CONTROL_ERROR : WCE_H2_PROTOCOL_ERROR);
+				else wce_h2_resume(h);
+				return;
+			}
+			if (sid > h->last_stream) {
+				wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+				return;
+			}
+			wce_h2_stream_t* st = wce_h2_stream_find(h, sid);
+			if (st) st->window += inc;
+			if (!inc || (st && st->window > 0x7FFFFFFF)) {
+				wce_h2_rst(h, sid, inc ? WCE_H2_FLOW_CONTROL_ERROR : WCE_H2_PROTOCOL_ERROR);
+				if (st) st->reset = 1;
+			} else if (st) {
+				wce_h2_resume(h);
+			}
+			return;
+		}
+		case WCE_H2_PUSH_PROMISE:
+			wce_h2_fail(h, WCE_H2_PROTOCOL_ERROR);
+			return;
+		default:
+			return; // Unknown frame types are ignored
+	}
+}
+
+// Consumes the client connection preface from the front of the input.
+static void wce_h2_preface(wce_h2_conn_t* h) {
+	int n = WCE_H2_PREFACE_LEN - h->preface;
+	if (n <= 0) return;
+	if (n > h->in_len) n = h->in_len;
+	if (memcmp(h->in, WCE_H2_PREFACE + h->preface, (size_t)n) != 0) {
+		h->dead = 1;
+		return;
+	}
+	memmove(h->in, h->in + n, (size_t)(h->in_len - n));
+	h->in_len -= n;
+	h->preface += n;
+}
+
+// Returns consumed receive window with WINDOW_UPDATE once a batch of
+// frames has been handled. Within the batch the peer cannot have seen the
+// update yet, so DATA past the advertised window is an error there.
+static void wce_h2_credit(wce_h2_conn_t* h) {
+	if (h->credit >= WCE_H2_CREDIT_AT) {
+		wce_h2_frame_u32(h, WCE_H2_WINDOW_UPDATE, 0, (unsigned)h->credit, 0, 0);
+		h->credit = 0;
+	}
+	for (int i = 0; i < WCE_H2_MAX_STREAMS && h->open; i++) {
+		wce_h2_stream_t* st = &h->streams[i];
+		if (st->id && st->req && st->credit >= WCE_H2_CREDIT_AT) {
+			wce_h2_frame_u32(h, WCE_H2_WINDOW_UPDATE, st->id, (unsigned)st->credit, 0, 0);
+			st->credit = 0;
+		}
+	}
+}
+
+// Handles every complete frame in the input, in order.
+static void wce_h2_process(wce_h2_conn_t* h) {
+	int off = 0;
+	wce_h2_preface(h);
+	while (!h->dead && h->preface == WCE_H2_PREFACE_LEN && h->in_len - off >= 9) {
+		const unsigned char* f = (const unsigned char*)h->in + off;
+		int len = (f[0] << 16) | (f[1] << 8) | f[2];
+		if (len > WCE_H2_FRAME_MAX) {
+			wce_h2_fail(h, WCE_H2_FRAME_SIZE_ERROR);
+			break;
+		}
+		if (h->in_len - off < 9 + len) break;
+		wce_h2_frame(h, f[3], f[4], wce_h2_u32(f + 5) & 0x7FFFFFFF, f + 9, len);
+		for (int i = 0; i < WCE_H2_MAX_STREAMS && h->open; i++) {
+			if (h->streams[i].id && h->streams[i].reset) wce_h2_stream_close(h, &h->streams[i]);
+		}
+		off += 9 + len;
+	}
+	if (off) {
+		memmove(h->in, h->in + off, (size_t)(h->in_len - off));
+		h->in_len -= off;
+	}
+	if (!h->dead) wce_h2_credit(h);
+	wce_h2_flush(h);
+}
+
+// Switches a connection to HTTP/2 with `data` as the first received bytes
+// and queues the server SETTINGS.
+static wce_h2_conn_t* wce_h2_open(wce_server_t* srv, wce_client_t* c, const char* data, int len) {
+	wce_h2_conn_t* h = (wce_h2_conn_t*)calloc(1, sizeof(wce_h2_conn_t));
+	if (!h) return NULL;
+	h->in = (char*)malloc(WCE_H2_IN_CAP);
+	h->out = (unsigned char*)malloc(WCE_H2_OUT_CAP);
+	if (!h->in || !h->out || len > WCE_H2_IN_CAP) {
+		free(h->in);
+		free(h->out);
+		free(h);
+		return NULL;
+	}
+	h->srv = srv;
+	h->fd = c->fd;
+	h->conn = (int)(c - srv->clients);
+	h->table_max = WCE_H2_TABLE_MAX;
+	h->send_window = WCE_H2_WINDOW;
+	h->initial_window = WCE_H2_WINDOW;
+	memcpy(h->in, data, (size_t)len);
+	h->in_len = len;
+	c->h2 = h;
+
+	// Frames are assembled in the output buffer, so Nagle only adds latency
+	int one = 1;
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+
+	static const unsigned char settings[] = {
+		0x00, 0x03, 0x00, 0x00, 0x00, WCE_H2_MAX_STREAMS,          // MAX_CONCURRENT_STREAMS
+		0x00, 0x06, 0x00, 0x00, BUFFER_SIZE >> 8, BUFFER_SIZE & 0xFF // MAX_HEADER_LIST_SIZE
+	};
+	unsigned char* p = wce_h2_frame_begin(h, (int)sizeof(settings));
+	memcpy(p, settings, sizeof(settings));
+	wce_h2_frame_end(h, WCE_H2_SETTINGS, 0, 0, (int)sizeof(settings));
+	return h;
+}
+
+static void wce_h2_free(wce_h2_conn_t* h) {
+	if (!h) return;
+	for (int i = 0; i < WCE_H2_MAX_STREAMS && h->open; i++) {
+		if (h->streams[i].id) wce_h2_stream_close(h, &h->streams[i]);
+	}
+	wce_hpack_evict(h, -1);
+	free(h->in);
+	free(h->out);
+	free(h->block);
+	free(h->fields);
+	free(h);
+}
+
+// Processes what has been received; closes the connection on a connection
+// error or once the client has sent GOAWAY and no stream is left.
+static void wce_h2_pump(wce_server_t* srv, int index) {
+	wce_h2_conn_t* h = srv->clients[index].h2;
+	wce_h2_process(h);
+	if (h->dead || (h->goaway && !h->open)) wce_client_close(srv, index);
+}
+
+// Prior knowledge: the request head that arrived is the preface itself.
+static void wce_h2_start(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	if (!wce_h2_open(srv, c, c->buffer, c->buf_len)) {
+		wce_reset_client(srv, index);
 		return;
 	}
+	wce_buf_free(c->buffer);
+	c->buffer = NULL;
+	c->buf_cap = 0;
+	c->buf_len = 0;
+	wce_h2_pump(srv, index);
+}
 
-	// API: Event Trigger
-	if (strncmp(path, "/api/trigger", 12) == 0 && strcmp(method, "POST") == 0) {
-		char* q = strchr(path, '?');
-		if (q) {
-			char* event_param = strstr(q, "event=");
-			if (event_param) {
-				char* event_name = event_param + 6;
-				char* end = strchr(event_name, '&');
-				if (end) *end = '\0';
-				char* arg = "";
-				char* arg_param = strstr(q, "arg=");
-				if (arg_param) {
-					arg = arg_param + 4;
-					char* end_arg = strchr(arg, '&');
-					if (end_arg) *end_arg = '\0';
-				}
-				wce_dispatch_event(event_name, arg);
-				send_response(c->fd, "200 OK", "text/plain", "OK", 2);
-				return;
-			}
+static void wce_h2_readable(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	wce_h2_conn_t* h = c->h2;
+	for (int i = 0; i < WCE_BODY_READS_PER_WAKE; i++) {
+		WCE_TRACE_BEGIN(recv);
+		int bytes = recv(c->fd, h->in + h->in_len, WCE_H2_IN_CAP - h->in_len, 0);
+		WCE_TRACE_END(recv, "recv");
+		if (bytes < 0 && wce_get_error() == WCE_EAGAIN) return;
+		if (bytes <= 0) {
+			wce_reset_client(srv, index);
+			return;
 		}
-		send_response(c->fd, "400 Bad Request", "text/plain", "Missing event param", 19);
-		return;
+		h->in_len += bytes;
+		wce_h2_pump(srv, index);
+		if (!c->active || c->h2 != h) return;
 	}
+}
 
-	// Static Assets
-	const char* file_path = path;
-	if (strcmp(path, "/") == 0) file_path = "/index.html";
+static int wce_base64url_decode(const char* s, unsigned char* out, int cap) {
+	unsigned acc = 0;
+	int bits = 0, n = 0;
+	for (; *s && *s != '='; s++) {
+		int v;
+		if (*s >= 'A' && *s <= 'Z') v = *s - 'A';
+		else if (*s >= 'a' && *s <= 'z') v = *s - 'a' + 26;
+		else if (*s >= '0' && *s <= '9') v = *s - '0' + 52;
+		else if (*s == '-' || *s == '+') v = 62;
+		else if (*s == '_' || *s == '/') v = 63;
+		else return -1;
+		acc = (acc << 6) | (unsigned)v;
+		bits += 6;
+		if (bits >= 8) {
+			bits -= 8;
+			if (n >= cap) return -1;
+			out[n++] = (unsigned char)(acc >> bits);
+		}
+	}
+	return n;
+}
 
-	const char* search_paths[] = {
-		"web_root",
-		"./web_root",
-		"generated/web_root",
-		"../web_root",
-		"../../web_root",
-		NULL
-	};
+// "Upgrade: h2c" on a request without a body: answers 101, then serves the
+// request as stream 1. Returns -1 when the request is not an upgrade (it
+// is then served over HTTP/1.1), otherwise process_request()'s result.
+static int wce_h2_upgrade(wce_server_t* srv, int client_idx, wce_request_t* req) {
+	const char* upgrade = wce_req_header(req, "Upgrade");
+	const char* settings = wce_req_header(req, "HTTP2-Settings");
+	if (!upgrade || !settings) return -1;
+	int wanted = 0;
+	for (const char* t = upgrade; *t; ) {
+		while (*t == ' ' || *t == ',') t++;
+		size_t n = strcspn(t, " ,");
+		if (n == 3 && wce_ascii_ieq(t, "h2c", 3)) wanted = 1;
+		t += n;
+	}
+	const char* cl = wce_req_header(req, "Content-Length");
+	if (!wanted || wce_req_header(req, "Transfer-Encoding") || (cl && strcmp(cl, "0") != 0)) return -1;
+	unsigned char values[256];
+	int values_len = wce_base64url_decode(settings, values, (int)sizeof(values));
+	if (values_len < 0 || values_len % 6) return -1;
 
-	char full_path[512];
-	char* content = NULL;
-	size_t len = 0;
+	wce_client_t* c = &srv->clients[client_idx];
+	static const char switching[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+	if (wce_conn_send(srv, client_idx, switching, sizeof(switching) - 1) != 0) return 0;
+	wce_h2_conn_t* h = wce_h2_open(srv, c, c->buffer + c->head_len, c->buf_len - c->head_len);
+	if (!h) return 0;
+	wce_h2_settings(h, values, values_len); // Acknowledged by the 101 itself
+
+	char* head = c->buffer;
+	c->buffer = NULL;
+	c->buf_cap = 0;
+	c->buf_len = 0;
+	h->last_stream = 1;
+	wce_h2_run(h, 1, req, head, 1);
+	wce_h2_process(h);
+	return !h->dead && !(h->goaway && !h->open);
+}
+
+// --- Loop Wakeup ---
+// Lets other threads interrupt a poll that otherwise blocks until I/O:
+// an eventfd on Linux, a self-pipe on other POSIX systems and a connected
+// loopback UDP socket on Windows (select() there only accepts sockets).
+#ifdef __linux__
+static int wce_wakeup_open(wce_server_t* srv) {
+	srv->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	return srv->wakeup_fd < 0 ? -1 : 0;
+}
+
+static void wce_wakeup_signal(wce_server_t* srv) {
+	uint64_t one = 1;
+	if (srv->wakeup_fd >= 0 && write(srv->wakeup_fd, &one, sizeof(one)) < 0) { /* counter saturated: already pending */ }
+}
+
+static void wce_wakeup_drain(wce_server_t* srv) {
+	uint64_t count;
+	while (read(srv->wakeup_fd, &count, sizeof(count)) > 0) {}
+}
+
+static void wce_wakeup_close(wce_server_t* srv) {
+	if (srv->wakeup_fd >= 0) close(srv->wakeup_fd);
+	srv->wakeup_fd = -1;
+}
 
-	for (int i = 0; search_paths[i] != NULL; i++) {
-		snprintf(full_path, sizeof(full_path), "%s%s", search_paths[i], file_path);
-		content = read_file_content(full_path, &len);
-		if (content) break;
+#define WCE_WAKEUP_SOCKET (srv->wakeup_fd)
+#elif defined(_WIN32)
+static int wce_wakeup_open(wce_server_t* srv) {
+	struct sockaddr_in addr;
+	int addrlen = sizeof(addr);
+	srv->wakeup_sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (srv->wakeup_sock == WCE_INVALID_SOCKET) return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(srv->wakeup_sock, (struct sockaddr*)&addr, sizeof(addr)) == WCE_SOCKET_ERROR ||
+		getsockname(srv->wakeup_sock, (struct sockaddr*)&addr, &addrlen) == WCE_SOCKET_ERROR ||
+		connect(srv->wakeup_sock, (struct sockaddr*)&addr, sizeof(addr)) == WCE_SOCKET_ERROR) {
+		wce_close_socket(srv->wakeup_sock);
+		srv->wakeup_sock = WCE_INVALID_SOCKET;
+		return -1;
 	}
+	wce_set_nonblocking(srv->wakeup_sock);
+	return 0;
+}
 
-	if (content) {
-		const char* type = "text/plain";
-		if (strstr(path, ".html") || strcmp(path, "/") == 0) type = "text/html";
-		else if (strstr(path, ".css")) type = "text/css";
-		else if (strstr(path, ".js")) type = "application/javascript";
-		send_response(c->fd, "200 OK", type, content, len);
-		free(content);
-		return;
+static void wce_wakeup_signal(wce_server_t* srv) {
+	if (srv->wakeup_sock != WCE_INVALID_SOCKET) send(srv->wakeup_sock, "w", 1, 0);
+}
+
+static void wce_wakeup_drain(wce_server_t* srv) {
+	char tmp[64];
+	while (recv(srv->wakeup_sock, tmp, sizeof(tmp), 0) > 0) {}
+}
+
+static void wce_wakeup_close(wce_server_t* srv) {
+	if (srv->wakeup_sock != WCE_INVALID_SOCKET) wce_close_socket(srv->wakeup_sock);
+	srv->wakeup_sock = WCE_INVALID_SOCKET;
+}
+
+#define WCE_WAKEUP_SOCKET (srv->wakeup_sock)
+#else
+static int wce_wakeup_open(wce_server_t* srv) {
+	if (pipe(srv->wakeup_pipe) != 0) return -1;
+	wce_set_nonblocking(srv->wakeup_pipe[0]);
+	wce_set_nonblocking(srv->wakeup_pipe[1]);
+	fcntl(srv->wakeup_pipe[0], F_SETFD, FD_CLOEXEC);
+	fcntl(srv->wakeup_pipe[1], F_SETFD, FD_CLOEXEC);
+	return 0;
+}
+
+static void wce_wakeup_signal(wce_server_t* srv) {
+	if (srv->wakeup_pipe[1] >= 0 && write(srv->wakeup_pipe[1], "w", 1) < 0) { /* pipe full: already pending */ }
+}
+
+static void wce_wakeup_drain(wce_server_t* srv) {
+	char tmp[64];
+	while (read(srv->wakeup_pipe[0], tmp, sizeof(tmp)) > 0) {}
+}
+
+static void wce_wakeup_close(wce_server_t* srv) {
+	for (int i = 0; i < 2; i++) {
+		if (srv->wakeup_pipe[i] >= 0) close(srv->wakeup_pipe[i]);
+		srv->wakeup_pipe[i] = -1;
 	}
+}
 
-	// Embedded fallback for include-only usage
-	if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0) {
-		char* html = wce_render_dom();
-		send_response(c->fd, "200 OK", "text/html", html, strlen(html));
-		free(html);
-		return;
+#define WCE_WAKEUP_SOCKET (srv->wakeup_pipe[0])
+#endif
+
+// --- Event Poller ---
+// epoll on Linux; elsewhere a select() scan over the connection table.
+// Ready sources are reported as client indices, WCE_POLL_LISTENER or
+// WCE_POLL_WAKEUP.
+#define WCE_POLL_LISTENER -1
+#define WCE_POLL_WAKEUP   -2
+#define WCE_POLL_BATCH 64
+
+// Accepts one pending connection from the listener, or returns
+// WCE_INVALID_SOCKET when there is none.
+static wce_socket_t wce_accept_one(wce_server_t* srv) {
+	struct sockaddr_storage addr;  // AF_INET or AF_UNIX listener
+	#ifdef _WIN32
+		int addrlen = sizeof(addr);
+	#else
+		socklen_t addrlen = sizeof(addr);
+	#endif
+	return accept(srv->listen_fd, (struct sockaddr*)&addr, &addrlen);
+}
+
+#ifdef __linux__
+static int wce_poll_init(wce_server_t* srv) {
+	srv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (srv->epoll_fd < 0) return -1;
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = UINT32_MAX;
+	if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->listen_fd, &ev) != 0) return -1;
+	ev.data.u32 = UINT32_MAX - 1;
+	return epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, WCE_WAKEUP_SOCKET, &ev);
+}
+
+static int wce_poll_add(wce_server_t* srv, wce_socket_t fd, int index) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = (uint32_t)index;
+	return epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// Changes what a connection waits for
+static void wce_poll_watch(wce_server_t* srv, int index, int watch) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (watch & WCE_WATCH_READ ? EPOLLIN : 0) | (watch & WCE_WATCH_WRITE ? EPOLLOUT : 0);
+	ev.data.u32 = (uint32_t)index;
+	epoll_ctl(srv->epoll_fd, EPOLL_CTL_MOD, srv->clients[index].fd, &ev);
+}
+
+static int wce_poll_wait(wce_server_t* srv, int* ready, int max, int timeout_ms) {
+	struct epoll_event events[WCE_POLL_BATCH];
+	if (max > WCE_POLL_BATCH) max = WCE_POLL_BATCH;
+	int n = epoll_wait(srv->epoll_fd, events, max, timeout_ms);
+	for (int i = 0; i < n; i++) {
+		uint32_t id = events[i].data.u32;
+		ready[i] = id == UINT32_MAX ? WCE_POLL_LISTENER : id == UINT32_MAX - 1 ? WCE_POLL_WAKEUP : (int)id;
 	}
+	return n < 0 ? 0 : n;
+}
 
-	send_response(c->fd, "404 Not Found", "text/plain", "Not Found", 9);
+static void wce_poll_close(wce_server_t* srv) {
+	if (srv->epoll_fd >= 0) close(srv->epoll_fd);
+	srv->epoll_fd = -1;
 }
 
-void server_loop(void) {
-	while (is_running) {
-		fd_set readfds;
-		FD_ZERO(&readfds);
-		FD_SET(server_fd, &readfds);
-		wce_socket_t max_fd = server_fd;
+static const char* wce_poll_backend(wce_server_t* srv) { (void)srv; return "epoll"; }
+#else
+static int wce_poll_init(wce_server_t* srv) { (void)srv; return 0; }
 
-		for (int i = 0; i < MAX_CLIENTS; i++) {
-			if (clients[i].active) {
-				FD_SET(clients[i].fd, &readfds);
-				if (clients[i].fd > max_fd) max_fd = clients[i].fd;
-			}
+static int wce_poll_add(wce_server_t* srv, wce_socket_t fd, int index) { (void)srv; (void)fd; (void)index; return 0; }
+
+static void wce_poll_watch(wce_server_t* srv, int index, int watch) { (void)srv; (void)index; (void)watch; }
+
+static int wce_poll_wait(wce_server_t* srv, int* ready, int max, int timeout_ms) {
+	fd_set readfds, writefds;
+	FD_ZERO(&readfds);
+	FD_ZERO(&writefds);
+	FD_SET(srv->listen_fd, &readfds);
+	FD_SET(WCE_WAKEUP_SOCKET, &readfds);
+	wce_socket_t max_fd = srv->listen_fd > WCE_WAKEUP_SOCKET ? srv->listen_fd : WCE_WAKEUP_SOCKET;
+
+	for (int i = 0; i < srv->client_cap; i++) {
+		if (srv->clients[i].active) {
+			if (srv->clients[i].watch & WCE_WATCH_READ) FD_SET(srv->clients[i].fd, &readfds);
+			if (srv->clients[i].watch & WCE_WATCH_WRITE) FD_SET(srv->clients[i].fd, &writefds);
+			if (srv->clients[i].fd > max_fd) max_fd = srv->clients[i].fd;
+		}
+	}
+
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+	if (select((int)max_fd + 1, &readfds, &writefds, NULL, timeout_ms < 0 ? NULL : &tv) <= 0) return 0;
+
+	int n = 0;
+	if (FD_ISSET(WCE_WAKEUP_SOCKET, &readfds)) ready[n++] = WCE_POLL_WAKEUP;
+	if (FD_ISSET(srv->listen_fd, &readfds)) ready[n++] = WCE_POLL_LISTENER;
+	for (int i = 0; i < srv->client_cap && n < max; i++) {
+		if (srv->clients[i].active && (FD_ISSET(srv->clients[i].fd, &readfds) || FD_ISSET(srv->clients[i].fd, &writefds))) {
+			ready[n++] = i;
 		}
+	}
+	return n;
+}
+
+static void wce_poll_close(wce_server_t* srv) { (void)srv; }
+
+static const char* wce_poll_backend(wce_server_t* srv) { (void)srv; return "select"; }
+#endif
 
-		struct timeval tv;
-		tv.tv_sec = 0;
-		tv.tv_usec = 100000;
+// Accepts every pending connection. When the connection table is full the
+// client gets an explicit 503 and a clean close instead of a leaked socket.
+static void wce_accept_clients(wce_server_t* srv) {
+	for (;;) {
+		WCE_TRACE_BEGIN(accept);
+		wce_socket_t client_fd = wce_accept_one(srv);
+		WCE_TRACE_END(accept, "accept");
+		if (client_fd == WCE_INVALID_SOCKET) return;
 
-		int activity = select((int)max_fd + 1, &readfds, NULL, NULL, &tv);
-		if (activity < 0) {
+		wce_set_nonblocking(client_fd);
+		if (srv->cfg.tcp_nodelay > 0) {
+			int one = 1;
+			setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+		}
+		int index = wce_client_alloc(srv, client_fd);
+		if (index < 0 || wce_poll_add(srv, client_fd, index) != 0) {
+			send_response(client_fd, "503 Service Unavailable", "text/plain", "Too many connections", 20);
+			if (index >= 0) wce_reset_client(srv, index);
+			else wce_close_socket(client_fd);
 			continue;
 		}
+		// The whole head must arrive in time, however slowly it trickles in
+		wce_timer_arm(srv, index, srv->cfg.header_timeout_ms);
+	}
+}
 
-		if (FD_ISSET(server_fd, &readfds)) {
-			struct sockaddr_in addr;
-			#ifdef _WIN32
-				int addrlen = sizeof(addr);
-			#else
-				socklen_t addrlen = sizeof(addr);
-			#endif
-			wce_socket_t client_fd = accept(server_fd, (struct sockaddr*)&addr, &addrlen);
-			if (client_fd != WCE_INVALID_SOCKET) {
-				wce_set_nonblocking(client_fd);
-				for (int i = 0; i < MAX_CLIENTS; i++) {
-					if (!clients[i].active) {
-						clients[i].fd = client_fd;
-						clients[i].buf_len = 0;
-						clients[i].active = 1;
-						break;
-					}
-				}
+// Deadline once the head is in: body data must keep arriving while a body
+// streams, an HTTP/2 connection is dropped after idling, and queued output
+// has to drain by its write deadline, whichever comes first.
+static void wce_client_deadline(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	int timeout_ms = c->req ? srv->cfg.body_timeout_ms : srv->cfg.idle_timeout_ms;
+	if (c->h2 && c->h2->open) timeout_ms = srv->cfg.body_timeout_ms;
+	if (c->closing) timeout_ms = -1;
+	srv->loop_ms = wce_now_ms(); // Handlers ran since the poll returned
+	uint64_t due = c->out_sent < c->out_len ? c->out_due : 0;
+	if (!c->closing && c->h2 && c->h2->parked && (!due || c->h2->parked_due < due)) due = c->h2->parked_due;
+	if (due) {
+		uint64_t left = due > srv->loop_ms ? due - srv->loop_ms : 0;
+		if (timeout_ms < 0 || left < (uint64_t)timeout_ms) timeout_ms = (int)left;
+	}
+	wce_timer_arm(srv, index, timeout_ms);
+}
+
+// A deadline passed: answers 408 where a request is pending (or GOAWAY on
+// HTTP/2, also when parked DATA stalled) and reclaims the slot. A
+// connection that never sent anything is closed silently, browsers open
+// spare connections ahead of time, and one whose output stalled is closed
+// right away.
+static void wce_client_expire(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	if (c->out_sent < c->out_len) {
+		// Reset rather than close: the kernel would keep feeding the client
+		struct linger lg = { 1, 0 };
+		setsockopt(c->fd, SOL_SOCKET, SO_LINGER, (const char*)&lg, sizeof(lg));
+		wce_reset_client(srv, index);
+		return;
+	}
+	if (c->h2) wce_h2_fail(c->h2, WCE_H2_NO_ERROR);
+	else if (c->req) wce_respond(c->req, 408, "text/plain", "Request Timeout", 15);
+	else if (c->buf_len) wce_send_response(srv, index, 408, "408 Request Timeout", "text/plain", "Request Timeout", 15, NULL);
+	wce_client_close(srv, index);
+}
+
+// Streams body data straight from the socket to the route's body handler,
+// a bounded number of receive buffers per readiness event.
+static void wce_client_body(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	wce_request_t* req = c->req;
+	if (!req->body_buf) {
+		req->body_buf = wce_buf_alloc(srv, BUFFER_SIZE, &req->body_cap);
+		if (!req->body_buf) {
+			wce_reset_client(srv, index);
+			return;
+		}
+	}
+	for (int i = 0; i < WCE_BODY_READS_PER_WAKE; i++) {
+		WCE_TRACE_BEGIN(recv);
+		int bytes = recv(c->fd, req->body_buf, req->body_cap, 0);
+		WCE_TRACE_END(recv, "recv");
+		if (bytes < 0 && wce_get_error() == WCE_EAGAIN) return;
+		if (bytes <= 0) {
+			wce_reset_client(srv, index);
+			return;
+		}
+		if (wce_body_feed(req, req->body_buf, (size_t)bytes)) {
+			wce_client_close(srv, index);
+			return;
+		}
+	}
+}
+
+// Reads what is available and processes the request once its header has
+// fully arrived. The buffer is taken from the pool on first read and moves
+// up a size class whenever it fills, up to max_header_size bytes of head.
+static void wce_client_readable(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	if (c->h2 || c->req) {
+		if (c->h2) wce_h2_readable(srv, index);
+		else wce_client_body(srv, index);
+		if (c->active) wce_client_deadline(srv, index);
+		return;
+	}
+	for (;;) {
+		if (c->buf_len + 1 >= c->buf_cap || c->buf_len >= srv->cfg.max_header_size) {
+			int cap = 0;
+			char* grown = c->buf_len < srv->cfg.max_header_size ? wce_buf_alloc(srv, c->buf_cap + 1, &cap) : NULL;
+			if (!grown) {
+				wce_send_response(srv, index, 431, "431 Request Header Fields Too Large", "text/plain",
+					"Request too large", 17, NULL);
+				wce_client_close(srv, index);
+				return;
+			}
+			if (c->buffer) {
+				memcpy(grown, c->buffer, (size_t)c->buf_len);
+				wce_buf_free(c->buffer);
 			}
+			c->buffer = grown;
+			c->buf_cap = cap;
 		}
 
-		for (int i = 0; i < MAX_CLIENTS; i++) {
-			if (!clients[i].active) continue;
-			if (!FD_ISSET(clients[i].fd, &readfds)) continue;
+		int room = c->buf_cap - 1 - c->buf_len;
+		if (c->buf_len + room > srv->cfg.max_header_size) room = srv->cfg.max_header_size - c->buf_len;
+		WCE_TRACE_BEGIN(recv);
+		int bytes = recv(c->fd, c->buffer + c->buf_len, room, 0);
+		WCE_TRACE_END(recv, "recv");
+		if (bytes < 0 && wce_get_error() == WCE_EAGAIN) return;
+		if (bytes <= 0) {
+			wce_reset_client(srv, index);
+			return;
+		}
 
-			int bytes = recv(clients[i].fd, clients[i].buffer, BUFFER_SIZE - 1, 0);
-			if (bytes <= 0) {
-				wce_reset_client(i);
-				continue;
+		int scan_from = c->buf_len > 3 ? c->buf_len - 3 : 0;
+		c->buf_len += bytes;
+		c->buffer[c->buf_len] = '\0';
+		char* blank = strstr(c->buffer + scan_from, "\r\n\r\n");
+		if (blank) {
+			c->head_len = (int)(blank + 4 - c->buffer);
+			if (c->head_len == 18 && memcmp(c->buffer, WCE_H2_PREFACE, 18) == 0) {
+				wce_h2_start(srv, index);
+				if (c->active) wce_client_deadline(srv, index);
+				return;
 			}
-			clients[i].buf_len = bytes;
-			process_request(i);
-			wce_reset_client(i);
+			WCE_TRACE_BEGIN(request);
+			int streaming = process_request(srv, index);
+			WCE_TRACE_END(request, "process_request");
+			if (!streaming) wce_client_close(srv, index);
+			else wce_client_deadline(srv, index);
+			return;
+		}
+	}
+}
+
+// A poller event: queued output goes out first, then what arrived is read.
+static void wce_client_ready(wce_server_t* srv, int index) {
+	wce_client_t* c = &srv->clients[index];
+	if (c->out_sent < c->out_len) {
+		wce_conn_writable(srv, index);
+		if (!c->active || c->closing) return;
+	}
+	if (c->watch & WCE_WATCH_READ) wce_client_readable(srv, index);
+}
+
+static void server_loop(wce_server_t* srv) {
+	int ready[WCE_POLL_BATCH];
+	if (wce_poll_init(srv) != 0) return;
+	wce_timers_init(srv);
+
+	while (srv->running) {
+		int n = wce_poll_wait(srv, ready, WCE_POLL_BATCH, wce_timers_wait_ms(srv));
+		srv->loop_ms = wce_now_ms();
+		for (int i = 0; i < n && srv->running; i++) {
+			if (ready[i] == WCE_POLL_WAKEUP) wce_wakeup_drain(srv);
+			else if (ready[i] == WCE_POLL_LISTENER) wce_accept_clients(srv);
+			else if (srv->clients[ready[i]].active) wce_client_ready(srv, ready[i]);
 		}
+		if (srv->running) wce_timers_run(srv);
+	}
+
+	for (int i = 0; i < srv->client_cap; i++) {
+		if (srv->clients[i].active) wce_reset_client(srv, i);
 	}
+	wce_poll_close(srv);
 }
 
+// The server thread makes its instance current, so handlers and callbacks
+// reach it through the plain wce_* API.
 #ifdef _WIN32
-unsigned __stdcall server_thread(void* arg) {
-	(void)arg;
-	server_loop();
+static unsigned __stdcall server_thread(void* arg) {
+	wce_current = (wce_server_t*)arg;
+	server_loop(wce_current);
 	return 0;
 }
 #else
-void* server_thread(void* arg) {
-	(void)arg;
-	server_loop();
+static void* server_thread(void* arg) {
+	wce_current = (wce_server_t*)arg;
+	server_loop(wce_current);
 	return NULL;
 }
 #endif
 
-int wce_init(int port) {
-	server_port = port;
+// --- Configuration ---
+// Fields of wce_config_t left at 0 / NULL take the defaults in
+// WCE_CONFIG_DEFAULTS. The whole configuration is checked before anything is
+// bound, so a bad value fails wce_init_ex() rather than showing up under load.
+static int wce_config_resolve(const wce_config_t* in, wce_config_t* out) {
+	static const wce_config_t defaults = WCE_CONFIG_DEFAULTS;
+	if (!in) return -1;
+	*out = *in;
+	if (!out->bind_addr) out->bind_addr = "0.0.0.0";
+	if (!out->backlog) out->backlog = defaults.backlog;
+	if (!out->max_connections) out->max_connections = defaults.max_connections;
+	if (!out->max_header_size) out->max_header_size = defaults.max_header_size;
+	if (!out->max_kv_entries) out->max_kv_entries = defaults.max_kv_entries;
+	if (!out->send_timeout_ms) out->send_timeout_ms = defaults.send_timeout_ms;
+	if (!out->header_timeout_ms) out->header_timeout_ms = defaults.header_timeout_ms;
+	if (!out->body_timeout_ms) out->body_timeout_ms = defaults.body_timeout_ms;
+	if (!out->idle_timeout_ms) out->idle_timeout_ms = defaults.idle_timeout_ms;
+	if (!out->tcp_nodelay) out->tcp_nodelay = defaults.tcp_nodelay;
+
+	if (out->port < 0 || out->port > 65535 || out->backlog < 0) return -1;
+	if (out->max_connections < 0 || out->max_connections > MAX_CLIENTS) return -1;
+	if (out->max_header_size < 1024 || out->max_header_size > BUFFER_SIZE) return -1;
+	if (out->max_body_size < 0 || out->max_kv_entries < 0 || out->send_timeout_ms < 0) return -1;
+	if (out->header_timeout_ms < -1 || out->body_timeout_ms < -1 || out->idle_timeout_ms < -1) return -1;
+	if (out->defer_accept < 0) return -1;
+#if defined(_WIN32) || !defined(SO_REUSEPORT)
+	if (out->reuse_port > 0) return -1;
+#endif
+	if (out->unix_path) {
+		// TCP-only options
+		out->tcp_nodelay = -1;
+		out->defer_accept = 0;
+		out->reuse_port = 0;
+	}
+	return 0;
+}
 
-	for (int i = 0; i < MAX_CLIENTS; i++) {
-		clients[i].fd = WCE_INVALID_SOCKET;
-		clients[i].buf_len = 0;
-		clients[i].active = 0;
+// Shared tail of the wce_init variants: listen and switch to non-blocking.
+static int wce_listen(wce_server_t* srv) {
+	if (listen(srv->listen_fd, srv->cfg.backlog) == WCE_SOCKET_ERROR) {
+		wce_close_socket(srv->listen_fd);
+		srv->listen_fd = WCE_INVALID_SOCKET;
+		return -1;
 	}
 
+	wce_set_nonblocking(srv->listen_fd);
+	return 0;
+}
+
+// Binds bind_addr:port (IPv4 or IPv6 literal) with the configured socket
+// options. TCP_DEFER_ACCEPT keeps a connection out of accept() until its
+// first data arrives, so idle connects never take a slot.
+static int wce_bind_tcp(wce_server_t* srv) {
 #ifdef _WIN32
 	WSADATA wsaData;
 	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
@@ -703,106 +5001,451 @@ int wce_init(int port) {
 	}
 #endif
 
-	server_fd = socket(AF_INET, SOCK_STREAM, 0);
-	if (server_fd == WCE_INVALID_SOCKET) return -1;
+	char port[8];
+	struct addrinfo hints;
+	struct addrinfo* ai = NULL;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;
+	snprintf(port, sizeof(port), "%d", srv->cfg.port);
+	if (getaddrinfo(srv->cfg.bind_addr, port, &hints, &ai) != 0) return -1;
+
+	srv->listen_fd = socket(ai->ai_family, SOCK_STREAM, 0);
+	if (srv->listen_fd == WCE_INVALID_SOCKET) {
+		freeaddrinfo(ai);
+		return -1;
+	}
 
 	int opt = 1;
-	#ifdef _WIN32
-		setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
-	#else
-		setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-	#endif
+	int failed = 0;
+	setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+#if !defined(_WIN32) && defined(SO_REUSEPORT)
+	if (srv->cfg.reuse_port > 0) {
+		failed = setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) != 0;
+	}
+#endif
+#ifdef TCP_DEFER_ACCEPT
+	if (srv->cfg.defer_accept > 0) {
+		setsockopt(srv->listen_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &srv->cfg.defer_accept, sizeof(int));
+	}
+#endif
+
+	if (failed || bind(srv->listen_fd, ai->ai_addr, (socklen_t)ai->ai_addrlen) == WCE_SOCKET_ERROR) {
+		freeaddrinfo(ai);
+		wce_close_socket(srv->listen_fd);
+		srv->listen_fd = WCE_INVALID_SOCKET;
+		return -1;
+	}
+	freeaddrinfo(ai);
+
+	return wce_listen(srv);
+}
+
+// Listens on a Unix domain socket, e.g. behind a local reverse proxy. A
+// leading '@' selects the Linux abstract namespace (no file, no mode). The
+// mode is applied before listen(), so no connection can get in under the
+// umask-derived permissions.
+static int wce_bind_unix(wce_server_t* srv, const char* path, int mode) {
+#ifdef _WIN32
+	(void)srv;
+	(void)path;
+	(void)mode;
+	return -1;
+#else
+	struct sockaddr_un address;
+	size_t path_len = strlen(path);
+	if (path_len == 0 || path_len >= sizeof(address.sun_path)) return -1;
+	int abstract = path[0] == '@';
+#ifndef __linux__
+	if (abstract) return -1;
+#endif
 
-	struct sockaddr_in address;
 	memset(&address, 0, sizeof(address));
-	address.sin_family = AF_INET;
-	address.sin_addr.s_addr = htonl(INADDR_ANY);
-	address.sin_port = htons((unsigned short)server_port);
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path, path, path_len);
+	socklen_t address_len = (socklen_t)sizeof(address);
+	if (abstract) {
+		address.sun_path[0] = '\0';
+		address_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + path_len);
+	} else {
+		// Replace a socket file left behind by a previous run, nothing else
+		struct stat st;
+		if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+	}
+
+	srv->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (srv->listen_fd == WCE_INVALID_SOCKET) return -1;
 
-	if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) == WCE_SOCKET_ERROR) {
-		wce_close_socket(server_fd);
-		server_fd = WCE_INVALID_SOCKET;
+	if (bind(srv->listen_fd, (struct sockaddr*)&address, address_len) == WCE_SOCKET_ERROR) {
+		wce_close_socket(srv->listen_fd);
+		srv->listen_fd = WCE_INVALID_SOCKET;
 		return -1;
 	}
-
-	if (listen(server_fd, 16) == WCE_SOCKET_ERROR) {
-		wce_close_socket(server_fd);
-		server_fd = WCE_INVALID_SOCKET;
+	if (!abstract && mode && chmod(path, (mode_t)mode) != 0) {
+		wce_close_socket(srv->listen_fd);
+		srv->listen_fd = WCE_INVALID_SOCKET;
+		unlink(path);
 		return -1;
 	}
+	if (!abstract) memcpy(srv->unix_path, path, path_len + 1);
 
-	wce_set_nonblocking(server_fd);
+	if (wce_listen(srv) != 0) {
+		if (!abstract) unlink(path);
+		srv->unix_path[0] = '\0';
+		return -1;
+	}
 	return 0;
+#endif
 }
 
-int wce_start(void) {
-	if (server_fd == WCE_INVALID_SOCKET) return -1;
-	if (is_running) return 0;
-	is_running = 1;
+int wce_server_init_ex(wce_server_t* srv, const wce_config_t* config) {
+	wce_config_t cfg;
+	if (!srv || srv->running || wce_config_resolve(config, &cfg) != 0) return -1;
+	srv->cfg = cfg;
+	srv->port = cfg.unix_path ? 0 : cfg.port;
+	wce_routes_init(srv);
+
+	int rc = cfg.unix_path ? wce_bind_unix(srv, cfg.unix_path, cfg.unix_mode) : wce_bind_tcp(srv);
+	// Borrowed from the caller, only needed while binding
+	srv->cfg.bind_addr = NULL;
+	srv->cfg.unix_path = NULL;
+	return rc;
+}
+
+int wce_init_ex(const wce_config_t* cfg) {
+	return wce_server_init_ex(wce_self(), cfg);
+}
+
+int wce_server_init(wce_server_t* srv, int port) {
+	wce_config_t cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.port = port;
+	return wce_server_init_ex(srv, &cfg);
+}
+
+int wce_init(int port) {
+	return wce_server_init(wce_self(), port);
+}
+
+int wce_server_init_unix(wce_server_t* srv, const char* path, int mode) {
+	wce_config_t cfg;
+	if (!path) return -1;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.unix_path = path;
+	cfg.unix_mode = mode;
+	return wce_server_init_ex(srv, &cfg);
+}
+
+int wce_init_unix(const char* path, int mode) {
+	return wce_server_init_unix(wce_self(), path, mode);
+}
+
+int wce_server_start(wce_server_t* srv) {
+	if (srv->listen_fd == WCE_INVALID_SOCKET) return -1;
+	if (srv->running) return 0;
+	if (wce_wakeup_open(srv) != 0) return -1;
+	// Shared read-only HPACK tables, built before any server thread can race on them
+	if (!wce_huff_ready) wce_huff_init();
+	srv->running = 1;
 
 #ifdef _WIN32
-	uintptr_t handle = _beginthreadex(NULL, 0, server_thread, NULL, 0, NULL);
-	if (!handle) { is_running = 0; return -1; }
-	CloseHandle((HANDLE)handle);
+	unsigned thread_id = 0;
+	uintptr_t handle = _beginthreadex(NULL, 0, server_thread, srv, 0, &thread_id);
+	if (!handle) { srv->running = 0; wce_wakeup_close(srv); return -1; }
+	srv->thread = (HANDLE)handle;
+	srv->thread_id = (DWORD)thread_id;
 #else
-	pthread_t thread;
-	if (pthread_create(&thread, NULL, server_thread, NULL) != 0) { is_running = 0; return -1; }
-	pthread_detach(thread);
+	if (pthread_create(&srv->thread, NULL, server_thread, srv) != 0) {
+		srv->running = 0;
+		wce_wakeup_close(srv);
+		return -1;
+	}
 #endif
 	return 0;
 }
 
-void wce_stop(void) {
-	is_running = 0;
-	if (server_fd != WCE_INVALID_SOCKET) {
-		wce_close_socket(server_fd);
-		server_fd = WCE_INVALID_SOCKET;
+int wce_start(void) {
+	return wce_server_start(wce_self());
+}
+
+// Wakes the loop and waits for the server thread to exit before releasing
+// the listening socket. Called from inside a handler, the loop exits after
+// the handler returns and the thread is detached instead of joined.
+void wce_server_stop(wce_server_t* srv) {
+	int was_running = srv->running;
+	srv->running = 0;
+
+	if (was_running) {
+		wce_wakeup_signal(srv);
+#ifdef _WIN32
+		if (GetCurrentThreadId() != srv->thread_id) {
+			WaitForSingleObject(srv->thread, INFINITE);
+		}
+		CloseHandle(srv->thread);
+		srv->thread = NULL;
+#else
+		if (pthread_equal(pthread_self(), srv->thread)) {
+			pthread_detach(srv->thread);
+			return;
+		}
+		pthread_join(srv->thread, NULL);
+#endif
+		wce_wakeup_close(srv);
+	}
+
+	if (srv->listen_fd != WCE_INVALID_SOCKET) {
+		wce_close_socket(srv->listen_fd);
+		srv->listen_fd = WCE_INVALID_SOCKET;
+	}
+#ifndef _WIN32
+	if (srv->unix_path[0]) {
+		unlink(srv->unix_path);
+		srv->unix_path[0] = '\0';
 	}
+#endif
 
 #ifdef _WIN32
 	WSACleanup();
 #endif
 }
 
-void wce_data_set(const char* key, const char* val) {
-	if (!key || !val) return;
-	for (int i = 0; i < kv_count; i++) {
-		if (strcmp(kv_store[i].key, key) == 0) {
-			free(kv_store[i].value);
+void wce_stop(void) {
+	wce_server_stop(wce_self());
+}
+
+// Stops the server and releases everything it owns. Must not be called from
+// the server's own handlers. The default instance is only stopped.
+void wce_server_destroy(wce_server_t* srv) {
+	if (!srv) return;
+	wce_server_stop(srv);
+	if (srv == &wce_default_server) return;
+	if (wce_current == srv) wce_current = NULL;
+
+	free(srv->clients);
+	for (int cls = 0; cls < WCE_BUF_CLASSES; cls++) {
+		while (srv->slab_partial[cls]) {
+			wce_slab_t* slab = srv->slab_partial[cls];
+			srv->slab_partial[cls] = slab->next;
+			free(slab);
+		}
+	}
+	for (int i = 0; i < srv->route_node_count; i++) free(srv->route_nodes[i].param_name);
+	for (int i = 0; i < srv->route_edge_cap; i++) {
+		if (srv->route_edges[i].parent >= 0) free(srv->route_edges[i].segment);
+	}
+	free(srv->route_nodes);
+	free(srv->route_edges);
+	for (int i = 0; i < srv->func_count; i++) free(srv->func_registry[i].name);
+	for (int i = 0; i < srv->list_count; i++) free(srv->list_registry[i].name);
+	for (int i = 0; i < srv->kv_count; i++) {
+		free(srv->kv_store[i].key);
+		free(srv->kv_store[i].value);
+	}
+	free(srv->kv_store);
+	wce_mutex_destroy(&srv->kv_lock);
+	wce_snapshot_release(srv->data_snapshot[WCE_DATA_JSON]);
+	wce_snapshot_release(srv->data_snapshot[WCE_DATA_CBOR]);
+	wce_snapshot_release(srv->page_render);
+	wce_ui_clear(srv, 0);
+	free(srv);
+}
+
+// Sets `key` under kv_lock. Returns with the store unchanged when it is
+// full or out of memory.
+static void wce_kv_set(wce_server_t* srv, const char* key, const char* val) {
+	for (int i = 0; i < srv->kv_count; i++) {
+		if (strcmp(srv->kv_store[i].key, key) == 0) {
+			if (strcmp(srv->kv_store[i].value, val) == 0) return; // Keeps the snapshot valid
+			free(srv->kv_store[i].value);
 			#ifdef _WIN32
-				kv_store[i].value = _strdup(val);
+				srv->kv_store[i].value = _strdup(val);
 			#else
-				kv_store[i].value = strdup(val);
+				srv->kv_store[i].value = strdup(val);
 			#endif
+			srv->kv_version++;
 			return;
 		}
 	}
-	if (kv_count >= MAX_KV_STORE) return;
+	if (srv->kv_count >= srv->cfg.max_kv_entries) return;
+	if (srv->kv_count == srv->kv_cap) {
+		int new_cap = srv->kv_cap ? srv->kv_cap * 2 : 16;
+		if (new_cap > srv->cfg.max_kv_entries) new_cap = srv->cfg.max_kv_entries;
+		wce_kv_t* grown = (wce_kv_t*)realloc(srv->kv_store, sizeof(wce_kv_t) * (size_t)new_cap);
+		if (!grown) return;
+		srv->kv_store = grown;
+		srv->kv_cap = new_cap;
+	}
 	#ifdef _WIN32
-		kv_store[kv_count].key = _strdup(key);
-		kv_store[kv_count].value = _strdup(val);
+		srv->kv_store[srv->kv_count].key = _strdup(key);
+		srv->kv_store[srv->kv_count].value = _strdup(val);
 	#else
-		kv_store[kv_count].key = strdup(key);
-		kv_store[kv_count].value = strdup(val);
+		srv->kv_store[srv->kv_count].key = strdup(key);
+		srv->kv_store[srv->kv_count].value = strdup(val);
 	#endif
-	kv_count++;
+	srv->kv_count++;
+	srv->kv_version++;
 }
 
-const char* wce_data_get(const char* key) {
+void wce_server_data_set(wce_server_t* srv, const char* key, const char* val) {
+	if (!key || !val) return;
+	wce_mutex_lock(&srv->kv_lock);
+	wce_kv_set(srv, key, val);
+	wce_mutex_unlock(&srv->kv_lock);
+}
+
+void wce_data_set(const char* key, const char* val) {
+	wce_server_data_set(wce_self(), key, val);
+}
+
+// The value stays valid until `key` is next set.
+const char* wce_server_data_get(wce_server_t* srv, const char* key) {
 	if (!key) return NULL;
-	for (int i = 0; i < kv_count; i++) {
-		if (strcmp(kv_store[i].key, key) == 0) {
-			return kv_store[i].value;
+	const char* value = NULL;
+	wce_mutex_lock(&srv->kv_lock);
+	for (int i = 0; i < srv->kv_count; i++) {
+		if (strcmp(srv->kv_store[i].key, key) == 0) {
+			value = srv->kv_store[i].value;
+			break;
+		}
+	}
+	wce_mutex_unlock(&srv->kv_lock);
+	return value;
+}
+
+const char* wce_data_get(const char* key) {
+	return wce_server_data_get(wce_self(), key);
+}
+
+static void json_append_escaped(char** buf, size_t* cap, size_t* len, const char* str) {
+	static const char hex[] = "0123456789abcdef";
+	char esc[8];
+	const char* run = str;
+	for (const char* p = str; ; p++) {
+		unsigned char ch = (unsigned char)*p;
+		if (ch != '\0' && ch != '"' && ch != '\\' && ch >= 0x20) continue;
+		if (p > run) {
+			size_t n = (size_t)(p - run);
+			if (*len + n >= *cap) {
+				*cap = (*cap + n) * 2 + 4096;
+				*buf = (char*)realloc(*buf, *cap);
+			}
+			memcpy(*buf + *len, run, n);
+			*len += n;
+			(*buf)[*len] = '\0';
+		}
+		if (ch == '\0') break;
+		if (ch == '"' || ch == '\\') {
+			esc[0] = '\\'; esc[1] = (char)ch; esc[2] = '\0';
+		} else {
+			esc[0] = '\\'; esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+			esc[4] = hex[ch >> 4]; esc[5] = hex[ch & 0xF]; esc[6] = '\0';
+		}
+		str_append(buf, cap, len, esc);
+		run = p + 1;
+	}
+}
+
+char* wce_server_data_json(wce_server_t* srv, size_t* out_len) {
+	WCE_TRACE_BEGIN(json);
+	wce_mutex_lock(&srv->kv_lock);
+	size_t cap = 256 + (size_t)srv->kv_count * 64;
+	size_t len = 0;
+	char* buf = (char*)malloc(cap);
+	buf[0] = '\0';
+
+	str_append(&buf, &cap, &len, "{");
+	for (int i = 0; i < srv->kv_count; i++) {
+		str_append(&buf, &cap, &len, i > 0 ? ",\"" : "\"");
+		json_append_escaped(&buf, &cap, &len, srv->kv_store[i].key);
+		str_append(&buf, &cap, &len, "\":\"");
+		json_append_escaped(&buf, &cap, &len, srv->kv_store[i].value);
+		str_append(&buf, &cap, &len, "\"");
+	}
+	str_append(&buf, &cap, &len, "}");
+	wce_mutex_unlock(&srv->kv_lock);
+
+	if (out_len) *out_len = len;
+	WCE_TRACE_END(json, "json");
+	return buf;
+}
+
+char* wce_data_json(size_t* out_len) {
+	return wce_server_data_json(wce_self(), out_len);
+}
+
+char* wce_trace_json(size_t* out_len) {
+#ifdef WCE_TRACE
+	size_t cap = 4096;
+	size_t len = 0;
+	char* buf = (char*)malloc(cap);
+	char entry[256];
+	int first = 1;
+	buf[0] = '\0';
+
+	str_append(&buf, &cap, &len, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+#ifdef _MSC_VER
+	wce_trace_ring_t* r = trace_rings;
+#else
+	wce_trace_ring_t* r = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE);
+#endif
+	for (; r; r = r->next) {
+	#ifdef _MSC_VER
+		uint64_t head = r->head;
+		MemoryBarrier();
+	#else
+		uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	#endif
+		// The owner keeps writing while we read; skip the slots it may overwrite next.
+		uint64_t count = head < WCE_TRACE_RING_SIZE - 64 ? head : WCE_TRACE_RING_SIZE - 64;
+		snprintf(entry, sizeof(entry),
+			"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"webcee-%u\"}}",
+			first ? "" : ",", r->tid, r->tid);
+		str_append(&buf, &cap, &len, entry);
+		first = 0;
+		for (uint64_t i = head - count; i < head; i++) {
+			const wce_trace_span_t* sp = &r->spans[i & (WCE_TRACE_RING_SIZE - 1)];
+			snprintf(entry, sizeof(entry),
+				",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				sp->name, r->tid, (double)sp->begin_ns / 1000.0, (double)(sp->end_ns - sp->begin_ns) / 1000.0);
+			str_append(&buf, &cap, &len, entry);
 		}
 	}
+	str_append(&buf, &cap, &len, "]}");
+
+	if (out_len) *out_len = len;
+	return buf;
+#else
+	if (out_len) *out_len = 0;
 	return NULL;
+#endif
+}
+
+int wce_trace_dump(const char* path) {
+	size_t len = 0;
+	char* json = wce_trace_json(&len);
+	if (!json) return -1;
+	FILE* f = fopen(path, "wb");
+	if (!f) { free(json); return -1; }
+	size_t written = fwrite(json, 1, len, f);
+	fclose(f);
+	free(json);
+	return written == len ? 0 : -1;
 }
 
 const char* wce_version(void) {
 	return "0.1";
 }
 
+const char* wce_io_backend(void) {
+	return wce_poll_backend(wce_self());
+}
+
 int wce_is_connected(void) {
 	// Current HTTP-only transport: return whether server is running.
-	return is_running ? 1 : 0;
+	return wce_self()->running ? 1 : 0;
+}
+
+wce_server_t* wce_req_server(wce_request_t* req) {
+	return req->srv;
 }
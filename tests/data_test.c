@@ -0,0 +1,133 @@
+// WebCee data store tests
+//
+//   data_set_get       set, replace, the max_kv_entries limit
+//   data_snapshot      cached /api/data bodies follow the store version
+//   data_threads       wce_server_data_set() on another thread while the
+//                      store is read and serialized (run under TSAN to see
+//                      a missing lock)
+//
+// Usage: wce_test_data [--only NAME]
+
+#include "../src/webcee.c"
+#include "wce_test.h"
+
+static wce_server_t* data_srv(void) {
+    wce_server_t* srv = wce_server_create();
+    if (srv) srv->cfg.max_kv_entries = 40;
+    return srv;
+}
+
+static void data_set_get(void) {
+    wce_server_t* srv = data_srv();
+    WCE_CHECK(srv != NULL);
+    if (!srv) return;
+    wce_server_data_set(srv, "a", "1");
+    wce_server_data_set(srv, "b", "two");
+    WCE_CHECK_STR(wce_server_data_get(srv, "a"), "1");
+    WCE_CHECK_STR(wce_server_data_get(srv, "b"), "two");
+    WCE_CHECK(wce_server_data_get(srv, "c") == NULL);
+
+    unsigned version = srv->kv_version;
+    wce_server_data_set(srv, "a", "1");
+    WCE_CHECK(srv->kv_version == version); // Same value: no change
+    wce_server_data_set(srv, "a", "3");
+    WCE_CHECK(srv->kv_version == version + 1);
+    WCE_CHECK_STR(wce_server_data_get(srv, "a"), "3");
+
+    char key[16];
+    for (int i = 0; i < 50; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        wce_server_data_set(srv, key, "v");
+    }
+    WCE_CHECK(srv->kv_count == 40);
+    WCE_CHECK(wce_server_data_get(srv, "k37") != NULL);
+    WCE_CHECK(wce_server_data_get(srv, "k38") == NULL);
+
+    size_t len;
+    char* json = wce_server_data_json(srv, &len);
+    WCE_CHECK(json != NULL && strncmp(json, "{\"a\":\"3\",\"b\":\"two\",", 19) == 0);
+    free(json);
+    wce_server_destroy(srv);
+}
+
+static void data_snapshot(void) {
+    wce_server_t* srv = data_srv();
+    WCE_CHECK(srv != NULL);
+    if (!srv) return;
+    wce_server_data_set(srv, "n", "42");
+    wce_snapshot_t* first = wce_snapshot_acquire(srv, WCE_DATA_JSON);
+    wce_snapshot_t* again = wce_snapshot_acquire(srv, WCE_DATA_JSON);
+    WCE_CHECK(first != NULL && first == again);
+    WCE_CHECK(first && first->len == 10 && memcmp(first->bytes, "{\"n\":\"42\"}", 10) == 0);
+    wce_snapshot_t* cbor = wce_snapshot_acquire(srv, WCE_DATA_CBOR);
+    WCE_CHECK(cbor != NULL && cbor->len == 5 && memcmp(cbor->bytes, "\xa1\x61n\x18\x2a", 5) == 0);
+
+    wce_server_data_set(srv, "n", "43");
+    wce_snapshot_t* rebuilt = wce_snapshot_acquire(srv, WCE_DATA_JSON);
+    WCE_CHECK(rebuilt != NULL && rebuilt != first);
+    WCE_CHECK(rebuilt && rebuilt->len == 10 && memcmp(rebuilt->bytes, "{\"n\":\"43\"}", 10) == 0);
+    WCE_CHECK(first && first->len == 10 && memcmp(first->bytes, "{\"n\":\"42\"}", 10) == 0); // Still referenced
+    wce_snapshot_release(first);
+    wce_snapshot_release(again);
+    wce_snapshot_release(cbor);
+    wce_snapshot_release(rebuilt);
+    wce_server_destroy(srv);
+}
+
+#define DATA_THREAD_ROUNDS 2000
+
+#ifdef _WIN32
+static unsigned __stdcall data_writer(void* arg) {
+#else
+static void* data_writer(void* arg) {
+#endif
+    wce_server_t* srv = (wce_server_t*)arg;
+    char key[16], val[16];
+    for (int i = 0; i < DATA_THREAD_ROUNDS; i++) {
+        snprintf(key, sizeof(key), "k%d", i % 40); // Grows the store, then replaces values
+        snprintf(val, sizeof(val), "%d", i);
+        wce_server_data_set(srv, key, val);
+    }
+    return 0;
+}
+
+static void data_threads(void) {
+    wce_server_t* srv = data_srv();
+    WCE_CHECK(srv != NULL);
+    if (!srv) return;
+#ifdef _WIN32
+    HANDLE thread = (HANDLE)_beginthreadex(NULL, 0, data_writer, srv, 0, NULL);
+    WCE_CHECK(thread != 0);
+    if (!thread) return;
+#else
+    pthread_t thread;
+    WCE_CHECK(pthread_create(&thread, NULL, data_writer, srv) == 0);
+#endif
+    for (int i = 0; i < DATA_THREAD_ROUNDS / 10; i++) {
+        wce_snapshot_t* snap = wce_snapshot_acquire(srv, i % 2 ? WCE_DATA_CBOR : WCE_DATA_JSON);
+        WCE_CHECK(snap != NULL);
+        wce_snapshot_release(snap);
+        wce_server_data_get(srv, "k0");
+    }
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+    WCE_CHECK(srv->kv_count == 40);
+    char val[16];
+    snprintf(val, sizeof(val), "%d", DATA_THREAD_ROUNDS - 1);
+    WCE_CHECK_STR(wce_server_data_get(srv, "k39"), val);
+    wce_server_destroy(srv);
+}
+
+static const wce_test_case_t cases[] = {
+    { "data_set_get", data_set_get },
+    { "data_snapshot", data_snapshot },
+    { "data_threads", data_threads },
+};
+
+int main(int argc, char** argv) {
+    return wce_test_main(argc, argv, cases, (int)(sizeof(cases) / sizeof(cases[0])));
+}
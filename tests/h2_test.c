@@ -0,0 +1,394 @@
+// WebCee HTTP/2 tests
+//
+//   h2_hpack_*              the HPACK decoder against RFC 7541 Appendix C
+//   h2_request              a GET over prior-knowledge h2c, header block
+//                           split across CONTINUATION frames
+//   h2_bad_padding          pad length not smaller than the frame: GOAWAY
+//   h2_continuation_*       other frames inside a header block: GOAWAY
+//   h2_window_overrun       DATA past the advertised receive window: GOAWAY
+//
+// The frame cases talk to a live server on a loopback port and assert the
+// GOAWAY or RST_STREAM error code it answers with.
+//
+// Usage: wce_test_h2 [--only NAME]
+
+#include "../src/webcee.c"
+#include "wce_test.h"
+
+// --- HPACK (RFC 7541 Appendix C) ---
+
+static int hex_decode(const char* hex, unsigned char* out) {
+    int n = 0;
+    for (; hex[0] && hex[1]; hex += 2) {
+        out[n++] = (unsigned char)((wce_hex_value(hex[0]) << 4) | wce_hex_value(hex[1]));
+    }
+    return n;
+}
+
+// Decodes one header block and compares the fields with `expected`, a
+// NULL-terminated list of name, value pairs, and the table size after it.
+static void check_block(wce_h2_conn_t* h, const char* hex, const char* const* expected, int table_size) {
+    unsigned char block[512];
+    int len = hex_decode(hex, block);
+    WCE_CHECK(wce_hpack_decode(h, block, block + len) == 0);
+    const char* f = h->fields;
+    const char* end = h->fields + h->fields_len;
+    for (; *expected; expected += 2) {
+        WCE_CHECK(f < end);
+        if (f >= end) return;
+        WCE_CHECK_STR(f, expected[0]);
+        f += strlen(f) + 1;
+        WCE_CHECK_STR(f, expected[1]);
+        f += strlen(f) + 1;
+    }
+    WCE_CHECK(f == end);
+    WCE_CHECK(h->table_size == table_size);
+}
+
+static wce_h2_conn_t* hpack_decoder(int table_max) {
+    wce_h2_conn_t* h = (wce_h2_conn_t*)calloc(1, sizeof(wce_h2_conn_t));
+    if (h) h->table_max = table_max;
+    return h;
+}
+
+static void hpack_decoder_free(wce_h2_conn_t* h) {
+    wce_hpack_evict(h, -1);
+    free(h->fields);
+    free(h);
+}
+
+static const char* const request1[] = {
+    ":method", "GET", ":scheme", "http", ":path", "/", ":authority", "www.example.com", NULL };
+static const char* const request2[] = {
+    ":method", "GET", ":scheme", "http", ":path", "/", ":authority", "www.example.com",
+    "cache-control", "no-cache", NULL };
+static const char* const request3[] = {
+    ":method", "GET", ":scheme", "https", ":path", "/index.html", ":authority", "www.example.com",
+    "custom-key", "custom-value", NULL };
+
+// C.3 without Huffman coding, C.4 with it; one decoder per connection
+static void h2_hpack_requests(void) {
+    wce_h2_conn_t* h = hpack_decoder(WCE_H2_TABLE_MAX);
+    if (!h) return;
+    check_block(h, "828684410f7777772e6578616d706c652e636f6d", request1, 57);
+    check_block(h, "828684be58086e6f2d6361636865", request2, 110);
+    check_block(h, "828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565", request3, 164);
+    hpack_decoder_free(h);
+
+    h = hpack_decoder(WCE_H2_TABLE_MAX);
+    if (!h) return;
+    check_block(h, "828684418cf1e3c2e5f23a6ba0ab90f4ff", request1, 57);
+    check_block(h, "828684be5886a8eb10649cbf", request2, 110);
+    check_block(h, "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf", request3, 164);
+    hpack_decoder_free(h);
+}
+
+static const char* const response1[] = {
+    ":status", "302", "cache-control", "private", "date", "Mon, 21 Oct 2013 20:13:21 GMT",
+    "location", "https://www.example.com", NULL };
+static const char* const response2[] = {
+    ":status", "307", "cache-control", "private", "date", "Mon, 21 Oct 2013 20:13:21 GMT",
+    "location", "https://www.example.com", NULL };
+static const char* const response3[] = {
+    ":status", "200", "cache-control", "private", "date", "Mon, 21 Oct 2013 20:13:22 GMT",
+    "location", "https://www.example.com", "content-encoding", "gzip",
+    "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1", NULL };
+
+// C.5 and C.6: a 256-byte table, so entries are evicted along the way
+static void h2_hpack_responses(void) {
+    wce_h2_conn_t* h = hpack_decoder(256);
+    if (!h) return;
+    check_block(h, "4803333032580770726976617465611d4d6f6e2c203231204f637420323031332032303a31333a323120474d54"
+                   "6e1768747470733a2f2f7777772e6578616d706c652e636f6d", response1, 222);
+    check_block(h, "4803333037c1c0bf", response2, 222);
+    check_block(h, "88c1611d4d6f6e2c203231204f637420323031332032303a31333a323220474d54c05a04677a69707738666f"
+                   "6f3d4153444a4b48514b425a584f5157454f50495541585157454f49553b206d61782d6167653d333630303b"
+                   "2076657273696f6e3d31", response3, 215);
+    hpack_decoder_free(h);
+
+    h = hpack_decoder(256);
+    if (!h) return;
+    check_block(h, "488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff6e919d29ad171863c7"
+                   "8f0b97c8e9ae82ae43d3", response1, 222);
+    check_block(h, "4883640effc1c0bf", response2, 222);
+    check_block(h, "88c16196d07abe941054d444a8200595040b8166e084a62d1bffc05a839bd9ab77ad94e7821dd7f2e6c7b335"
+                   "dfdfcd5b3960d5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1063d5007", response3, 215);
+    hpack_decoder_free(h);
+}
+
+// Compression errors: an index past both tables, a table size update over
+// the limit, a literal longer than the block.
+static void h2_hpack_errors(void) {
+    static const char* const blocks[] = { "be", "3fe21f", "400a637573746f6d" };
+    for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+        wce_h2_conn_t* h = hpack_decoder(WCE_H2_TABLE_MAX);
+        if (!h) return;
+        unsigned char block[64];
+        int len = hex_decode(blocks[i], block);
+        WCE_CHECK(wce_hpack_decode(h, block, block + len) != 0);
+        hpack_decoder_free(h);
+    }
+}
+
+// --- Live server ---
+
+static wce_server_t* h2_srv;
+static int h2_port;
+
+static void hello(wce_request_t* req) {
+    wce_respond(req, 200, "text/plain", "hello", 5);
+}
+
+static int sink(wce_request_t* req, const char* data, size_t len) {
+    (void)len;
+    if (!data) wce_respond(req, 204, "text/plain", "", 0);
+    return 0;
+}
+
+static int start_server(void) {
+    if (h2_srv) return 0;
+    h2_srv = wce_server_create();
+    if (!h2_srv) return -1;
+    wce_server_route(h2_srv, "GET", "/hello", hello);
+    wce_server_route_body(h2_srv, "POST", "/upload", sink);
+    wce_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.bind_addr = "127.0.0.1";
+    if (wce_server_init_ex(h2_srv, &cfg) != 0) return -1;
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    if (getsockname(h2_srv->listen_fd, (struct sockaddr*)&addr, &addrlen) != 0) return -1;
+    h2_port = ntohs(addr.sin_port);
+    return wce_server_start(h2_srv);
+}
+
+// Connects and sends the connection preface with empty SETTINGS.
+static wce_socket_t h2_connect(void) {
+    if (start_server() != 0) return WCE_INVALID_SOCKET;
+    wce_socket_t fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == WCE_INVALID_SOCKET) return fd;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)h2_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+#ifdef _WIN32
+    DWORD timeout = 2000;
+#else
+    struct timeval timeout = { 2, 0 };
+#endif
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    static const char settings[] = WCE_H2_PREFACE "\0\0\0\x04\0\0\0\0\0";
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        send(fd, settings, sizeof(settings) - 1, 0) != (int)sizeof(settings) - 1) {
+        wce_close_socket(fd);
+        return WCE_INVALID_SOCKET;
+    }
+    return fd;
+}
+
+static int send_all(wce_socket_t fd, const unsigned char* data, size_t len) {
+    while (len) {
+        int n = (int)send(fd, (const char*)data, (int)len, 0);
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Sends one frame; `payload` may be NULL for `len` zero bytes.
+static int send_frame(wce_socket_t fd, int type, int flags, unsigned sid, const void* payload, int len) {
+    static unsigned char frame[9 + WCE_H2_FRAME_MAX + 1];
+    frame[0] = (unsigned char)(len >> 16);
+    frame[1] = (unsigned char)(len >> 8);
+    frame[2] = (unsigned char)len;
+    frame[3] = (unsigned char)type;
+    frame[4] = (unsigned char)flags;
+    frame[5] = (unsigned char)(sid >> 24);
+    frame[6] = (unsigned char)(sid >> 16);
+    frame[7] = (unsigned char)(sid >> 8);
+    frame[8] = (unsigned char)sid;
+    if (payload) memcpy(frame + 9, payload, (size_t)len);
+    else memset(frame + 9, 0, (size_t)len);
+    return send_all(fd, frame, 9 + (size_t)len);
+}
+
+static int recv_full(wce_socket_t fd, unsigned char* buf, int len) {
+    for (int got = 0; got < len; ) {
+        int n = (int)recv(fd, (char*)buf + got, len - got, 0);
+        if (n <= 0) return -1;
+        got += n;
+    }
+    return 0;
+}
+
+typedef struct {
+    int type;
+    int flags;
+    unsigned sid;
+    int len;
+    unsigned char payload[WCE_H2_FRAME_MAX];
+} test_frame_t;
+
+// Reads frames until one of `type` arrives. Returns -1 on EOF or timeout.
+static int read_until(wce_socket_t fd, int type, test_frame_t* f) {
+    for (;;) {
+        unsigned char head[9];
+        if (recv_full(fd, head, 9) != 0) return -1;
+        f->len = (head[0] << 16) | (head[1] << 8) | head[2];
+        f->type = head[3];
+        f->flags = head[4];
+        f->sid = wce_h2_u32(head + 5) & 0x7FFFFFFF;
+        if (f->len > WCE_H2_FRAME_MAX || recv_full(fd, f->payload, f->len) != 0) return -1;
+        if (f->type == type) return 0;
+    }
+}
+
+// Error code of the GOAWAY that ends the connection, -1 when none came.
+static int goaway_code(wce_socket_t fd) {
+    test_frame_t f;
+    if (read_until(fd, WCE_H2_GOAWAY, &f) != 0 || f.len < 8) return -1;
+    return (int)wce_h2_u32(f.payload + 4);
+}
+
+// :method GET, :scheme http, :path /hello
+static const unsigned char get_hello[] = { 0x82, 0x86, 0x04, 6, '/', 'h', 'e', 'l', 'l', 'o' };
+// :method POST, :scheme http, :path /upload
+static const unsigned char post_upload[] = { 0x83, 0x86, 0x04, 7, '/', 'u', 'p', 'l', 'o', 'a', 'd' };
+
+static void h2_request(void) {
+    wce_socket_t fd = h2_connect();
+    WCE_CHECK(fd != WCE_INVALID_SOCKET);
+    if (fd == WCE_INVALID_SOCKET) return;
+    send_frame(fd, WCE_H2_HEADERS, WCE_H2_END_STREAM, 1, get_hello, 4);
+    send_frame(fd, WCE_H2_CONTINUATION, 0, 1, get_hello + 4, 3);
+    send_frame(fd, WCE_H2_CONTINUATION, WCE_H2_END_HEADERS, 1, get_hello + 7, (int)sizeof(get_hello) - 7);
+    test_frame_t f;
+    WCE_CHECK(read_until(fd, WCE_H2_HEADERS, &f) == 0);
+    WCE_CHECK(f.sid == 1 && f.len > 0 && f.payload[0] == 0x88); // :status 200
+    WCE_CHECK(read_until(fd, WCE_H2_DATA, &f) == 0);
+    WCE_CHECK(f.sid == 1 && (f.flags & WCE_H2_END_STREAM));
+    WCE_CHECK(f.len == 5 && memcmp(f.payload, "hello", 5) == 0);
+    wce_close_socket(fd);
+}
+
+static void h2_bad_padding(void) {
+    // HEADERS whose pad length equals the whole payload
+    unsigned char headers[1 + sizeof(get_hello)];
+    headers[0] = (unsigned char)sizeof(headers);
+    memcpy(headers + 1, get_hello, sizeof(get_hello));
+    wce_socket_t fd = h2_connect();
+    WCE_CHECK(fd != WCE_INVALID_SOCKET);
+    if (fd == WCE_INVALID_SOCKET) return;
+    send_frame(fd, WCE_H2_HEADERS, WCE_H2_END_HEADERS | WCE_H2_END_STREAM | WCE_H2_PADDED, 1, headers,
+               (int)sizeof(headers));
+    WCE_CHECK(goaway_code(fd) == WCE_H2_PROTOCOL_ERROR);
+    wce_close_socket(fd);
+
+    // DATA with a pad length past its end, and a PADDED frame too short
+    // for the pad length itself
+    static const unsigned char data[] = { 9, 'a', 'b' };
+    fd = h2_connect();
+    WCE_CHECK(fd != WCE_INVALID_SOCKET);
+    if (fd == WCE_INVALID_SOCKET) return;
+    send_frame(fd, WCE_H2_HEADERS, WCE_H2_END_HEADERS, 1, post_upload, (int)sizeof(post_upload));
+    send_frame(fd, WCE_H2_DATA, WCE_H2_PADDED, 1, data, (int)sizeof(data));
+    WCE_CHECK(goaway_code(fd) == WCE_H2_PROTOCOL_ERROR);
+    wce_close_socket(fd);
+
+    fd = h2_connect();
+    WCE_CHECK(fd != WCE_INVALID_SOCKET);
+    if (fd == WCE_INVALID_SOCKET) return;
+    send_frame(fd, WCE_H2_HEADERS, WCE_H2_END_HEADERS, 1, post_upload, (int)sizeof(post_upload));
+    send_frame(fd, WCE_H2_DATA, WCE_H2_PADDED, 1, NULL, 0);
+    WCE_CHECK(goaway_code(fd) == WCE_H2_PROTOCOL_ERROR);
+    wce_close_socket(fd);
+}
+
+// A header block must be followed by its own CONTINUATION frames only.
+static void h2_continuation_interleaved(void) {
+    static const unsigned char ping[8] = { 0 };
+    wce_socket_t fd = h2_connect();
+    WCE_CHECK(fd != WCE_INVALID_SOCKET);
+    if (fd == WCE_INVALID_SOCKET) return;
+    send_frame(fd, WCE_H2_HEADERS, WCE_H2_END_STREAM, 1, get_hello, 4);
+    send_frame(fd, WCE_H2_PING, 0, 0, ping, 8);
+    WCE_CHECK(goaway_code(fd) == WCE_H2_PROTOCOL_ERROR);
+    wce_close_socket(fd);
+
+    fd = h2_connect();
+    WCE_CHECK(fd != WCE_INVALID_SOCKET);
+    if (fd == WCE_INVALID_SOCKET) return;
+    send_frame(fd, WCE_H2_HEADERS, WCE_H2_END_STREAM, 1, get_hello, 4);
+    send_frame(fd, WCE_H2_CONTINUATION, WCE_H2_END_HEADERS, 3, get_hello + 4, (int)sizeof(get_hello) - 4);
+    WCE_CHECK(goaway_code(fd) == WCE_H2_PROTOCOL_ERROR);
+    wce_close_socket(fd);
+
+    fd = h2_connect();
+    WCE_CHECK(fd != WCE_INVALID_SOCKET);
+    if (fd == WCE_INVALID_SOCKET) return;
+    send_frame(fd, WCE_H2_HEADERS, WCE_H2_END_STREAM, 1, get_hello, 4);
+    send_frame(fd, WCE_H2_HEADERS, WCE_H2_END_HEADERS | WCE_H2_END_STREAM, 3, get_hello, (int)sizeof(get_hello));
+    WCE_CHECK(goaway_code(fd) == WCE_H2_PROTOCOL_ERROR);
+    wce_close_socket(fd);
+}
+
+// CONTINUATION without a header block in progress
+static void h2_continuation_orphan(void) {
+    wce_socket_t fd = h2_connect();
+    WCE_CHECK(fd != WCE_INVALID_SOCKET);
+    if (fd == WCE_INVALID_SOCKET) return;
+    send_frame(fd, WCE_H2_CONTINUATION, WCE_H2_END_HEADERS, 1, get_hello, (int)sizeof(get_hello));
+    WCE_CHECK(goaway_code(fd) == WCE_H2_PROTOCOL_ERROR);
+    wce_close_socket(fd);
+}
+
+// The connection window is 65535 bytes. 32767 bytes stay below the point
+// where the server returns credit; the next batch then goes one byte past
+// the window without a WINDOW_UPDATE in between.
+static void h2_window_overrun(void) {
+    static const unsigned char ping[8] = { 'w', 'i', 'n', 'd', 'o', 'w' };
+    static unsigned char batch[3 * 9 + 2 * WCE_H2_FRAME_MAX + 1];
+    wce_socket_t fd = h2_connect();
+    WCE_CHECK(fd != WCE_INVALID_SOCKET);
+    if (fd == WCE_INVALID_SOCKET) return;
+    send_frame(fd, WCE_H2_HEADERS, WCE_H2_END_HEADERS, 1, post_upload, (int)sizeof(post_upload));
+    send_frame(fd, WCE_H2_DATA, 0, 1, NULL, WCE_H2_FRAME_MAX);
+    send_frame(fd, WCE_H2_DATA, 0, 1, NULL, WCE_H2_FRAME_MAX - 1);
+    send_frame(fd, WCE_H2_PING, 0, 0, ping, 8);
+    test_frame_t f;
+    WCE_CHECK(read_until(fd, WCE_H2_PING, &f) == 0 && (f.flags & WCE_H2_ACK));
+
+    // Two full frames use up the window exactly, the third byte overruns it
+    unsigned char* p = batch;
+    static const int sizes[3] = { WCE_H2_FRAME_MAX, WCE_H2_FRAME_MAX, 1 };
+    for (int i = 0; i < 3; i++) {
+        memset(p, 0, 9 + (size_t)sizes[i]);
+        p[1] = (unsigned char)(sizes[i] >> 8);
+        p[2] = (unsigned char)sizes[i];
+        p[3] = WCE_H2_DATA;
+        p[8] = 1;
+        p += 9 + sizes[i];
+    }
+    send_all(fd, batch, sizeof(batch));
+    WCE_CHECK(goaway_code(fd) == WCE_H2_FLOW_CONTROL_ERROR);
+    wce_close_socket(fd);
+}
+
+static const wce_test_case_t cases[] = {
+    { "h2_hpack_requests", h2_hpack_requests },
+    { "h2_hpack_responses", h2_hpack_responses },
+    { "h2_hpack_errors", h2_hpack_errors },
+    { "h2_request", h2_request },
+    { "h2_bad_padding", h2_bad_padding },
+    { "h2_continuation_interleaved", h2_continuation_interleaved },
+    { "h2_continuation_orphan", h2_continuation_orphan },
+    { "h2_window_overrun", h2_window_overrun },
+};
+
+int main(int argc, char** argv) {
+    int rc = wce_test_main(argc, argv, cases, (int)(sizeof(cases) / sizeof(cases[0])));
+    if (h2_srv) wce_server_destroy(h2_srv);
+    return rc;
+}
@@ -0,0 +1,244 @@
+// WebCee UI patch tests
+//
+//   patch_json          /api/patch lists the live changes after `since`
+//   patch_cbor          the CBOR answer carries the same message
+//   patch_reload        pages the log cannot bring up to date reload
+//
+// A live server on a loopback port serves a small tree whose changes are
+// made before it starts. CBOR answers are converted back to JSON (the
+// subset /api/patch uses) and compared with the JSON answer.
+//
+// Usage: wce_test_patch [--only NAME]
+
+#include "../src/webcee.c"
+#include "webcee_build.h"
+#include "wce_test.h"
+
+static wce_server_t* patch_srv;
+static int patch_port;
+
+static void add_first(void) {
+    wce_text_begin("first");
+    wce_id("dev-1");
+    wce_text_end();
+}
+
+static void add_second(void) {
+    wce_text_begin("second \"quoted\"");
+    wce_id("dev-2");
+    wce_text_end();
+}
+
+// Builds the tree and logs label, style, show, insert and remove changes.
+// The first insert is superseded by the removal of its node.
+static int start_server(void) {
+    if (patch_srv) return 0;
+    patch_srv = wce_server_create();
+    if (!patch_srv) return -1;
+    wce_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.bind_addr = "127.0.0.1";
+    if (wce_server_init_ex(patch_srv, &cfg) != 0) return -1;
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    if (getsockname(patch_srv->listen_fd, (struct sockaddr*)&addr, &addrlen) != 0) return -1;
+    patch_port = ntohs(addr.sin_port);
+
+    wce_server_t* prev = wce_server_use(patch_srv);
+    wce_container_begin();
+    wce_text_begin("Idle");
+    wce_id("status");
+    wce_css("color: red;");
+    wce_text_end();
+    wce_panel_begin();
+    wce_id("devices");
+    wce_panel_end();
+    wce_container_end();
+    wce_server_node_set_label(patch_srv, "status", "Running");
+    wce_server_node_set_style(patch_srv, "status", NULL);
+    wce_server_node_set_visible(patch_srv, "status", 0);
+    wce_server_node_insert(patch_srv, "devices", NULL, add_first);
+    wce_server_node_insert(patch_srv, "devices", "dev-1", add_second);
+    wce_server_node_remove(patch_srv, "dev-1");
+    wce_server_use(prev);
+    return wce_server_start(patch_srv);
+}
+
+// GETs `path` over HTTP/1.1 and returns the de-chunked body (free it), or
+// NULL on failure.
+static char* http_get(const char* path, const char* accept, size_t* body_len, char* content_type, size_t ct_size) {
+    if (start_server() != 0) return NULL;
+    wce_socket_t fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == WCE_INVALID_SOCKET) return NULL;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)patch_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    char request[256];
+    int n = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: test\r\n%s%s%s\r\n", path,
+                     accept ? "Accept: " : "", accept ? accept : "", accept ? "\r\n" : "");
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || send(fd, request, n, 0) != n) {
+        wce_close_socket(fd);
+        return NULL;
+    }
+    size_t cap = 4096, len = 0;
+    char* buf = (char*)malloc(cap);
+    for (;;) {
+        if (len + 1024 > cap) buf = (char*)realloc(buf, cap *= 2);
+        int got = (int)recv(fd, buf + len, 1024, 0);
+        if (got <= 0) break;
+        len += (size_t)got;
+    }
+    wce_close_socket(fd);
+    buf[len] = '\0';
+
+    char* body = strstr(buf, "\r\n\r\n");
+    const char* ct = strstr(buf, "Content-Type: ");
+    if (!body || !ct || ct > body) {
+        free(buf);
+        return NULL;
+    }
+    ct += 14;
+    size_t ct_len = strcspn(ct, "\r");
+    snprintf(content_type, ct_size, "%.*s", (int)ct_len, ct);
+    body += 4;
+    if (!strstr(buf, "Transfer-Encoding: chunked")) {
+        *body_len = len - (size_t)(body - buf);
+        memmove(buf, body, *body_len);
+        return buf;
+    }
+    // Chunks are unpacked in place
+    char* out = buf;
+    for (char* p = body; ; ) {
+        char* end;
+        unsigned long size = strtoul(p, &end, 16);
+        if (end == p || strncmp(end, "\r\n", 2) != 0) {
+            free(buf);
+            return NULL;
+        }
+        p = end + 2;
+        if (!size) break;
+        memmove(out, p, size);
+        out += size;
+        p += size + 2;
+    }
+    *body_len = (size_t)(out - buf);
+    buf[*body_len] = '\0';
+    return buf;
+}
+
+// CBOR (maps, arrays, text, unsigned integers, null) back to compact JSON
+static const unsigned char* cbor_to_json(const unsigned char* p, const unsigned char* end, char** json, size_t* cap, size_t* len) {
+    if (p >= end) return NULL;
+    int major = *p >> 5, info = *p & 31;
+    p++;
+    if (*(p - 1) == 0xF6) {
+        str_append(json, cap, len, "null");
+        return p;
+    }
+    uint64_t v = (uint64_t)info;
+    if (info >= 24) {
+        int n = 1 << (info - 24);
+        if (info > 27 || p + n > end) return NULL;
+        for (v = 0; n--; ) v = (v << 8) | *p++;
+    }
+    char num[24];
+    switch (major) {
+        case 0:
+            snprintf(num, sizeof(num), "%llu", (unsigned long long)v);
+            str_append(json, cap, len, num);
+            return p;
+        case 3: {
+            if (p + v > end) return NULL;
+            char* text = (char*)malloc((size_t)v + 1);
+            memcpy(text, p, (size_t)v);
+            text[v] = '\0';
+            str_append(json, cap, len, "\"");
+            json_append_escaped(json, cap, len, text);
+            str_append(json, cap, len, "\"");
+            free(text);
+            return p + v;
+        }
+        case 4:
+        case 5:
+            str_append(json, cap, len, major == 4 ? "[" : "{");
+            for (uint64_t i = 0; i < v && p; i++) {
+                if (i) str_append(json, cap, len, ",");
+                p = cbor_to_json(p, end, json, cap, len);
+                if (major == 5 && p) {
+                    str_append(json, cap, len, ":");
+                    p = cbor_to_json(p, end, json, cap, len);
+                }
+            }
+            str_append(json, cap, len, major == 4 ? "]" : "}");
+            return p;
+        default:
+            return NULL;
+    }
+}
+
+// Returns the CBOR answer for `path` as JSON (free it)
+static char* get_cbor_as_json(const char* path) {
+    char ct[64];
+    size_t body_len;
+    char* body = http_get(path, "application/cbor", &body_len, ct, sizeof(ct));
+    WCE_CHECK(body != NULL);
+    if (!body) return NULL;
+    WCE_CHECK_STR(ct, "application/cbor");
+    size_t cap = 256, len = 0;
+    char* json = (char*)malloc(cap);
+    json[0] = '\0';
+    const unsigned char* end = (const unsigned char*)body + body_len;
+    WCE_CHECK(cbor_to_json((const unsigned char*)body, end, &json, &cap, &len) == end);
+    free(body);
+    return json;
+}
+
+static void patch_json(void) {
+    char ct[64];
+    size_t len;
+    char* body = http_get("/api/patch?since=0", NULL, &len, ct, sizeof(ct));
+    WCE_CHECK(body != NULL);
+    if (!body) return;
+    WCE_CHECK_STR(ct, "application/json");
+    static const char ops[] = "{\"seq\":6,\"ops\":[[\"label\",\"status\",\"Running\"],[\"style\",\"status\",null],"
+                              "[\"show\",\"status\",0],[\"insert\",\"devices\",\"dev-1\",\"";
+    WCE_CHECK(strncmp(body, ops, sizeof(ops) - 1) == 0);
+    WCE_CHECK(strstr(body, "second &quot;quoted&quot;") != NULL);
+    static const char removed[] = "],[\"remove\",\"dev-1\"]]}";
+    WCE_CHECK(len > sizeof(removed) && strcmp(body + len - (sizeof(removed) - 1), removed) == 0);
+    free(body);
+}
+
+static void patch_cbor(void) {
+    static const char* const paths[] = { "/api/patch?since=0", "/api/patch?since=3", "/api/patch?since=6" };
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        char ct[64];
+        size_t len;
+        char* expected = http_get(paths[i], NULL, &len, ct, sizeof(ct));
+        char* json = get_cbor_as_json(paths[i]);
+        WCE_CHECK(expected != NULL && json != NULL);
+        if (expected && json) WCE_CHECK_STR(json, expected);
+        free(expected);
+        free(json);
+    }
+}
+
+static void patch_reload(void) {
+    char* json = get_cbor_as_json("/api/patch?since=7");
+    if (json) WCE_CHECK_STR(json, "{\"seq\":6,\"reload\":1}");
+    free(json);
+}
+
+static const wce_test_case_t cases[] = {
+    { "patch_json", patch_json },
+    { "patch_cbor", patch_cbor },
+    { "patch_reload", patch_reload },
+};
+
+int main(int argc, char** argv) {
+    int rc = wce_test_main(argc, argv, cases, (int)(sizeof(cases) / sizeof(cases[0])));
+    if (patch_srv) wce_server_destroy(patch_srv);
+    return rc;
+}
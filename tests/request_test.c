@@ -0,0 +1,246 @@
+// WebCee request parsing tests
+//
+// Drives the HTTP/1 request parsers in-process:
+//   query_*   wce_req_query() over the lazily parsed query string
+//   body_*    the Content-Length and chunked body decoder (wce_body_feed)
+//
+// Usage: wce_test_request [--only NAME]
+
+#include "../src/webcee.c"
+#include "wce_test.h"
+
+static wce_server_t* test_srv;
+static char test_head[4096];
+static wce_request_t test_req;
+
+// Parses `head` (a request head without the final blank line) into test_req.
+static wce_request_t* parse_request(const char* head) {
+    snprintf(test_head, sizeof(test_head), "%s\r\n\r\n", head);
+    if (wce_request_parse(&test_req, test_head, (int)strlen(test_head)) != 0) return NULL;
+    test_req.srv = test_srv;
+    return &test_req;
+}
+
+static void done_request(wce_request_t* req) {
+    wce_buf_free(req->scratch);
+    req->scratch = NULL;
+}
+
+// --- Query String ---
+
+static void query_basic(void) {
+    wce_request_t* req = parse_request("GET /p?name=web+cee&id=%34%32&last=x HTTP/1.1");
+    WCE_CHECK(req != NULL);
+    if (!req) return;
+    WCE_CHECK_STR(req->path, "/p");
+    WCE_CHECK_STR(wce_req_query(req, "name"), "web cee");
+    WCE_CHECK_STR(wce_req_query(req, "id"), "42");
+    WCE_CHECK_STR(wce_req_query(req, "last"), "x");
+    WCE_CHECK(wce_req_query(req, "missing") == NULL);
+    done_request(req);
+}
+
+// Malformed escapes are copied through unchanged.
+static void query_bad_escapes(void) {
+    wce_request_t* req = parse_request("GET /p?a=%zz&b=%&c=50%&d=%4&e=%4g&f=%%41&%6e=n HTTP/1.1");
+    WCE_CHECK(req != NULL);
+    if (!req) return;
+    WCE_CHECK_STR(wce_req_query(req, "a"), "%zz");
+    WCE_CHECK_STR(wce_req_query(req, "b"), "%");
+    WCE_CHECK_STR(wce_req_query(req, "c"), "50%");
+    WCE_CHECK_STR(wce_req_query(req, "d"), "%4");
+    WCE_CHECK_STR(wce_req_query(req, "e"), "%4g");
+    WCE_CHECK_STR(wce_req_query(req, "f"), "%A");
+    WCE_CHECK_STR(wce_req_query(req, "n"), "n");
+    done_request(req);
+}
+
+// "a" has no value, "" is an empty name with a value, "&&" adds nothing.
+static void query_valueless(void) {
+    wce_request_t* req = parse_request("GET /p?a&=x&& HTTP/1.1");
+    WCE_CHECK(req != NULL);
+    if (!req) return;
+    WCE_CHECK_STR(wce_req_query(req, "a"), "");
+    WCE_CHECK_STR(wce_req_query(req, ""), "x");
+    WCE_CHECK(req->query_count == 2);
+    done_request(req);
+
+    req = parse_request("GET /p? HTTP/1.1");
+    WCE_CHECK(req != NULL);
+    if (!req) return;
+    WCE_CHECK(wce_req_query(req, "a") == NULL);
+    WCE_CHECK(req->query_count == 0);
+    done_request(req);
+}
+
+// The first occurrence of a repeated name wins.
+static void query_duplicates(void) {
+    wce_request_t* req = parse_request("GET /p?k=1&k=2&K=3 HTTP/1.1");
+    WCE_CHECK(req != NULL);
+    if (!req) return;
+    WCE_CHECK_STR(wce_req_query(req, "k"), "1");
+    WCE_CHECK_STR(wce_req_query(req, "K"), "3");
+    done_request(req);
+}
+
+// Only valueless parameters: every one decodes to two NULs, the densest
+// use of the scratch buffer.
+static void query_scratch_size(void) {
+    static char head[4096];
+    int len = snprintf(head, sizeof(head), "GET /p?");
+    for (int i = 0; i < 1000; i++) len += snprintf(head + len, sizeof(head) - (size_t)len, i ? "&a" : "a");
+    snprintf(head + len, sizeof(head) - (size_t)len, " HTTP/1.1");
+    wce_request_t* req = parse_request(head);
+    WCE_CHECK(req != NULL);
+    if (!req) return;
+    WCE_CHECK_STR(wce_req_query(req, "a"), "");
+    WCE_CHECK(req->query_count == 1);
+    WCE_CHECK(req->scratch_cap >= 1000 * 3);
+    done_request(req);
+}
+
+// --- Request Bodies ---
+
+static char body_data[256];
+static size_t body_len;
+static int body_final;           // Final handler calls seen
+
+static int collect_body(wce_request_t* req, const char* data, size_t len) {
+    (void)req;
+    if (!data) {
+        body_final++;
+        return 0;
+    }
+    if (body_len + len > sizeof(body_data) - 1) return -1;
+    memcpy(body_data + body_len, data, len);
+    body_len += len;
+    body_data[body_len] = '\0';
+    return 0;
+}
+
+// Starts a body for `head`. The request counts as answered, so the final
+// handler call sends nothing.
+static wce_request_t* begin_body(const char* head) {
+    wce_request_t* req = parse_request(head);
+    if (!req) return NULL;
+    body_len = 0;
+    body_data[0] = '\0';
+    body_final = 0;
+    req->responded = 1;
+    if (wce_body_begin(req, collect_body) != 0) return NULL;
+    return req;
+}
+
+// Feeds `data` in pieces of `step` bytes. Returns wce_body_feed()'s result
+// for the last piece, or 1 as soon as the body has ended.
+static int feed_body(wce_request_t* req, const char* data, size_t step) {
+    size_t len = strlen(data);
+    for (size_t i = 0; i < len; i += step) {
+        size_t n = len - i < step ? len - i : step;
+        if (wce_body_feed(req, data + i, n)) return 1;
+    }
+    return 0;
+}
+
+static void body_content_length(void) {
+    wce_request_t* req = begin_body("POST /u HTTP/1.1\r\nContent-Length: 11");
+    WCE_CHECK(req != NULL);
+    if (!req) return;
+    WCE_CHECK(wce_body_feed(req, "hello", 5) == 0);
+    WCE_CHECK(wce_body_feed(req, " world and more", 15) == 1); // Bytes past the body are not taken
+    WCE_CHECK_STR(body_data, "hello world");
+    WCE_CHECK(body_final == 1 && !req->aborted);
+    done_request(req);
+}
+
+static void body_chunked(void) {
+    static const char body[] = "5\r\nhello\r\n6;name=value\r\n world\r\n10\r\n, and sixteen...\r\n0\r\n\r\n";
+    // In one piece, and one byte per read so every size, extension and CRLF
+    // is split across reads
+    static const size_t steps[] = { sizeof(body), 1, 2, 3, 7 };
+    for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+        wce_request_t* req = begin_body("POST /u HTTP/1.1\r\nTransfer-Encoding: chunked");
+        WCE_CHECK(req != NULL);
+        if (!req) return;
+        WCE_CHECK(req->content_length == -1);
+        WCE_CHECK(feed_body(req, body, steps[s]) == 1);
+        WCE_CHECK_STR(body_data, "hello world, and sixteen...");
+        WCE_CHECK(body_final == 1 && !req->aborted);
+        done_request(req);
+    }
+}
+
+// Up to 15 hex digits make a chunk size; a 16th fails the body, leading
+// zeros included.
+static void body_chunk_size_limit(void) {
+    wce_request_t* req = begin_body("POST /u HTTP/1.1\r\nTransfer-Encoding: chunked");
+    WCE_CHECK(req != NULL);
+    if (!req) return;
+    WCE_CHECK(feed_body(req, "fffffffffffffff\r\nabc", 4) == 0);
+    WCE_CHECK(req->body_left == 0xfffffffffffffffULL - 3);
+    WCE_CHECK_STR(body_data, "abc");
+    WCE_CHECK(body_final == 0);
+    done_request(req);
+
+    req = begin_body("POST /u HTTP/1.1\r\nTransfer-Encoding: chunked");
+    WCE_CHECK(req != NULL);
+    if (!req) return;
+    WCE_CHECK(feed_body(req, "0000000000000001\r\nx\r\n0\r\n\r\n", 1) == 1);
+    WCE_CHECK(body_final == 1 && req->aborted);
+    WCE_CHECK(body_len == 0);
+    done_request(req);
+}
+
+static void body_trailers(void) {
+    static const char body[] = "3\r\nabc\r\n0\r\nX-Checksum: 1234\r\nX-Other: a\r\n\r\nGET / HTTP/1.1\r\n";
+    static const size_t steps[] = { sizeof(body), 1 };
+    for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+        wce_request_t* req = begin_body("POST /u HTTP/1.1\r\nTransfer-Encoding: chunked");
+        WCE_CHECK(req != NULL);
+        if (!req) return;
+        WCE_CHECK(feed_body(req, body, steps[s]) == 1);
+        WCE_CHECK_STR(body_data, "abc");
+        WCE_CHECK(body_final == 1 && !req->aborted);
+        // The body ends at the blank line: the next request is not fed
+        WCE_CHECK(wce_body_feed(req, "GET", 3) == 1);
+        WCE_CHECK(body_final == 1);
+        done_request(req);
+    }
+}
+
+static void body_malformed(void) {
+    static const char* const bodies[] = {
+        "zz\r\n",             // No size digits
+        "\r\n",               // Empty size line
+        "3\r\nabcX\r\n",      // Chunk data not followed by CRLF
+        "-1\r\n",             // Sign
+    };
+    for (size_t i = 0; i < sizeof(bodies) / sizeof(bodies[0]); i++) {
+        wce_request_t* req = begin_body("POST /u HTTP/1.1\r\nTransfer-Encoding: chunked");
+        WCE_CHECK(req != NULL);
+        if (!req) return;
+        WCE_CHECK(feed_body(req, bodies[i], 1) == 1);
+        WCE_CHECK(body_final == 1 && req->aborted);
+        done_request(req);
+    }
+}
+
+static const wce_test_case_t cases[] = {
+    { "query_basic", query_basic },
+    { "query_bad_escapes", query_bad_escapes },
+    { "query_valueless", query_valueless },
+    { "query_duplicates", query_duplicates },
+    { "query_scratch_size", query_scratch_size },
+    { "body_content_length", body_content_length },
+    { "body_chunked", body_chunked },
+    { "body_chunk_size_limit", body_chunk_size_limit },
+    { "body_trailers", body_trailers },
+    { "body_malformed", body_malformed },
+};
+
+int main(int argc, char** argv) {
+    test_srv = wce_server_create();
+    int rc = wce_test_main(argc, argv, cases, (int)(sizeof(cases) / sizeof(cases[0])));
+    wce_server_destroy(test_srv);
+    return rc;
+}
@@ -0,0 +1,71 @@
+// WebCee runtime test harness
+//
+// A test program includes src/webcee.c directly, so its cases can drive the
+// static parsers and decoders as well as a live server. Each program lists
+// its cases in a wce_test_case_t table and hands it to wce_test_main(),
+// which runs all of them or the one named by --only (one CTest test per
+// case). A failed WCE_CHECK reports file and line and fails the case; the
+// process exits non-zero when any case failed.
+//
+// Usage: <test program> [--only NAME]
+
+#ifndef WCE_TEST_H
+#define WCE_TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} wce_test_case_t;
+
+static int wce_test_failures = 0;
+
+#define WCE_CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            wce_test_failures++; \
+        } \
+    } while (0)
+
+// NULL-safe string comparison
+#define WCE_CHECK_STR(actual, expected) do { \
+        const char* wce_a_ = (actual); \
+        const char* wce_e_ = (expected); \
+        if (!wce_a_ || strcmp(wce_a_, wce_e_) != 0) { \
+            fprintf(stderr, "%s:%d: %s is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, #actual, \
+                    wce_a_ ? wce_a_ : "(null)", wce_e_); \
+            wce_test_failures++; \
+        } \
+    } while (0)
+
+static int wce_test_main(int argc, char** argv, const wce_test_case_t* cases, int count) {
+    const char* only = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else {
+            printf("Usage: %s [--only NAME]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int ran = 0, failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (only && strcmp(only, cases[i].name) != 0) continue;
+        int before = wce_test_failures;
+        cases[i].run();
+        ran++;
+        int ok = wce_test_failures == before;
+        if (!ok) failed++;
+        printf("%-28s %s\n", cases[i].name, ok ? "ok" : "FAILED");
+    }
+    if (!ran) {
+        fprintf(stderr, "unknown test case: %s\n", only ? only : "(none)");
+        return 2;
+    }
+    return failed ? 1 : 0;
+}
+
+#endif